@@ -4,11 +4,50 @@
 #include "../world.h"
 #include "components.h"
 
-void collision_system(World *world, unsigned int entity, PositionComponent* temp, unsigned int* entity_number, unsigned int* tile_number, unsigned int* hit_entity);
-void wall_collision(World *world, PositionComponent temp, unsigned int* tile_number);
+#define WALL_SKIN 0.01f /**< How far from a wall a swept entity stops, so it never ends up inside it. */
+
+/**
+ * Where an entity stopped when it was moved along one axis.
+ *
+ * @struct WallContact
+ */
+typedef struct {
+	float distance;    /**< How far the entity moved. */
+	int normal_x;      /**< The x direction the wall that was hit faces, or 0. */
+	int normal_y;      /**< The y direction the wall that was hit faces, or 0. */
+	unsigned int tile; /**< COLLISION_WALL if a wall was hit, COLLISION_EMPTY if not, COLLISION_UNKNOWN if the floor isn't loaded. */
+} WallContact;
+
+#define MAX_AREA_HITS 32 /**< The most entities an action looks at. */
+
+/**
+ * An area to find the colliding entities in.
+ *
+ * The edges are tested the same way entity_collision tests an entity, so
+ * shrink them by a pixel to match it.
+ *
+ * @struct AreaQuery
+ */
+typedef struct {
+	int level;                 /**< The floor to search. */
+	float left;                /**< The left of the area. */
+	float top;                 /**< The top of the area. */
+	float right;               /**< The right of the area. */
+	float bottom;              /**< The bottom of the area. */
+	unsigned int exclude;      /**< An entity to leave out, or MAX_ENTITIES. */
+	const unsigned int *types; /**< The collision types to find, or NULL for every type. */
+	unsigned int type_count;   /**< The number of types. */
+} AreaQuery;
+
+void gather_colliders(World *world);
+void sync_collider(World *world, unsigned int entity);
+void sweep_walls_x(World *world, PositionComponent *temp, float dx, WallContact *contact);
+void sweep_walls_y(World *world, PositionComponent *temp, float dy, WallContact *contact);
 void entity_collision(World *world, unsigned int entity, PositionComponent temp, unsigned int* entity_number, unsigned int* hit_entity);
+unsigned int query_area(World *world, const AreaQuery *query, unsigned int *hits, unsigned int max_hits);
 
 void rebuild_floor(World * world, int targl);
+void prefetch_adjacent_floors(World* world);
 int check_tag_collision(World* world, unsigned int currentEntityID);
 void anti_stuck_system(World *world, unsigned int curEntityID, int otherEntityID);
 
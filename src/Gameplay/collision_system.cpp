@@ -23,106 +23,422 @@
 #define DIRECTION_UP	3
 #define DIRECTION_DOWN	4
 #define TAG_DISTANCE	5
+#define ACTION_RANGE	60 /**< The size of the area around a player that the action key reaches. */
 
 extern int send_router_fd[];
 
-bool spacebar_collision(World* world, unsigned int entity, unsigned int** collision_list, unsigned int* num_collisions);
-void cleanup_spacebar_collision(unsigned int** collision_list);
+/**
+ * Grows one of the collider arrays.
+ *
+ * @param[in,out] array    The array. It is left alone if there isn't enough memory.
+ * @param[in]     size     The size of an element.
+ * @param[in]     capacity The number of elements it should have room for.
+ *
+ * @return 0 on success, -1 if there isn't enough memory.
+ */
+static int resize_collider_array(void **array, size_t size, unsigned int capacity) {
+	
+	void *resized = realloc(*array, size * capacity);
+	
+	if (resized == NULL) {
+		return -1;
+	}
+	
+	*array = resized;
+	return 0;
+}
 
 /**
- * This is the main wrapper function for all other collision checking functions.
+ * Grows the collider arrays.
  *
- * @param[in,out] world      A pointer to the world structure.
- * @param[in]     entity     The temporary position entity used for checking for collisions. 
- * @param[in,out] temp       The temporary position that will be applied later.
- * @param[out] entity_number The collision type of the entity that was hit (if any).
- * @param[out] tile_number   The collision type of the tile that was hit (if any).
- * @param[out] hit_entity    The identifier of the entity that was hit (if any).
+ * @param[in,out] colliders The collider arrays.
+ * @param[in]     capacity  The number of slots they should have room for.
  *
- * @designer Clark Allenby & Joshua Campbell
- * @author   Clark Allenby
+ * @return 0 on success, -1 if there isn't enough memory.
  */
-void collision_system(World* world, unsigned int entity, PositionComponent* temp, unsigned int* entity_number, unsigned int* tile_number, unsigned int* hit_entity) {
-	wall_collision(world, *temp, tile_number);
-	entity_collision(world, entity, *temp, entity_number, hit_entity);
+static int resize_colliders(ColliderArrays *colliders, unsigned int capacity) {
+	
+	//each array is only replaced once it has grown, so a failure leaves the old arrays usable.
+	if (resize_collider_array((void**)&colliders->entity,		sizeof(unsigned int),	capacity) ||
+		resize_collider_array((void**)&colliders->x,			sizeof(float),			capacity) ||
+		resize_collider_array((void**)&colliders->y,			sizeof(float),			capacity) ||
+		resize_collider_array((void**)&colliders->half_width,	sizeof(float),			capacity) ||
+		resize_collider_array((void**)&colliders->half_height,	sizeof(float),			capacity) ||
+		resize_collider_array((void**)&colliders->level,		sizeof(int),			capacity) ||
+		resize_collider_array((void**)&colliders->active,		sizeof(unsigned char),	capacity) ||
+		resize_collider_array((void**)&colliders->cell_x,		sizeof(int),			capacity) ||
+		resize_collider_array((void**)&colliders->cell_y,		sizeof(int),			capacity) ||
+		resize_collider_array((void**)&colliders->cell_next,	sizeof(unsigned int),	capacity) ||
+		resize_collider_array((void**)&colliders->cell_prev,	sizeof(unsigned int),	capacity) ||
+		resize_collider_array((void**)&colliders->candidates,	sizeof(unsigned int),	capacity)) {
+		return -1;
+	}
+	
+	colliders->capacity = capacity;
+	return 0;
 }
 
 /**
- * Checks for collisions with walls on the map.
+ * Gets the grid cell a position is in.
  *
- * @param[in,out] world       A pointer to the world structure.
- * @param[in]     temp        The temporary position used for checking for collisions.
- * @param[out]    tile_number The collision type of the tile that was hit (if any). 
+ * @param[in] position The x or y position.
  *
- * @designer Clark Allenby & Joshua Campbell
- * @author   Clark Allenby
+ * @return The cell, counted in tiles from 0.
  */
-void wall_collision(World* world, PositionComponent temp, unsigned int* tile_number) {
-	int i = 0;
-	int level = -1;
-	int xl, xr, yt, yb;
-	int xdts, ydts;
-	
-	for (i = 0; i < MAX_ENTITIES; i++) {
-		if (((world->mask[i] & LEVEL_MASK) != 0) && world->level[i].levelID == temp.level) {
-			level = i;
-			break;
+static int collider_cell(float position) {
+	return (int)floorf(position / TILE_WIDTH);
+}
+
+/**
+ * Gets the grid bucket a cell is kept in.
+ *
+ * @param[in] x     The cell's column.
+ * @param[in] y     The cell's row.
+ * @param[in] level The floor.
+ *
+ * @return The bucket.
+ */
+static unsigned int collider_bucket(int x, int y, int level) {
+	return ((unsigned int)x * 73856093u ^ (unsigned int)y * 19349663u ^ (unsigned int)level * 83492791u) & (COLLIDER_BUCKETS - 1);
+}
+
+/**
+ * Takes a slot out of its grid bucket.
+ *
+ * @param[in,out] colliders The collider arrays.
+ * @param[in]     slot      The slot.
+ */
+static void unlink_collider(ColliderArrays *colliders, unsigned int slot) {
+	
+	unsigned int next = colliders->cell_next[slot];
+	unsigned int prev = colliders->cell_prev[slot];
+	
+	if (prev != MAX_ENTITIES) {
+		colliders->cell_next[prev] = next;
+	}
+	else {
+		colliders->buckets[collider_bucket(colliders->cell_x[slot], colliders->cell_y[slot], colliders->level[slot])] = next;
+	}
+	
+	if (next != MAX_ENTITIES) {
+		colliders->cell_prev[next] = prev;
+	}
+}
+
+/**
+ * Puts a slot into the grid bucket of the cell its centre is in.
+ *
+ * @param[in,out] colliders The collider arrays.
+ * @param[in]     slot      The slot.
+ */
+static void link_collider(ColliderArrays *colliders, unsigned int slot) {
+	
+	unsigned int bucket;
+	
+	colliders->cell_x[slot] = collider_cell(colliders->x[slot]);
+	colliders->cell_y[slot] = collider_cell(colliders->y[slot]);
+	
+	bucket = collider_bucket(colliders->cell_x[slot], colliders->cell_y[slot], colliders->level[slot]);
+	
+	colliders->cell_prev[slot] = MAX_ENTITIES;
+	colliders->cell_next[slot] = colliders->buckets[bucket];
+	
+	if (colliders->buckets[bucket] != MAX_ENTITIES) {
+		colliders->cell_prev[colliders->buckets[bucket]] = slot;
+	}
+	
+	colliders->buckets[bucket] = slot;
+	
+	if (colliders->half_width[slot] > colliders->max_half_width) {
+		colliders->max_half_width = colliders->half_width[slot];
+	}
+	if (colliders->half_height[slot] > colliders->max_half_height) {
+		colliders->max_half_height = colliders->half_height[slot];
+	}
+}
+
+/**
+ * Copies an entity's collision fields into its slot.
+ *
+ * @param[in,out] world  A pointer to the world structure.
+ * @param[in]     entity The entity.
+ * @param[in]     slot   The entity's slot.
+ */
+static void fill_collider(World *world, unsigned int entity, unsigned int slot) {
+	
+	ColliderArrays *colliders = &world->colliders;
+	
+	colliders->entity[slot] = entity;
+	colliders->x[slot] = world->position[entity].x;
+	colliders->y[slot] = world->position[entity].y;
+	colliders->half_width[slot] = world->position[entity].width / 2;
+	colliders->half_height[slot] = world->position[entity].height / 2;
+	colliders->level[slot] = world->position[entity].level;
+	colliders->active[slot] = world->collision[entity].active;
+}
+
+/**
+ * Fills the collider arrays and the grid from every entity that can collide.
+ *
+ * The arrays are in entity order, so the lowest slot that overlaps is the same
+ * entity that checking every entity in order would find first.
+ *
+ * @param[in,out] world A pointer to the world structure.
+ */
+void gather_colliders(World *world) {
+	
+	ColliderArrays *colliders = &world->colliders;
+	EntityList *list = get_entity_list(world, COLLISION_MASK);
+	unsigned int entity;
+	unsigned int *slot;
+	unsigned int i;
+	
+	colliders->count = 0;
+	colliders->max_half_width = 0;
+	colliders->max_half_height = 0;
+	
+	for (i = 0; i < COLLIDER_BUCKETS; i++) {
+		colliders->buckets[i] = MAX_ENTITIES;
+	}
+	
+	if (list == NULL) {
+		return;
+	}
+	
+	if (colliders->capacity < list->count && resize_colliders(colliders, list->capacity) == -1) {
+		printf("Error growing the collider arrays\n");
+		return;
+	}
+	
+	if (colliders->slot_capacity < world->capacity) {
+		
+		if ((slot = (unsigned int*)realloc(colliders->slot, sizeof(unsigned int) * world->capacity)) == NULL) {
+			printf("Error growing the collider slots\n");
+			return;
 		}
+		
+		colliders->slot = slot;
+		colliders->slot_capacity = world->capacity;
 	}
+	
+	for (entity = first_entity(list); entity < MAX_ENTITIES; entity = next_entity(list, entity)) {
+		colliders->slot[entity] = colliders->count;
+		fill_collider(world, entity, colliders->count);
+		link_collider(colliders, colliders->count);
+		colliders->count++;
+	}
+	
+	colliders->dirty = false;
+}
 
-	if (level == -1) {
-		*tile_number = COLLISION_UNKNOWN;
+/**
+ * Updates an entity's slot in the collider arrays and the grid after it has moved.
+ *
+ * @param[in,out] world  A pointer to the world structure.
+ * @param[in]     entity The entity that moved.
+ */
+void sync_collider(World *world, unsigned int entity) {
+	
+	ColliderArrays *colliders = &world->colliders;
+	unsigned int slot;
+	
+	if (colliders->dirty || entity >= colliders->slot_capacity) {
 		return;
 	}
 	
-	xl = (temp.x - temp.width / 2) / world->level[level].tileSize;
-	xr = (temp.x + temp.width / 2) / world->level[level].tileSize;
-	yt = (temp.y - temp.height / 2) / world->level[level].tileSize;
-	yb = (temp.y + temp.height / 2) / world->level[level].tileSize;
+	slot = colliders->slot[entity];
+	
+	if (slot < colliders->count && colliders->entity[slot] == entity) {
+		unlink_collider(colliders, slot);
+		fill_collider(world, entity, slot);
+		link_collider(colliders, slot);
+	}
+}
+
+/**
+ * Finds the colliders on a floor that might overlap an area.
+ *
+ * Only the grid cells the area covers are searched, widened by the biggest
+ * collider since colliders are kept in the cell their centre is in. The slots
+ * are written to the collider arrays' candidates, from lowest to highest.
+ *
+ * @param[in,out] world  A pointer to the world structure.
+ * @param[in]     level  The floor.
+ * @param[in]     left   The left of the area.
+ * @param[in]     top    The top of the area.
+ * @param[in]     right  The right of the area.
+ * @param[in]     bottom The bottom of the area.
+ *
+ * @return The number of candidates.
+ */
+static unsigned int find_collider_candidates(World *world, int level, float left, float top, float right, float bottom) {
+	
+	ColliderArrays *colliders = &world->colliders;
+	unsigned int count = 0;
+	unsigned int slot;
+	unsigned int i, j;
+	int x0, y0, x1, y1, x, y;
 	
-	xdts = ceil((float)temp.width / (float)world->level[level].tileSize);
-	ydts = ceil((float)temp.height / (float)world->level[level].tileSize);
+	if (colliders->dirty) {
+		gather_colliders(world);
+	}
 	
-	if (yt < world->level[level].height && yt > 0 && yb < world->level[level].height && yb > 0) {
-		for (int i = 0; i < xdts; i++) {
-			if (xl + i * world->level[level].tileSize < world->level[level].width &&
-				xl + i * world->level[level].tileSize >= 0) {
-				if (world->level[level].map[xl + i * world->level[level].tileSize][yt] == L_WALL) {
-					*tile_number = COLLISION_WALL;
-					return;
-				}
+	//one more pixel, as the checks are a pixel loose on some sides.
+	x0 = collider_cell(left - colliders->max_half_width - 1);
+	x1 = collider_cell(right + colliders->max_half_width + 1);
+	y0 = collider_cell(top - colliders->max_half_height - 1);
+	y1 = collider_cell(bottom + colliders->max_half_height + 1);
+	
+	//an area bigger than the grid would visit buckets more than once, so just check everything.
+	if ((double)(x1 - x0 + 1) * (y1 - y0 + 1) > COLLIDER_BUCKETS) {
+		for (slot = 0; slot < colliders->count; slot++) {
+			if (colliders->level[slot] == level) {
+				colliders->candidates[count++] = slot;
 			}
-			if (xr - i * world->level[level].tileSize < world->level[level].width &&
-				xr - i * world->level[level].tileSize >= 0) {
-				if (world->level[level].map[xr - i * world->level[level].tileSize][yb] == L_WALL) {
-					*tile_number = COLLISION_WALL;
-					return;
+		}
+		return count;
+	}
+	
+	for (y = y0; y <= y1; y++) {
+		for (x = x0; x <= x1; x++) {
+			for (slot = colliders->buckets[collider_bucket(x, y, level)]; slot != MAX_ENTITIES; slot = colliders->cell_next[slot]) {
+				
+				//other cells can share the bucket.
+				if (colliders->cell_x[slot] == x && colliders->cell_y[slot] == y && colliders->level[slot] == level) {
+					colliders->candidates[count++] = slot;
 				}
 			}
 		}
 	}
-	if (xl < world->level[level].width && xl > 0 && xr < world->level[level].width && xr > 0) {
-		for (int i = 0; i < ydts; i++) {
-			if (yt + i * world->level[level].tileSize < world->level[level].height &&
-				yt + i * world->level[level].tileSize >= 0) {
-				if (world->level[level].map[xr][yt + i * world->level[level].tileSize] == L_WALL) {
-					*tile_number = COLLISION_WALL;
+	
+	//keep them in entity order, so the first hit is the same as checking every entity.
+	for (i = 1; i < count; i++) {
+		slot = colliders->candidates[i];
+		for (j = i; j > 0 && colliders->candidates[j - 1] > slot; j--) {
+			colliders->candidates[j] = colliders->candidates[j - 1];
+		}
+		colliders->candidates[j] = slot;
+	}
+	
+	return count;
+}
+
+/**
+ * Checks whether a tile is a wall. Tiles off the map aren't.
+ *
+ * @param[in] level    The floor.
+ * @param[in] along    The tile along the axis that is being swept.
+ * @param[in] across   The tile across that axis.
+ * @param[in] vertical Whether the sweep is along y.
+ *
+ * @return true if the tile is a wall.
+ */
+static bool sweep_tile_is_wall(LevelComponent *level, int along, int across, bool vertical) {
+	int x = vertical ? across : along;
+	int y = vertical ? along : across;
+
+	if (x < 0 || y < 0 || x >= level->width || y >= level->height)
+		return false;
+
+	return LEVEL_WALL(level, x, y) != 0;
+}
+
+/**
+ * Moves an entity along one axis until it reaches a wall.
+ *
+ * The tiles the leading edge of the entity passes into are checked in the order it
+ * reaches them, across every row (or column) the entity covers, and the entity stops
+ * WALL_SKIN short of the first wall. Nothing is skipped however fast the entity is
+ * going. Walls the entity already overlaps don't stop it, so it can always move out.
+ *
+ * @param[in]     world    A pointer to the world structure.
+ * @param[in,out] temp     The temporary position that is moved.
+ * @param[in]     delta    How far the entity wants to move.
+ * @param[in]     vertical Whether to move along y instead of x.
+ * @param[out]    contact  How far the entity moved and the wall it hit (if any).
+ */
+static void sweep_walls(World *world, PositionComponent *temp, float delta, bool vertical, WallContact *contact) {
+	unsigned int level_entity = get_floor_level(world, temp->level);
+	LevelComponent *level;
+	float *position = vertical ? &temp->y : &temp->x;
+	float half_along = (vertical ? temp->height : temp->width) / 2.0f;
+	float half_across = (vertical ? temp->width : temp->height) / 2.0f;
+	float centre_across = vertical ? temp->x : temp->y;
+	float size, edge;
+	int first, last, tile, across;
+	
+	contact->distance = delta;
+	contact->normal_x = 0;
+	contact->normal_y = 0;
+	
+	if (level_entity == MAX_ENTITIES) {
+		contact->tile = COLLISION_UNKNOWN;
+		*position += delta;
+		return;
+	}
+	
+	level = &world->level[level_entity];
+	size = level->tileSize;
+	contact->tile = COLLISION_EMPTY;
+	
+	//the tiles the entity covers across the axis. Touching a tile isn't covering it.
+	first = (int)floorf((centre_across - half_across) / size);
+	last = (int)ceilf((centre_across + half_across) / size) - 1;
+	
+	if (delta > 0) {
+		edge = *position + half_along;
+		for (tile = (int)ceilf(edge / size); tile <= (int)ceilf((edge + delta) / size) - 1; tile++) {
+			for (across = first; across <= last; across++) {
+				if (sweep_tile_is_wall(level, tile, across, vertical)) {
+					contact->distance = fmaxf(0, tile * size - WALL_SKIN - edge);
+					contact->tile = COLLISION_WALL;
+					*(vertical ? &contact->normal_y : &contact->normal_x) = -1;
+					*position += contact->distance;
 					return;
 				}
 			}
-			if (yb - i * world->level[level].tileSize < world->level[level].height &&
-				yb - i * world->level[level].tileSize >= 0) {
-				if (world->level[level].map[xl][yb - i * world->level[level].tileSize] == L_WALL) {
-					*tile_number = COLLISION_WALL;
+		}
+	}
+	else if (delta < 0) {
+		edge = *position - half_along;
+		for (tile = (int)floorf(edge / size) - 1; tile >= (int)floorf((edge + delta) / size); tile--) {
+			for (across = first; across <= last; across++) {
+				if (sweep_tile_is_wall(level, tile, across, vertical)) {
+					contact->distance = fminf(0, (tile + 1) * size + WALL_SKIN - edge);
+					contact->tile = COLLISION_WALL;
+					*(vertical ? &contact->normal_y : &contact->normal_x) = 1;
+					*position += contact->distance;
 					return;
 				}
 			}
 		}
 	}
 	
-	
-	// debug statement: printf("xl: %i, xr: %i, yt: %i, yb: %i, xdts: %i, ydts: %i\n", xl, xr, yt, yb, xdts, ydts);
-	*tile_number = COLLISION_EMPTY;
+	*position += delta;
+}
+
+/**
+ * Moves an entity along x until it reaches a wall.
+ *
+ * @param[in]     world   A pointer to the world structure.
+ * @param[in,out] temp    The temporary position that is moved.
+ * @param[in]     dx      How far the entity wants to move.
+ * @param[out]    contact How far the entity moved and the wall it hit (if any).
+ */
+void sweep_walls_x(World *world, PositionComponent *temp, float dx, WallContact *contact) {
+	sweep_walls(world, temp, dx, false, contact);
+}
+
+/**
+ * Moves an entity along y until it reaches a wall.
+ *
+ * @param[in]     world   A pointer to the world structure.
+ * @param[in,out] temp    The temporary position that is moved.
+ * @param[in]     dy      How far the entity wants to move.
+ * @param[out]    contact How far the entity moved and the wall it hit (if any).
+ */
+void sweep_walls_y(World *world, PositionComponent *temp, float dy, WallContact *contact) {
+	sweep_walls(world, temp, dy, true, contact);
 }
 
 /**
@@ -138,19 +454,27 @@ void wall_collision(World* world, PositionComponent temp, unsigned int* tile_num
  * @author   Joshua campbell & Clark Allenby
  */
 void entity_collision(World* world, unsigned int entity, PositionComponent temp, unsigned int* entity_number, unsigned int* hit_entity) {
+	ColliderArrays *colliders = &world->colliders;
 	unsigned int i = 0;
+	unsigned int count, slot;
+	float right = temp.x + temp.width / 2 - 1;
+	float left = temp.x - temp.width / 2 + 1;
+	float bottom = temp.y + temp.height / 2 - 1;
+	float top = temp.y - temp.height / 2 + 1;
 	
-	for (i = 0; i < MAX_ENTITIES; i++) {
-		if (i != entity && IN_THIS_COMPONENT(world->mask[i], COLLISION_MASK)) {
-			if (temp.x + temp.width / 2 - 1 > world->position[i].x - world->position[i].width / 2 + 1 &&
-				temp.x - temp.width / 2 + 1 < world->position[i].x + world->position[i].width / 2 - 1 &&
-				temp.y + temp.height / 2 - 1 > world->position[i].y - world->position[i].height / 2 + 1 &&
-				temp.y - temp.height / 2 + 1 < world->position[i].y + world->position[i].height / 2 + 1
-				&& world->collision[i].active) {
-				*entity_number = world->collision[i].type;
-				*hit_entity = i;
-				return;
-			}
+	count = find_collider_candidates(world, temp.level, left, top, right, bottom);
+	
+	for (i = 0; i < count; i++) {
+		slot = colliders->candidates[i];
+		
+		if (right > colliders->x[slot] - colliders->half_width[slot] + 1 &&
+			left < colliders->x[slot] + colliders->half_width[slot] - 1 &&
+			bottom > colliders->y[slot] - colliders->half_height[slot] + 1 &&
+			top < colliders->y[slot] + colliders->half_height[slot] + 1 &&
+			colliders->active[slot] && colliders->entity[slot] != entity) {
+			*entity_number = world->collision[colliders->entity[slot]].type;
+			*hit_entity = colliders->entity[slot];
+			return;
 		}
 	}
 	
@@ -158,6 +482,53 @@ void entity_collision(World* world, unsigned int entity, PositionComponent temp,
 	*hit_entity = MAX_ENTITIES;
 }
 
+/**
+ * Finds the active entities that collide with an area.
+ *
+ * The hits are written to the caller's buffer in entity order, so nothing is
+ * allocated. Once the buffer is full the rest are left out.
+ *
+ * @param[in,out] world    A pointer to the world structure.
+ * @param[in]     query    The area, and which entities to find.
+ * @param[out]    hits     The entities that were found.
+ * @param[in]     max_hits The size of the hits buffer.
+ *
+ * @return The number of entities written to hits.
+ */
+unsigned int query_area(World *world, const AreaQuery *query, unsigned int *hits, unsigned int max_hits) {
+	ColliderArrays *colliders = &world->colliders;
+	unsigned int count, slot, type;
+	unsigned int i, j;
+	unsigned int num_hits = 0;
+	
+	count = find_collider_candidates(world, query->level, query->left, query->top, query->right, query->bottom);
+	
+	for (i = 0; i < count && num_hits < max_hits; i++) {
+		slot = colliders->candidates[i];
+		
+		if (!colliders->active[slot] || colliders->entity[slot] == query->exclude ||
+			query->right <= colliders->x[slot] - colliders->half_width[slot] + 1 ||
+			query->left >= colliders->x[slot] + colliders->half_width[slot] - 1 ||
+			query->bottom <= colliders->y[slot] - colliders->half_height[slot] + 1 ||
+			query->top >= colliders->y[slot] + colliders->half_height[slot] + 1) {
+			continue;
+		}
+		
+		if (query->types != NULL) {
+			type = world->collision[colliders->entity[slot]].type;
+			for (j = 0; j < query->type_count && query->types[j] != type; j++)
+				;
+			if (j == query->type_count) {
+				continue;
+			}
+		}
+		
+		hits[num_hits++] = colliders->entity[slot];
+	}
+	
+	return num_hits;
+}
+
 /**
  * Checks if a player is stuck in another player and moves the other player
  * out of the current player.
@@ -193,6 +564,8 @@ void anti_stuck_system(World *world, unsigned int curEntityID, int otherEntityID
 	} else if (downDist <= leftDist && downDist <= upDist && downDist <= rightDist && !(world->command[curEntityID].commands[C_UP])) {
 		world->position[otherEntityID].y = world->position[curEntityID].y - world->position[otherEntityID].height - 1;
 	}
+	
+	sync_collider(world, otherEntityID);
 }
 
 /**
@@ -216,8 +589,18 @@ int check_tag_collision(World* world, unsigned int currentEntityID) {
 	entity.x = world->position[currentEntityID].x;
 	entity.y = world->position[currentEntityID].y;
 
-	for (unsigned int i = 0; i < MAX_ENTITIES; i++) {
-		if (i != currentEntityID && (world->mask[i] & COLLISION_MASK) != 0) {
+	if (world->colliders.dirty) {
+		gather_colliders(world);
+	}
+
+	//these checks go from the corner of the other entity rather than its centre, so reach back further.
+	unsigned int count = find_collider_candidates(world, entity.level,
+		entity.x - TAG_DISTANCE - world->colliders.max_half_width - 1, entity.y - TAG_DISTANCE - world->colliders.max_half_height - 1,
+		entity.x + entity.width + TAG_DISTANCE, entity.y + entity.height + TAG_DISTANCE);
+
+	for (unsigned int candidate = 0; candidate < count; candidate++) {
+		unsigned int i = world->colliders.entity[world->colliders.candidates[candidate]];
+		if (i != currentEntityID) {
 			switch(lastDirection) {
 				case DIRECTION_RIGHT:
 					if (entity.x + entity.width -1 + TAG_DISTANCE > world->position[i].x + 1 &&
@@ -271,6 +654,26 @@ int check_tag_collision(World* world, unsigned int currentEntityID) {
 	return -1;
 }
 
+/**
+ * Sets up a query for the area around a player that the action key reaches.
+ *
+ * @param[in]  world      A pointer to the world structure.
+ * @param[in]  entity     The player entity number.
+ * @param[in]  types      The collision types to find.
+ * @param[in]  type_count The number of types.
+ * @param[out] query      The query.
+ */
+static void action_area(World *world, unsigned int entity, const unsigned int *types, unsigned int type_count, AreaQuery *query) {
+	query->level = world->position[entity].level;
+	query->left = world->position[entity].x - ACTION_RANGE / 2 + 1;
+	query->top = world->position[entity].y - ACTION_RANGE / 2 + 1;
+	query->right = world->position[entity].x + ACTION_RANGE / 2 - 1;
+	query->bottom = world->position[entity].y + ACTION_RANGE / 2 - 1;
+	query->exclude = entity;
+	query->types = types;
+	query->type_count = type_count;
+}
+
 /**
  * Checks if a the tag key was pressed and if the current player is a guard.
  * If a player was tagged, the tag data is sent to the server.
@@ -283,17 +686,18 @@ int check_tag_collision(World* world, unsigned int currentEntityID) {
  */
 bool tag_player(World* world, unsigned int entity) {
 	if (world->collision[entity].type == COLLISION_GUARD && world->command[entity].commands[C_ACTION]) {
-		unsigned int* collision_list = NULL;
-		unsigned int num_collisions;
-		if (spacebar_collision(world, entity, &collision_list, &num_collisions)) {
-			unsigned int i;
-			for (i = 0; i < num_collisions; i++) {
-				if (world->collision[collision_list[i]].type == COLLISION_HACKER) {
-					printf("tagged\n");
-					send_tag(world, send_router_fd[WRITE], world->player[collision_list[i]].playerNo);
-				}
-			}
-			cleanup_spacebar_collision(&collision_list);
+		static const unsigned int types[] = { COLLISION_HACKER };
+		unsigned int hits[MAX_AREA_HITS];
+		unsigned int num_hits;
+		AreaQuery query;
+		unsigned int i;
+		
+		action_area(world, entity, types, 1, &query);
+		num_hits = query_area(world, &query, hits, MAX_AREA_HITS);
+		
+		for (i = 0; i < num_hits; i++) {
+			printf("tagged\n");
+			send_tag(world, send_router_fd[WRITE], world->player[hits[i]].playerNo);
 		}
 	}
 	return false;
@@ -311,20 +715,23 @@ bool tag_player(World* world, unsigned int entity) {
  */
 bool capture_objective(World* world, unsigned int entity) {
 	if (world->collision[entity].type == COLLISION_HACKER && world->command[entity].commands[C_ACTION]) {
-		unsigned int* collision_list = NULL;
-		unsigned int num_collisions;
+		static const unsigned int types[] = { COLLISION_TARGET };
+		unsigned int hits[MAX_AREA_HITS];
+		unsigned int num_hits;
+		AreaQuery query;
 		bool captured = false;
-		if (spacebar_collision(world, entity, &collision_list, &num_collisions)) {
-			unsigned int i;
-			for (i = 0; i < num_collisions; i++) {
-				if (world->collision[collision_list[i]].type == COLLISION_TARGET && world->objective[collision_list[i]].status == 1) {
-					printf("You captured an objective[%u] %u! You is the best!\n", collision_list[i], world->objective[collision_list[i]].objectiveID);
-					world->objective[collision_list[i]].status = 2;
-					captured = true;
-					play_animation(world, collision_list[i], "captured");
-				}
+		unsigned int i;
+		
+		action_area(world, entity, types, 1, &query);
+		num_hits = query_area(world, &query, hits, MAX_AREA_HITS);
+		
+		for (i = 0; i < num_hits; i++) {
+			if (world->objective[hits[i]].status == 1) {
+				printf("You captured an objective[%u] %u! You is the best!\n", hits[i], world->objective[hits[i]].objectiveID);
+				world->objective[hits[i]].status = 2;
+				captured = true;
+				play_animation(world, hits[i], "captured");
 			}
-			cleanup_spacebar_collision(&collision_list);
 		}
 		if (captured) {
 			send_objectives(world, send_router_fd[WRITE]);
@@ -333,63 +740,6 @@ bool capture_objective(World* world, unsigned int entity) {
 	return false;
 }
 
-/**
- * Checks if there is collidable object in the vicinity of the current player.
- * Returns a list of all collidable objects and the number of collisions.
- *
- * @param[in,out] world      		A pointer to the world structure.
- * @param[in,out] entity   			The player entity number.
- * @param[in,out] collision_list    The list of all nearby collisions.
- * @param[in,out] num_collisions    The number of nearby collisions.
- *
- * @designer 
- * @author   
- */
-bool spacebar_collision(World* world, unsigned int entity, unsigned int** collision_list, unsigned int* num_collisions) {
-	unsigned int i = 0;
-	PositionComponent position;
-	position.x = world->position[entity].x;
-	position.y = world->position[entity].y;
-	position.width = 60;
-	position.height = 60;
-	position.level = world->position[entity].level;
-	
-	*num_collisions = 0;
-	
-	for (i = 0; i < MAX_ENTITIES; i++) {
-		if (i != entity && IN_THIS_COMPONENT(world->mask[i], COLLISION_MASK)) {
-			if (position.x + position.width / 2 - 1 > world->position[i].x - world->position[i].width / 2 + 1 &&
-				position.x - position.width / 2 + 1 < world->position[i].x + world->position[i].width / 2 - 1 &&
-				position.y + position.height / 2 - 1 > world->position[i].y - world->position[i].height / 2 + 1 &&
-				position.y - position.height / 2 + 1 < world->position[i].y + world->position[i].height / 2 + 1
-				&& world->collision[i].active) {
-				if ((*collision_list = (unsigned int*)realloc(*collision_list, sizeof(unsigned int) * ((*num_collisions) + 1))) == NULL) {
-					return false;
-				}
-				(*collision_list)[*num_collisions] = i;
-				(*num_collisions)++;
-			}
-		}
-	}
-	
-	return ((*num_collisions) > 0);
-}
-
-/**
- * Frees up the memory taken up by the collision list.
- * 
- * @param[in,out] collision_list    The list of all nearby collisions.
- *
- * @designer 
- * @author   
- */
-void cleanup_spacebar_collision(unsigned int** collision_list) {
-	if (*collision_list != NULL) {
-		free(*collision_list);
-		*collision_list = NULL;
-	}
-}
-
 /**
  * Creates a speed belt on the map.
  * 
@@ -399,6 +749,8 @@ void cleanup_spacebar_collision(unsigned int** collision_list) {
  * @param[in] yPos         The tile ypos.
  * @param[in] level        The level that the tile is on.
  *
+ * @return The speed belt entity, or -1 on failure.
+ *
  * @designer 
  * @author   
  */
@@ -411,6 +763,11 @@ unsigned int create_stile(World * world, int type, int xPos, int yPos, int level
 
 	unsigned int speed_tile = create_entity(world, COMPONENT_RENDER_PLAYER | COMPONENT_POSITION | COMPONENT_ANIMATION | COMPONENT_COLLISION | COMPONENT_STILE);
 	
+	if (speed_tile == MAX_ENTITIES)
+	{
+		return -1;
+	}
+	
 	int x = xPos / TILE_WIDTH;
 	int y = yPos / TILE_HEIGHT;
 	
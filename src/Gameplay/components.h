@@ -48,11 +48,15 @@ typedef struct {
 /**
  * Describes a floor's properties.
  *
+ * The collision types and the wall bits are in one allocation, use LEVEL_TILE
+ * and LEVEL_WALL from level.h to read them.
+ *
  * @struct LevelComponent
  */
 typedef struct {
 	int levelID;
-	int** map;
+	unsigned char *map;   /**< The collision type of every tile, row by row. */
+	unsigned char *walls; /**< One bit for every tile, row by row, set for walls. */
 	int width;
 	int height;
 	int tileSize;
@@ -9,4 +9,7 @@
 #define L_WALL			2 /**< The tile is a wall tile (can't be traversed). */
 #define L_STAIR			3 /**< The tile is a stair tile (sends the entity to a different floor). */
 
+#define LEVEL_TILE(level, x, y) ((level)->map[(y) * (level)->width + (x)]) /**< The collision type of a tile in a LevelComponent. */
+#define LEVEL_WALL(level, x, y) (((level)->walls[((y) * (level)->width + (x)) >> 3] >> (((y) * (level)->width + (x)) & 7)) & 1) /**< Whether a tile in a LevelComponent is a wall. */
+
 #endif
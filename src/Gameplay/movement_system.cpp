@@ -7,6 +7,7 @@
 #include "../world.h"
 #include "collision.h"
 #include "powerups.h"
+#include "../Graphics/map_loader.h"
 #include "stdio.h"
 #include <math.h>
 
@@ -59,115 +60,107 @@ void add_force(World* world, unsigned int entity, float magnitude, float dir) {
 /**
  * Applies the entity's velocity to it's position (x vector).
  * 
- * It also scales the speed to the FPS of the game, so that entities move at the same speed
- * across all systems.
+ * It moves the entity by one simulation tick, so that entities move at the same speed
+ * across all systems. The move is swept against the walls, so the entity stops at the
+ * first wall in its way however fast it is going.
  * @param[in, out]	world	A pointer to the world structure
  * @param[in]		entity	The entity to whose position is changed
  * @param[in, out]	temp	The temporary position that is being applied
- * @param[in]		fps		The frames-per-second class that allows scaling
+ * @param[out]		contact	How far the entity moved and the wall it hit (if any)
  * 
  * @return	void
  * 
  * @designer	Josh Campbell
  * @author		Josh Campbell
  */
-void apply_force_x(World* world, unsigned int entity, PositionComponent* temp, FPS fps) {
-	temp->x += world->movement[entity].movX * ((double)GAME_SPEED / fps.getFPS());
+void apply_force_x(World* world, unsigned int entity, PositionComponent* temp, WallContact* contact) {
+	sweep_walls_x(world, temp, world->movement[entity].movX * SIM_STEP, contact);
 }
 
 /**
- * Removes the entity's velocity from it's position (x vector).
+ * Removes the entity's last move from it's position (x vector).
  * 
- * It also scales the speed to the FPS of the game, so that entities move at the same speed
- * across all systems.
- * @param[in, out]	world	A pointer to the world structure
- * @param[in]		entity	The entity to whose position is changed
  * @param[in, out]	temp	The temporary position that is being applied
- * @param[in]		fps		The frames-per-second class that allows scaling
+ * @param[in]		contact	The move that apply_force_x made
  * 
  * @return	void
  * 
  * @designer	Josh Campbell
  * @author		Josh Campbell
  */
-void remove_force_x(World* world, unsigned int entity, PositionComponent* temp, FPS fps) {
-	temp->x -= world->movement[entity].movX * ((double)GAME_SPEED / fps.getFPS());
+void remove_force_x(PositionComponent* temp, const WallContact* contact) {
+	temp->x -= contact->distance;
 }
 
 /**
  * Applies the entity's deceleration to it's velocity (x vector).
  * 
- * It also scales the speed to the FPS of the game, so that entities move at the same speed
+ * It moves the entity by one simulation tick, so that entities move at the same speed
  * across all systems.
  * @param[in, out]	world	A pointer to the world structure
  * @param[in]		entity	The entity to whose position is changed
  * @param[in, out]	temp	The temporary position that is being applied
- * @param[in]		fps		The frames-per-second class that allows scaling
  * 
  * @return	void
  * 
  * @designer	Josh Campbell
  * @author		Josh Campbell
  */
-void apply_deceleration_x(World* world, unsigned int entity, FPS fps) {
-	world->movement[entity].movX *= 1 - world->movement[entity].friction * ((double)GAME_SPEED / fps.getFPS());
+void apply_deceleration_x(World* world, unsigned int entity) {
+	world->movement[entity].movX *= 1 - world->movement[entity].friction * SIM_STEP;
 }
 
 /**
  * Applies the entity's velocity to it's position (y vector).
  * 
- * It also scales the speed to the FPS of the game, so that entities move at the same speed
- * across all systems.
+ * It moves the entity by one simulation tick, so that entities move at the same speed
+ * across all systems. The move is swept against the walls, so the entity stops at the
+ * first wall in its way however fast it is going.
  * @param[in, out]	world	A pointer to the world structure
  * @param[in]		entity	The entity to whose position is changed
  * @param[in, out]	temp	The temporary position that is being applied
- * @param[in]		fps		The frames-per-second class that allows scaling
+ * @param[out]		contact	How far the entity moved and the wall it hit (if any)
  * 
  * @return	void
  * 
  * @designer	Josh Campbell
  * @author		Josh Campbell
  */
-void apply_force_y(World* world, unsigned int entity, PositionComponent* temp, FPS fps) {
-	temp->y += world->movement[entity].movY * ((double)GAME_SPEED / fps.getFPS());
+void apply_force_y(World* world, unsigned int entity, PositionComponent* temp, WallContact* contact) {
+	sweep_walls_y(world, temp, world->movement[entity].movY * SIM_STEP, contact);
 }
 
 /**
- * Removes the entity's velocity from it's position (y vector).
+ * Removes the entity's last move from it's position (y vector).
  * 
- * It also scales the speed to the FPS of the game, so that entities move at the same speed
- * across all systems.
- * @param[in, out]	world	A pointer to the world structure
- * @param[in]		entity	The entity to whose position is changed
  * @param[in, out]	temp	The temporary position that is being applied
- * @param[in]		fps		The frames-per-second class that allows scaling
+ * @param[in]		contact	The move that apply_force_y made
  * 
  * @return	void
  * 
  * @designer	Josh Campbell
  * @author		Josh Campbell
  */
-void remove_force_y(World* world, unsigned int entity, PositionComponent* temp, FPS fps) {
-	temp->y -= world->movement[entity].movY * ((double)GAME_SPEED / fps.getFPS());
+void remove_force_y(PositionComponent* temp, const WallContact* contact) {
+	temp->y -= contact->distance;
 }
 
 /**
  * Applies the entity's deceleration to it's velocity (y vector).
  * 
- * It also scales the speed to the FPS of the game, so that entities move at the same speed
+ * It moves the entity by one simulation tick, so that entities move at the same speed
  * across all systems.
  * @param[in, out]	world	A pointer to the world structure
  * @param[in]		entity	The entity to whose position is changed
  * @param[in, out]	temp	The temporary position that is being applied
- * @param[in]		fps		The frames-per-second class that allows scaling
  * 
  * @return	void
  * 
  * @designer	Josh Campbell
  * @author		Josh Campbell
  */
-void apply_deceleration_y(World* world, unsigned int entity, FPS fps) {
-	world->movement[entity].movY *= 1 - world->movement[entity].friction * ((double)GAME_SPEED / fps.getFPS());
+void apply_deceleration_y(World* world, unsigned int entity) {
+	world->movement[entity].movY *= 1 - world->movement[entity].friction * SIM_STEP;
 }
 
 /* SPECIAL TILES */
@@ -190,40 +183,42 @@ void add_force_acceleration_x(World * world, MovementComponent& movement, float
 /**
  * Handles the solid-wall x axis collisions, be it with walls or solid entities.
  * 
+ * The move was already stopped at the wall by apply_force_x, so hitting a wall only
+ * takes away the velocity going into it, against the wall's normal.
+ * 
  * @param[in, out]	world			A pointer to the world struct.
  * @param[in]		entity			The current entity id whose collisions are being checked.
  * @param[in, out]	temp			The temporary position of the entity.
  * @praam[in]		entity_number	The entity collision type of the hit entity.
- * @param[in]		tile_number		The tile collision type of the hit tile.
- * @param[in]		fps				The current frames per second.
+ * @param[in]		contact			The move that apply_force_x made.
  * 
  * @return	void
  * 
  * @designer	Josh Campbell
  * @author		Josh Campbell & Clark Allenby
  */
-void handle_x_collision(World* world, unsigned int entity, PositionComponent* temp, unsigned int entity_number, unsigned int tile_number, FPS fps) {
+void handle_x_collision(World* world, unsigned int entity, PositionComponent* temp, unsigned int entity_number, const WallContact* contact) {
 
 	switch(entity_number) {
 		case COLLISION_SOLID:
 		case COLLISION_HACKER:
 		case COLLISION_GUARD:
 		case COLLISION_TARGET:
-			remove_force_x(world, entity, temp, fps);
+			remove_force_x(temp, contact);
 			world->movement[entity].movX = 0;
 			break;
 		default:
 			break;
 		}
 
-	switch(tile_number) {
+	switch(contact->tile) {
 		case COLLISION_WALL:
-			remove_force_x(world, entity, temp, fps);
-			world->movement[entity].movX = 0;
+			if (contact->normal_x * world->movement[entity].movX < 0)
+				world->movement[entity].movX = 0;
 			break;
 		default:
 			if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_CONTROLLABLE)) {
-				apply_deceleration_x(world, entity, fps);
+				apply_deceleration_x(world, entity);
 			}
 			break;
 	}
@@ -232,53 +227,147 @@ void handle_x_collision(World* world, unsigned int entity, PositionComponent* te
 /**
  * Handles the solid-wall y axis collisions, be it with walls or solid entities.
  * 
+ * The move was already stopped at the wall by apply_force_y, so hitting a wall only
+ * takes away the velocity going into it, against the wall's normal.
+ * 
  * @param[in, out]	world			A pointer to the world struct.
  * @param[in]		entity			The current entity id whose collisions are being checked.
  * @param[in, out]	temp			The temporary position of the entity.
  * @praam[in]		entity_number	The entity collision type of the hit entity.
- * @param[in]		tile_number		The tile collision type of the hit tile.
- * @param[in]		fps				The current frames per second.
+ * @param[in]		contact			The move that apply_force_y made.
  * 
  * @return	void
  * 
  * @designer	Josh Campbell
  * @author		Josh Campbell & Clark Allenby
  */
-void handle_y_collision(World* world, unsigned int entity, PositionComponent* temp, unsigned int entity_number, unsigned int tile_number, FPS fps) {
+void handle_y_collision(World* world, unsigned int entity, PositionComponent* temp, unsigned int entity_number, const WallContact* contact) {
 	switch(entity_number) {
 		case COLLISION_SOLID:
 		case COLLISION_HACKER:
 		case COLLISION_GUARD:
 		case COLLISION_TARGET:
-			remove_force_y(world, entity, temp, fps);
+			remove_force_y(temp, contact);
 			world->movement[entity].movY = 0;
 			break;
 	}
 	
-	switch(tile_number) {
+	switch(contact->tile) {
 		case COLLISION_WALL:
-			remove_force_y(world, entity, temp, fps);
-			world->movement[entity].movY = 0;
+			if (contact->normal_y * world->movement[entity].movY < 0)
+				world->movement[entity].movY = 0;
 			break;
 		default:
 			if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_CONTROLLABLE)) {
-				apply_deceleration_y(world, entity, fps);
+				apply_deceleration_y(world, entity);
 			}
 			break;
 	}
 }
+
 /**
- * Recreates the environment with the map specified without deleting the characters.
- *			
- * @param[in, out]  world  	game world, searched for updates
- * @param[out] 		targl 	game map to load (floor level)
+ * Adds the forces from the directions an entity is being told to move in.
+ * 
+ * @param[in, out]	world	A pointer to the world struct.
+ * @param[in]		entity	The entity being moved.
+ * @param[in]		command	The entity's commands.
+ * 
+ * @return	void
+ * 
+ * @designer	Josh Campbell & Clark Allenby
+ * @author		Clark Allenby & Josh Campbell
+ */
+static void add_command_forces(World* world, unsigned int entity, CommandComponent* command) {
+	if (command->commands[C_UP]) {
+		world->movement[entity].lastDirection = DIRECTION_UP;
+		add_force(world, entity, world->movement[entity].acceleration, -90);
+	}
+	
+	if (command->commands[C_DOWN]) {
+		world->movement[entity].lastDirection = DIRECTION_DOWN;
+		add_force(world, entity, world->movement[entity].acceleration, 90);
+	}
+	
+	if (command->commands[C_LEFT]) {
+		world->movement[entity].lastDirection = DIRECTION_LEFT;
+		add_force(world, entity, world->movement[entity].acceleration, 180);
+	}
+	
+	if (command->commands[C_RIGHT]) {
+		world->movement[entity].lastDirection = DIRECTION_RIGHT;
+		add_force(world, entity, world->movement[entity].acceleration, 0);
+	}
+}
+
+/**
+ * Moves an entity by its velocity for one tick, along x and then y, stopping it at
+ * walls and solid entities.
+ * 
+ * @param[in, out]	world			A pointer to the world struct.
+ * @param[in]		entity			The entity being moved.
+ * @param[in, out]	temp			The temporary position of the entity.
+ * @param[out]		entity_number	The collision type of the last entity that was hit.
+ * @param[out]		hit_entity		The last entity that was hit.
+ * @param[out]		contact			The move along y.
+ * 
+ * @return	void
+ * 
+ * @designer	Josh Campbell & Clark Allenby
+ * @author		Clark Allenby & Josh Campbell
+ */
+static void move_entity(World* world, unsigned int entity, PositionComponent* temp, unsigned int* entity_number, unsigned int* hit_entity, WallContact* contact) {
+	apply_force_x(world, entity, temp, contact);
+	entity_collision(world, entity, *temp, entity_number, hit_entity);
+	handle_x_collision(world, entity, temp, *entity_number, contact);
+	
+	apply_force_y(world, entity, temp, contact);
+	entity_collision(world, entity, *temp, entity_number, hit_entity);
+	handle_y_collision(world, entity, temp, *entity_number, contact);
+}
+
+/**
+ * Runs one tick of a controllable entity's movement again, from its current commands.
  *
- * @return  void
+ * Only the movement is run: nothing it touches is triggered, no tiles are made and
+ * nothing is sent, so it can be used to replay inputs that were already played.
+ * 
+ * @param[in, out]	world	A pointer to the world struct.
+ * @param[in]		entity	The entity being moved.
+ * 
+ * @return	void
+ */
+void replay_movement(World* world, unsigned int entity) {
+	PositionComponent temp = world->position[entity];
+	unsigned int entity_number;
+	unsigned int hit_entity;
+	WallContact contact;
+	
+	add_command_forces(world, entity, &world->command[entity]);
+	
+	if (IN_THIS_COMPONENT(world->mask[entity], COLLISION_MASK)) {
+		move_entity(world, entity, &temp, &entity_number, &hit_entity, &contact);
+	}
+	
+	world->position[entity].x = temp.x;
+	world->position[entity].y = temp.y;
+	sync_collider(world, entity);
+}
+/**
+ * Gets the files of a floor.
+ *
+ * The top floor depends on how many objectives and players are in the game,
+ * and uses a different map than the same floor lower down.
+ *
+ * @param[in]  targl      game map to load (floor level)
+ * @param[out] file_map   the floor's map file
+ * @param[out] file_tiles the floor's tile set file
+ *
+ * @return  0 on success, -1 if there is no such floor
  *
  * @designer    Ramzi Chennafi
  * @author      Ramzi Chennafi
  */
-void rebuild_floor(World* world, int targl)
+static int get_floor_files(int targl, const char **file_map, const char **file_tiles)
 {
     int num_objectives = 0;
     int num_players = 0;
@@ -310,78 +399,113 @@ void rebuild_floor(World* world, int targl)
 
     topfloor = num_objectives/OBJECTIVES_PER_FLOOR;
 
-	destroy_world_not_player(world);
     switch (targl) {
 		case 0:
-			map_init(world, "assets/Graphics/map/map_00/map00.txt", "assets/Graphics/map/map_00/tiles.txt");
+			*file_map = "assets/Graphics/map/map_00/map00.txt";
+			*file_tiles = "assets/Graphics/map/map_00/tiles.txt";
 			break;
 		case 1:
-			map_init(world, "assets/Graphics/map/map_01/map01.txt", "assets/Graphics/map/map_01/tiles.txt");
+			*file_map = "assets/Graphics/map/map_01/map01.txt";
+			*file_tiles = "assets/Graphics/map/map_01/tiles.txt";
 			break;
 		case 2:
-			map_init(world, "assets/Graphics/map/map_02/map02.txt", "assets/Graphics/map/map_02/tiles.txt");
+			*file_map = "assets/Graphics/map/map_02/map02.txt";
+			*file_tiles = "assets/Graphics/map/map_02/tiles.txt";
 			break;
 		case 3:
-			if(topfloor == 3)
-			{
-			    map_init(world, "assets/Graphics/map/map_03/map03_topfloor.txt", "assets/Graphics/map/map_03/tiles.txt");
-			}
-            else
-            {
-                map_init(world, "assets/Graphics/map/map_03/map03.txt", "assets/Graphics/map/map_03/tiles.txt");
-            }
+			*file_map = (topfloor == 3) ? "assets/Graphics/map/map_03/map03_topfloor.txt" : "assets/Graphics/map/map_03/map03.txt";
+			*file_tiles = "assets/Graphics/map/map_03/tiles.txt";
 			break;
 		case 4:
-			if(topfloor == 4)
-			{
-			    map_init(world, "assets/Graphics/map/map_04/map04_topfloor.txt", "assets/Graphics/map/map_04/tiles.txt");
-			}
-            else
-            {
-                map_init(world, "assets/Graphics/map/map_04/map04.txt", "assets/Graphics/map/map_04/tiles.txt");
-            }
+			*file_map = (topfloor == 4) ? "assets/Graphics/map/map_04/map04_topfloor.txt" : "assets/Graphics/map/map_04/map04.txt";
+			*file_tiles = "assets/Graphics/map/map_04/tiles.txt";
 			break;
 		case 5:
-			if(topfloor == 5)
-			{
-			    map_init(world, "assets/Graphics/map/map_05/map05_topfloor.txt", "assets/Graphics/map/map_05/tiles.txt");
-			}
-            else
-            {
-                map_init(world, "assets/Graphics/map/map_05/map05.txt", "assets/Graphics/map/map_05/tiles.txt");
-            }
+			*file_map = (topfloor == 5) ? "assets/Graphics/map/map_05/map05_topfloor.txt" : "assets/Graphics/map/map_05/map05.txt";
+			*file_tiles = "assets/Graphics/map/map_05/tiles.txt";
 			break;
 		case 6:
-			if(topfloor == 6)
-			{
-			    map_init(world, "assets/Graphics/map/map_06/map06_topfloor.txt", "assets/Graphics/map/map_06/tiles.txt");
-			}
-            else
-            {
-                map_init(world, "assets/Graphics/map/map_06/map06.txt", "assets/Graphics/map/map_06/tiles.txt");
-            }
+			*file_map = (topfloor == 6) ? "assets/Graphics/map/map_06/map06_topfloor.txt" : "assets/Graphics/map/map_06/map06.txt";
+			*file_tiles = "assets/Graphics/map/map_06/tiles.txt";
 			break;
 		case 7:
-			if(topfloor == 7)
-			{
-			    map_init(world, "assets/Graphics/map/map_07/map07_topfloor.txt", "assets/Graphics/map/map_07/tiles.txt");
-			}
-            else
-            {
-                map_init(world, "assets/Graphics/map/map_07/map07.txt", "assets/Graphics/map/map_07/tiles.txt");
-            }
+			*file_map = (topfloor == 7) ? "assets/Graphics/map/map_07/map07_topfloor.txt" : "assets/Graphics/map/map_07/map07.txt";
+			*file_tiles = "assets/Graphics/map/map_07/tiles.txt";
 			break;
 		case 8:
-                map_init(world, "assets/Graphics/map/map_08/map08.txt", "assets/Graphics/map/map_08/tiles.txt");
+			*file_map = "assets/Graphics/map/map_08/map08.txt";
+			*file_tiles = "assets/Graphics/map/map_08/tiles.txt";
 			break;
 		case 9:
-			map_init(world, "assets/Graphics/map/map_09/map09.txt", "assets/Graphics/map/map_09/tiles.txt");
+			*file_map = "assets/Graphics/map/map_09/map09.txt";
+			*file_tiles = "assets/Graphics/map/map_09/tiles.txt";
 			break;
+		default:
+			return -1;
 	}
-	for (unsigned int i = 0; i < MAX_ENTITIES; i++) {
-		if (IN_THIS_COMPONENT(world->mask[i], COMPONENT_LEVEL)) {
-			world->level[i].levelID = targl;
-			break;
+	return 0;
+}
+
+/**
+ * Recreates the environment with the map specified without deleting the characters.
+ *			
+ * @param[in, out]  world  	game world, searched for updates
+ * @param[out] 		targl 	game map to load (floor level)
+ *
+ * @return  void
+ *
+ * @designer    Ramzi Chennafi
+ * @author      Ramzi Chennafi
+ */
+void rebuild_floor(World* world, int targl)
+{
+	const char *file_map;
+	const char *file_tiles;
+
+	destroy_world_not_player(world);
+	if (get_floor_files(targl, &file_map, &file_tiles) == 0) {
+		map_init(world, file_map, file_tiles);
+	}
+	unsigned int level = first_entity(get_entity_list(world, COMPONENT_LEVEL));
+	if (level < MAX_ENTITIES) {
+		set_level_floor(world, level, targl);
+	}
+	prefetch_adjacent_floors(world);
+}
+
+/**
+ * Rebuilds the floor from the deferred commands.
+ *
+ * @param[in, out]  world  	game world
+ * @param[in] 		entity 	unused
+ * @param[in] 		targl 	game map to load (floor level)
+ *
+ * @return  void
+ */
+static void rebuild_floor_command(World* world, unsigned int entity, int targl)
+{
+	rebuild_floor(world, targl);
+}
+
+/**
+ * Starts reading in the floors that the current floor's stairs lead to.
+ *
+ * The floors are read by the map loader thread, so taking the stairs only
+ * has to create the new floor's entities.
+ *
+ * @param[in] world game world, searched for stairs
+ *
+ * @return  void
+ */
+void prefetch_adjacent_floors(World* world)
+{
+	const char *file_map;
+	const char *file_tiles;
+	EntityList *stairs = get_entity_list(world, COMPONENT_WORMHOLE);
+
+	for (unsigned int i = first_entity(stairs); i < MAX_ENTITIES; i = next_entity(stairs, i)) {
+		if (get_floor_files(world->wormhole[i].targetLevel, &file_map, &file_tiles) == 0) {
+			prefetch_map(file_map, file_tiles);
 		}
 	}
 }
@@ -411,7 +535,8 @@ void handle_entity_collision(World* world, unsigned int entity, unsigned int ent
 				move_request(world, send_router_fd[WRITE], targl, targx, targy);
 				if(!network_ready)
 				{
-					rebuild_floor(world, targl);
+					//the floor is torn down, so wait until the movement system is done with it.
+					defer_call(world, rebuild_floor_command, MAX_ENTITIES, targl);
 					return;
 				}
 				floor_change_flag = 1;
@@ -440,11 +565,6 @@ void handle_entity_collision(World* world, unsigned int entity, unsigned int ent
 			add_force(world, entity, 20.0, 180);
 			break;
 	}
-		
-	if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_CONTROLLABLE) && world->controllable[entity].active) {
-		tag_player(world, entity);
-		capture_objective(world, entity);
-	}
 }
 /**
  * Updates the visibility of a tile based on player position and destroys it based on
@@ -472,15 +592,15 @@ int manage_special_tiles(World * world, unsigned int entity)
 
 		if((current_time - world->tile[entity].start_time) >= 5000)
 		{
-			destroy_entity(world, entity);
+			defer_destroy_entity(world, entity);
 		}
 		else if(world->position[entity].level == world->position[player_entity].level)
 		{
-			world->mask[entity] |= COMPONENT_RENDER_PLAYER | COMPONENT_COLLISION;
+			enable_component(world, entity, COMPONENT_RENDER_PLAYER | COMPONENT_COLLISION);
 		}
 		else if(world->position[entity].level != world->position[player_entity].level)
 		{
-			world->mask[entity] &= ~(COMPONENT_RENDER_PLAYER | COMPONENT_COLLISION);
+			disable_component(world, entity, COMPONENT_RENDER_PLAYER | COMPONENT_COLLISION);
 		}
 
 		return 1;
@@ -492,26 +612,43 @@ int manage_special_tiles(World * world, unsigned int entity)
  * Determines the inputs applied to the entity and adds forces in
  * the specified directions.
  *
+ * Runs one simulation tick. Where each entity was at the start of the tick is
+ * kept so it can be drawn between ticks.
+ *
+ * Only the physics is run here. Whatever a key press does once, and whatever is
+ * sent to the server, is done once a frame by player_action_system.
+ *
  * @param[in, out]	world	A pointer to the world struct.
- * @param[in]		fps		current frame rate.
  *
  * @return	void
  * 
  * @designer	Josh Campbell & Clark Allenby
  * @author		Clark Allenby & Josh Campbell
  */
-void movement_system(World* world, FPS fps, int sendpipe) {
+void movement_system(World* world) {
 	unsigned int entity;
 	PositionComponent		*position;
 	CommandComponent		*command;
 	ControllableComponent 	*controllable;
 	MovementComponent		*movement;
+	EntityList *tiles = get_entity_list(world, COMPONENT_STILE);
+	EntityList *list = get_entity_list(world, STANDARD_MASK);
 
-	//loop through each entity and see if the system can do work on it.
-	for(entity = 0; entity < MAX_ENTITIES; entity++) {
+	for(entity = first_entity(tiles); entity < MAX_ENTITIES; entity = next_entity(tiles, entity)) {
+		manage_special_tiles(world, entity);
+	}
+	
+	//other systems and the network move entities between frames, so gather the colliders again.
+	world->colliders.dirty = true;
+	
+	for(entity = first_entity(list); entity < MAX_ENTITIES; entity = next_entity(list, entity)) {
+		world->previous[entity].x = world->position[entity].x;
+		world->previous[entity].y = world->position[entity].y;
+		world->previous[entity].level = world->position[entity].level;
+	}
 
-		if(manage_special_tiles(world, entity))
-			continue;
+	//loop through each entity that can move and see if the system can do work on it.
+	for(entity = first_entity(list); entity < MAX_ENTITIES; entity = next_entity(list, entity)) {
 
 		//For controllable entities
 		if (IN_THIS_COMPONENT(world->mask[entity], CONTROLLABLE_MASK)) {
@@ -530,63 +667,31 @@ void movement_system(World* world, FPS fps, int sendpipe) {
 				temp.level = position->level;
 				unsigned int entity_number = 0;
 				unsigned int tile_number = 0;
+				WallContact contact;
 				unsigned int hit_entity = 0;
 				
-				if (command->commands[C_UP]) {
-					world->movement[entity].lastDirection = DIRECTION_UP;
-					add_force(world, entity, world->movement[entity].acceleration, -90);
-				}
-				
-				if (command->commands[C_DOWN]) {
-					world->movement[entity].lastDirection = DIRECTION_DOWN;
-					add_force(world, entity, world->movement[entity].acceleration, 90);
-				}
-				
-				if (command->commands[C_LEFT]) {
-					world->movement[entity].lastDirection = DIRECTION_LEFT;
-					add_force(world, entity, world->movement[entity].acceleration, 180);
-				}
-				
-				if (command->commands[C_RIGHT]) {
-					world->movement[entity].lastDirection = DIRECTION_RIGHT;
-					add_force(world, entity, world->movement[entity].acceleration, 0);
-				}
-				/* SPECIAL TILES */
-				unsigned int tile;
-				if(command->commands[C_TILE]){
-					switch(world->player[entity].tilez){
-						case TILE_BELT_RIGHT:
-							tile = create_stile(world, TILE_BELT_RIGHT, world->position[entity].x, world->position[entity].y, world->position[entity].level);
-							send_tiles(world, tile, send_router_fd[WRITE]);
-							break;
-						case TILE_BELT_LEFT: 
-							tile = create_stile(world, TILE_BELT_LEFT, world->position[entity].x, world->position[entity].y, world->position[entity].level);
-							send_tiles(world, tile, send_router_fd[WRITE]);
-							break;
-					}
-				}
-				/* SPECIAL TILES */
+				add_command_forces(world, entity, command);
 				
 				if (IN_THIS_COMPONENT(world->mask[entity], COLLISION_MASK)) {
 					
-					collision_system(world, entity, &temp, &entity_number, &tile_number, &hit_entity);
+					entity_collision(world, entity, temp, &entity_number, &hit_entity);
 					if (hit_entity != (unsigned int)-1 && (entity_number == COLLISION_HACKER || entity_number== COLLISION_GUARD)) {
 						anti_stuck_system(world, entity, hit_entity);
 					}
 
-					apply_force_x(world, entity, &temp, fps);
-					collision_system(world, entity, &temp, &entity_number, &tile_number, &hit_entity);
-					handle_x_collision(world, entity, &temp, entity_number, tile_number, fps);
-					
-					apply_force_y(world, entity, &temp, fps);
-					collision_system(world, entity, &temp, &entity_number, &tile_number, &hit_entity);
-					handle_y_collision(world, entity, &temp, entity_number, tile_number, fps);
+					move_entity(world, entity, &temp, &entity_number, &hit_entity, &contact);
+					tile_number = contact.tile;
 					
 					handle_entity_collision(world, entity, entity_number, tile_number, hit_entity);
 				 }
 				
+				//changing floors can grow the world, which moves the components.
+				position = &(world->position[entity]);
+				movement = &(world->movement[entity]);
+				
 				position->x = temp.x;
 				position->y = temp.y;
+				sync_collider(world, entity);
 
 				if (movement->movX > 0 && abs(movement->movX) > abs(movement->movY)) {
 					play_animation(world, entity, "right");
@@ -618,17 +723,6 @@ void movement_system(World* world, FPS fps, int sendpipe) {
 					cancel_animation(world, entity);
 				}
 				
-				if (position->level == 0) { // sends ready statuses from the lobby
-					if (position->x < 240) {
-						send_status(world, sendpipe, 1, PLAYER_STATE_READY);
-					}
-					else if (position->x > 1000) {
-						send_status(world, sendpipe, 2, PLAYER_STATE_READY);
-					}
-					else {
-						send_status(world, sendpipe, 0, PLAYER_STATE_WAITING);
-					}
-				}
 				powerup_system(world, entity);
 			}
 		}
@@ -646,19 +740,36 @@ void movement_system(World* world, FPS fps, int sendpipe) {
 			temp.level = position->level;
 			unsigned int entity_number = 0;
 			unsigned int tile_number = 0;
+			WallContact contact;
 			unsigned int hit_entity = 0;
 			
+			//remote players keep going on the last velocity they were sent for a little while,
+			//and are moved towards where the server last said they were.
+			if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_PLAYER)) {
+				RemoteCorrection *remote = &world->remote[entity];
+				
+				if (remote->ticks >= REMOTE_RECKONING_TICKS) {
+					movement->movX = 0;
+					movement->movY = 0;
+				}
+				else {
+					remote->ticks++;
+				}
+				
+				//the correction is swept like any other move so it can't pull them through a wall.
+				//What is left of it past a wall is dropped; a big enough error snaps them instead.
+				sweep_walls_x(world, &temp, remote->x * REMOTE_CORRECTION, &contact);
+				remote->x = (contact.tile == COLLISION_WALL) ? 0 : remote->x - contact.distance;
+				sweep_walls_y(world, &temp, remote->y * REMOTE_CORRECTION, &contact);
+				remote->y = (contact.tile == COLLISION_WALL) ? 0 : remote->y - contact.distance;
+			}
 			
-			apply_force_x(world, entity, &temp, fps);
-			collision_system(world, entity, &temp, &entity_number, &tile_number, &hit_entity);
-			handle_x_collision(world, entity, &temp, entity_number, tile_number, fps);
-			
-			apply_force_y(world, entity, &temp, fps);
-			collision_system(world, entity, &temp, &entity_number, &tile_number, &hit_entity);
-			handle_y_collision(world, entity, &temp, entity_number, tile_number, fps);
+			move_entity(world, entity, &temp, &entity_number, &hit_entity, &contact);
+			tile_number = contact.tile;
 			
 			position->x = temp.x;
 			position->y = temp.y;
+			sync_collider(world, entity);
 			
 			handle_entity_collision(world, entity, entity_number, tile_number, hit_entity);
 			
@@ -696,3 +807,62 @@ void movement_system(World* world, FPS fps, int sendpipe) {
 	}
 }
 
+
+/**
+ * Does what the local player's keys do once, and tells the server about it.
+ *
+ * Run once a frame after the simulation ticks, so a key press places one belt,
+ * tags or captures once a frame however many ticks the frame ran, and the ready
+ * status in the lobby is checked once a frame instead of every tick.
+ *
+ * @param[in, out]	world		A pointer to the world struct.
+ * @param[in]		sendpipe	The pipe to the network router.
+ *
+ * @return	void
+ */
+void player_action_system(World* world, int sendpipe) {
+	unsigned int entity;
+	unsigned int tile;
+	EntityList *list = get_entity_list(world, CONTROLLABLE_MASK);
+	
+	for(entity = first_entity(list); entity < MAX_ENTITIES; entity = next_entity(list, entity)) {
+		
+		if (!world->controllable[entity].active) {
+			continue;
+		}
+		
+		/* SPECIAL TILES */
+		if(world->command[entity].commands[C_TILE]){
+			switch(world->player[entity].tilez){
+				case TILE_BELT_RIGHT:
+					tile = create_stile(world, TILE_BELT_RIGHT, world->position[entity].x, world->position[entity].y, world->position[entity].level);
+					if (tile != (unsigned int)-1)
+						send_tiles(world, tile, sendpipe);
+					break;
+				case TILE_BELT_LEFT: 
+					tile = create_stile(world, TILE_BELT_LEFT, world->position[entity].x, world->position[entity].y, world->position[entity].level);
+					if (tile != (unsigned int)-1)
+						send_tiles(world, tile, sendpipe);
+					break;
+			}
+		}
+		/* SPECIAL TILES */
+		
+		if (IN_THIS_COMPONENT(world->mask[entity], COLLISION_MASK)) {
+			tag_player(world, entity);
+			capture_objective(world, entity);
+		}
+		
+		if (world->position[entity].level == 0) { // sends ready statuses from the lobby
+			if (world->position[entity].x < 240) {
+				send_status(world, sendpipe, 1, PLAYER_STATE_READY);
+			}
+			else if (world->position[entity].x > 1000) {
+				send_status(world, sendpipe, 2, PLAYER_STATE_READY);
+			}
+			else {
+				send_status(world, sendpipe, 0, PLAYER_STATE_WAITING);
+			}
+		}
+	}
+}
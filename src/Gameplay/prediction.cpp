@@ -0,0 +1,175 @@
+/** @ingroup Gameplay */
+/** @{ */
+
+/**
+ * Keeps the local player's inputs so they can be replayed when the server corrects it.
+ *
+ * Every simulation tick the player's commands are stamped with a sequence number
+ * and kept in a ring buffer, with where they left the player. Position updates
+ * carry the number of the last input they are the result of and the commands of
+ * the last few inputs, so the server can run them, and the server sends
+ * back the last input its position for the player is the result of. If that
+ * position isn't where the client predicted, the player is put back there and the
+ * inputs the server hasn't seen yet are run again, so the controls never wait on
+ * the server.
+ *
+ * @file prediction.cpp
+ */
+/** @} */
+#include <math.h>
+#include <string.h>
+
+#include "prediction.h"
+#include "systems.h"
+
+static PredictedInput input_history[PREDICTION_HISTORY]; /**< The last inputs, by sequence number. */
+static unsigned int input_count = 0;                     /**< The number of inputs kept. */
+static seq_t input_sequence = 0;                         /**< The sequence number of the last input. */
+static WorldSnapshot rollback;                            /**< The world as predicted, put back after a replay. */
+
+/**
+ * Keeps the input of the tick that was just run for the local player.
+ *
+ * Called after every simulation tick.
+ *
+ * @param[in] world  A pointer to the world struct.
+ * @param[in] entity The local player.
+ */
+void record_input(World *world, unsigned int entity) {
+
+	PredictedInput *input;
+
+	input_sequence++;
+	input = &input_history[input_sequence & (PREDICTION_HISTORY - 1)];
+
+	input->seq = input_sequence;
+	memcpy(input->commands, world->command[entity].commands, sizeof(input->commands));
+	input->level = world->position[entity].level;
+	input->x = world->position[entity].x;
+	input->y = world->position[entity].y;
+
+	if (input_count < PREDICTION_HISTORY)
+		input_count++;
+}
+
+/**
+ * Gets the sequence number of the last input, which is sent with the player's position.
+ *
+ * @return The sequence number.
+ */
+seq_t last_input_sequence() {
+	return input_sequence;
+}
+
+/**
+ * Packs the commands of the last inputs for a position update, so the server can run
+ * them itself. Each input is a byte with a bit for each command that was on.
+ *
+ * The last inputs are resent with every update, so the server still gets them when an
+ * update is lost. Inputs that weren't recorded are sent with no commands.
+ *
+ * @param[out] inputs The packed inputs, oldest first, ending with the last input.
+ * @param[in]  count  The number of inputs to pack.
+ */
+void pack_recent_inputs(uint8_t *inputs, unsigned int count) {
+
+	PredictedInput *input;
+	unsigned int i;
+	int command;
+
+	for (i = 0; i < count; i++) {
+
+		seq_t seq = (seq_t)(input_sequence - (count - 1 - i));
+
+		inputs[i] = 0;
+		input = &input_history[seq & (PREDICTION_HISTORY - 1)];
+
+		if ((seq_t)(input_sequence - seq) >= input_count || input->seq != seq)
+			continue;
+
+		for (command = 0; command < NUM_COMMANDS; command++) {
+			if (input->commands[command])
+				inputs[i] |= 1 << command;
+		}
+	}
+}
+
+/**
+ * Corrects the local player with the server's state for it.
+ *
+ * If the player wasn't where the server says it was after the acknowledged input,
+ * it is put there and every input since is replayed through the movement code.
+ * The world is snapshotted first and rolled back once the replay is done, so
+ * where the replay left the player is the only thing it changes.
+ * Acknowledgements for inputs that are too old or from another floor are ignored.
+ *
+ * @param[in, out] world  A pointer to the world struct.
+ * @param[in]      entity The local player.
+ * @param[in]      ack    The last input the server's state is the result of.
+ * @param[in]      x      The server's x position for the player.
+ * @param[in]      y      The server's y position for the player.
+ * @param[in]      movX   The server's x velocity for the player.
+ * @param[in]      movY   The server's y velocity for the player.
+ * @param[in]      level  The server's floor for the player.
+ */
+void reconcile_player(World *world, unsigned int entity, seq_t ack, float x, float y, float movX, float movY, int level) {
+
+	PredictedInput *input;
+	PositionComponent position;
+	MovementComponent movement;
+	unsigned int behind = (seq_t)(input_sequence - ack);
+	unsigned int i;
+
+	if (behind >= input_count)
+		return;
+
+	input = &input_history[ack & (PREDICTION_HISTORY - 1)];
+
+	if (input->seq != ack)
+		return;
+
+	if (input->level != level || world->position[entity].level != level)
+		return;
+
+	if (fabsf(input->x - x) <= PREDICTION_TOLERANCE && fabsf(input->y - y) <= PREDICTION_TOLERANCE)
+		return;
+
+	if (snapshot_world(world, &rollback) == -1)
+		return;
+
+	world->position[entity].x = x;
+	world->position[entity].y = y;
+	world->movement[entity].movX = movX;
+	world->movement[entity].movY = movY;
+
+	for (i = 1; i <= behind; i++) {
+
+		input = &input_history[(seq_t)(ack + i) & (PREDICTION_HISTORY - 1)];
+
+		memcpy(world->command[entity].commands, input->commands, sizeof(input->commands));
+		replay_movement(world, entity);
+
+		input->x = world->position[entity].x;
+		input->y = world->position[entity].y;
+	}
+
+	position = world->position[entity];
+	movement = world->movement[entity];
+
+	restore_world(world, &rollback);
+
+	world->position[entity].x = position.x;
+	world->position[entity].y = position.y;
+	world->movement[entity] = movement;
+	sync_collider(world, entity);
+}
+
+/**
+ * Forgets the inputs, when the player is moved somewhere the inputs don't lead.
+ *
+ * The rollback snapshot's buffer is let go of too, as it was sized for the old floor.
+ */
+void reset_prediction() {
+	input_count = 0;
+	free_snapshot(&rollback);
+}
@@ -0,0 +1,28 @@
+#ifndef PREDICTION_H
+#define PREDICTION_H
+
+#include "../world.h"
+
+#define PREDICTION_HISTORY		256		/**< The number of inputs kept for replaying, a power of two. About two seconds of ticks. */
+#define PREDICTION_TOLERANCE	4.0f	/**< How far the server's position can be from the predicted one before the inputs are replayed. */
+
+/**
+ * One tick of the local player's input, and where it left the player.
+ *
+ * @struct PredictedInput
+ */
+typedef struct {
+	seq_t seq;                      /**< The input's sequence number. */
+	bool commands[NUM_COMMANDS];    /**< The commands that were on. */
+	int level;                      /**< The floor the player was on. */
+	float x;                        /**< The x position after the input. */
+	float y;                        /**< The y position after the input. */
+} PredictedInput;
+
+void record_input(World *world, unsigned int entity);
+seq_t last_input_sequence();
+void pack_recent_inputs(uint8_t *inputs, unsigned int count);
+void reconcile_player(World *world, unsigned int entity, seq_t ack, float x, float y, float movX, float movY, int level);
+void reset_prediction();
+
+#endif
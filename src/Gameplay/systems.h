@@ -12,7 +12,9 @@
 #include "../world.h"
 void add_force(World* world, unsigned int entity, float magnitude, float dir);
 void apply_force(World* world, unsigned int entity);
-void movement_system(World* world, FPS fps, int sendpipe);
+void movement_system(World* world);
+void player_action_system(World* world, int sendpipe);
+void replay_movement(World* world, unsigned int entity);
 void update_system(World* world);
 void handle_entity_collision(World* world, unsigned int entity, unsigned int entity_number, unsigned int tile_number, unsigned int hit_entity);
 void add_force_acceleration_x(MovementComponent& movement, float magnitude, float dir, float friction);
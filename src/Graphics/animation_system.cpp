@@ -4,18 +4,49 @@
 /** @} */
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
+#include <pthread.h>
 
 #include "../world.h"
 #include "../components.h"
 #include "../systems.h"
 #include "../sound.h"
 #include "../Input/menu.h"
+#include "image_cache.h"
 #include "../triggered.h"
 
 #include <stdlib.h>
 
 #define SYSTEM_MASK (COMPONENT_RENDER_PLAYER | COMPONENT_ANIMATION) /**< The entity must have a animation and render component */
 
+static AnimationDefinition *animation_definitions = NULL; /**< Every animation file that has been read in. */
+static pthread_mutex_t animation_definitions_lock = PTHREAD_MUTEX_INITIALIZER; /**< Locks the definitions while they are searched or read in. */
+static const AnimationDefinition empty_definition = { NULL, NULL, 0, -1, -1, 0, 0, 0, NULL }; /**< Given to entities whose animation file couldn't be read. */
+
+/**
+ * Ends an animation from the deferred commands.
+ *
+ * @param world  Pointer to the world structure
+ * @param entity The animated entity.
+ * @param value  Unused.
+ */
+static void animation_end_command(World *world, unsigned int entity, int value) {
+	animation_end(world, entity);
+}
+
+/**
+ * Plays an animation's sound effect from the deferred commands.
+ *
+ * The animation system can run on a worker thread, and sounds are only played
+ * from the main thread.
+ *
+ * @param world  Pointer to the world structure
+ * @param entity The animated entity.
+ * @param value  The sound effect.
+ */
+static void animation_effect_command(World *world, unsigned int entity, int value) {
+	play_effect(value);
+}
+
 /**
  * Updates animations
  *
@@ -24,6 +55,8 @@
  * is needed for animations vs. static images.
  * 
  * The animation can also be triggered at a random time, and can also trigger a sound effect.
+ * Nothing here uses SDL's video or sound, so the scheduler can run it on a worker
+ * thread: ending an animation and playing its sound are deferred to the main thread.
  *
  * @param world Pointer to the world structure (contains "world" info, entities / components)
  *
@@ -41,75 +74,106 @@ void animation_system(World *world) {
 	AnimationComponent 		*animationComponent;
 	RenderPlayerComponent 	*renderPlayer;
 
-	Animation *animation;
-	for(entity = 0; entity < MAX_ENTITIES; entity++){
-
-		if (IN_THIS_COMPONENT(world->mask[entity], SYSTEM_MASK)){
+	const Animation *animation;
+	const AnimationDefinition *definition;
+	EntityList *list = get_entity_list(world, SYSTEM_MASK);
+	
+	for(entity = first_entity(list); entity < MAX_ENTITIES; entity = next_entity(list, entity)){
 
-			animationComponent = &(world->animation[entity]);
-			renderPlayer = &(world->renderPlayer[entity]);
+		animationComponent = &(world->animation[entity]);
+		renderPlayer = &(world->renderPlayer[entity]);
+		definition = animationComponent->definition;
 
-			if (animationComponent->current_animation > -1) {
+		if (animationComponent->current_animation > -1) {
 
-				animation = &(animationComponent->animations[animationComponent->current_animation]);
+			animation = &(definition->animations[animationComponent->current_animation]);
+			
+			if (SDL_GetTicks() - animationComponent->ms_last > animation->ms_to_skip) {
 				
-				if (SDL_GetTicks() - animation->ms_last > animation->ms_to_skip) {
-					
-					animation->ms_last = SDL_GetTicks();
-					
-					animation->index++;
-					if (animation->index >= animation->surface_count) {
+				animationComponent->ms_last = SDL_GetTicks();
+				
+				animationComponent->index++;
+				if (animationComponent->index >= animation->surface_count) {
 
-						animation->index = 1;
-						if (animation->loop == -1) {
+					animationComponent->index = 1;
+					if (animation->loop == -1) {
 
-							animationComponent->current_animation = -1;
-							renderPlayer->playerSurface = animation->surfaces[0];
-							//stop_effect(animation->sound_effect);
+						animationComponent->current_animation = -1;
+						renderPlayer->playerSurface = animation->surfaces[0];
+						//stop_effect(animation->sound_effect);
 
-							animation_end(world, entity);
-							continue;
-						}
+						//ending an animation can tear the world down, so wait until the system is done.
+						defer_call(world, animation_end_command, entity, 0);
+						continue;
 					}
-					
-					if (animation->index >= animation->surface_count) {
-						animation->index = animation->surface_count - 1;
-					}
-					
-					renderPlayer->playerSurface = animation->surfaces[animation->index];
-
 				}
+				
+				if (animationComponent->index >= animation->surface_count) {
+					animationComponent->index = animation->surface_count - 1;
+				}
+				
+				renderPlayer->playerSurface = animation->surfaces[animationComponent->index];
+
 			}
-			else { //check if random trigger has triggered
+		}
+		else { //check if random trigger has triggered
 
-				if (animationComponent->rand_animation < 0) {
-					continue;
-				}
+			if (definition->rand_animation < 0) {
+				continue;
+			}
+			
+			if (SDL_GetTicks() > animationComponent->next_random_occurance) {
 				
-				if (SDL_GetTicks() > animationComponent->next_random_occurance) {
-					
-					animationComponent->current_animation = animationComponent->rand_animation;
-					
-					animationComponent->last_random_occurance = SDL_GetTicks();
-					animationComponent->next_random_occurance = (rand() % (animationComponent->rand_occurance_max - animationComponent->rand_occurance_min)) + animationComponent->rand_occurance_min + SDL_GetTicks();
-					
-					if (animationComponent->animations[animationComponent->rand_animation].sound_effect != MAX_EFFECTS &&
-						animationComponent->animations[animationComponent->rand_animation].sound_enabled == true) {
-						play_effect(animationComponent->animations[animationComponent->rand_animation].sound_effect);
-					}
+				animationComponent->current_animation = definition->rand_animation;
+				
+				animationComponent->last_random_occurance = SDL_GetTicks();
+				animationComponent->next_random_occurance = (rand() % (definition->rand_occurance_max - definition->rand_occurance_min)) + definition->rand_occurance_min + SDL_GetTicks();
+				
+				if (definition->animations[definition->rand_animation].sound_effect != MAX_EFFECTS &&
+					animationComponent->sound_enabled == true) {
+					defer_call(world, animation_effect_command, entity, definition->animations[definition->rand_animation].sound_effect);
 				}
 			}
+		}
+	}
+}
+
+/**
+ * Frees an animation definition and gives back its images.
+ *
+ * @param definition The definition to free.
+ */
+static void free_animation_definition(AnimationDefinition *definition) {
+
+	int i, j;
+
+	if (definition->animations != NULL) {
+		for(i = 0; i < definition->animation_count; i++) {
+
+			free(definition->animations[i].name);
 
+			if (definition->animations[i].surfaces == NULL)
+				continue;
+
+			for(j = 0; j < definition->animations[i].surface_count; j++) {
+				release_image(definition->animations[i].surfaces[j]);
+			}
+
+			free(definition->animations[i].surfaces);
 		}
+		free(definition->animations);
 	}
+
+	free(definition->filename);
+	free(definition);
 }
 
 /**
- * This loads in an animation text file to create an animated component.
+ * Reads in an animation text file.
  *
  * @param filename The filename of the animation text file
- * @param world Pointer to the world structure (contains "world" info, entities / components)
- * @param entity The entity to create the animation for
+ *
+ * @return The animations in the file, or NULL if the file couldn't be read.
  *
  * @designer Jordan Marling
  * @designer Mat Siwoski
@@ -118,10 +182,10 @@ void animation_system(World *world) {
  * @author Jordan Marling
  * @author Damien Sathanielle
  */
-int load_animation(const char *filename, World *world, unsigned int entity) {
-	AnimationComponent *animationComponent = &(world->animation[entity]);
-	RenderPlayerComponent *renderComponent = &(world->renderPlayer[entity]);
+static AnimationDefinition *read_animation_definition(const char *filename) {
 
+	AnimationDefinition *definition;
+	Animation *animation;
 	FILE *fp;
 
 	char animation_name[128];
@@ -136,62 +200,69 @@ int load_animation(const char *filename, World *world, unsigned int entity) {
 
 	if ((fp = fopen(filename, "r")) == 0) {
 		printf("Error opening animation file: %s\n", filename);
-		return -1;
+		return NULL;
 	}
 
-	if (fscanf(fp, "%d", &animationComponent->animation_count) != 1) {
+	definition = (AnimationDefinition*)calloc(1, sizeof(AnimationDefinition));
+
+	definition->filename = (char*)malloc(sizeof(char) * strlen(filename) + 1);
+	strcpy(definition->filename, filename);
+
+	definition->rand_animation = -1;
+	definition->hover_animation = -1;
+
+	if (fscanf(fp, "%d", &definition->animation_count) != 1) {
 		printf("Could not read in the animation count.\n");
-		return -1;
+		definition->animation_count = 0;
+		free_animation_definition(definition);
+		fclose(fp);
+		return NULL;
 	}
 
-	animationComponent->animations = (Animation*)malloc(sizeof(Animation) * animationComponent->animation_count);
-	animationComponent->current_animation = -1;
-	animationComponent->id = -1;
-
-	animationComponent->rand_animation = -1;
-	animationComponent->hover_animation = -1;
+	definition->animations = (Animation*)calloc(definition->animation_count, sizeof(Animation));
 
-	for(animation_index = 0; animation_index < animationComponent->animation_count; animation_index++) {
+	for(animation_index = 0; animation_index < definition->animation_count; animation_index++) {
 		if (fscanf(fp, "%s %d %d %s %d", animation_name, &animation_frames, &ms_to_skip, triggered_sound, &loop_animation) != 5) {
 			printf("Expected more animations!\n");
-			return -1;
+			free_animation_definition(definition);
+			fclose(fp);
+			return NULL;
 		}
 
-		animationComponent->animations[animation_index].surfaces = (SDL_Surface**)malloc(sizeof(SDL_Surface*) * animation_frames);
+		animation = &(definition->animations[animation_index]);
+
+		animation->surfaces = (SDL_Surface**)calloc(animation_frames, sizeof(SDL_Surface*));
 
-		animationComponent->animations[animation_index].surface_count = animation_frames;
+		animation->surface_count = animation_frames;
 		if (strcmp(triggered_sound, "-1") == 0) {
-			animationComponent->animations[animation_index].sound_effect = MAX_EFFECTS;
+			animation->sound_effect = MAX_EFFECTS;
 		}
 		else {
-			animationComponent->animations[animation_index].sound_effect = load_effect(triggered_sound);
+			animation->sound_effect = load_effect(triggered_sound);
 		}
-		animationComponent->animations[animation_index].loop = loop_animation;
-		animationComponent->animations[animation_index].ms_last = 0;
-		animationComponent->animations[animation_index].ms_to_skip = ms_to_skip;
-		animationComponent->animations[animation_index].index = 0;
-		animationComponent->animations[animation_index].sound_enabled = true;
+		animation->loop = loop_animation;
+		animation->ms_to_skip = ms_to_skip;
 		
-		animationComponent->animations[animation_index].name = (char*)malloc(sizeof(char) * strlen(animation_name) + 1);
-		strcpy(animationComponent->animations[animation_index].name, animation_name);
+		animation->name = (char*)malloc(sizeof(char) * strlen(animation_name) + 1);
+		strcpy(animation->name, animation_name);
 
 		for (frame_index = 0; frame_index < animation_frames; frame_index++) {
 
 			if (fscanf(fp, "%s", animation_filename) != 1) {
 				printf("Error reading animation file\n");
-				return -1;
+				free_animation_definition(definition);
+				fclose(fp);
+				return NULL;
 			}
 
-			animationComponent->animations[animation_index].surfaces[frame_index] = IMG_Load(animation_filename);
+			animation->surfaces[frame_index] = load_image(animation_filename);
 
-			if (animationComponent->animations[animation_index].surfaces[frame_index] == 0) {
+			if (animation->surfaces[frame_index] == 0) {
 				printf("Error loading file: %s, %s\n", animation_filename, IMG_GetError());
 			}
 		}
 	}
 
-	renderComponent->playerSurface = animationComponent->animations[0].surfaces[0];
-
 	//load optional features
 	if (fscanf(fp, "%d", &optional_features) == 1) {
 
@@ -199,27 +270,23 @@ int load_animation(const char *filename, World *world, unsigned int entity) {
 
 			if (fscanf(fp, "%s", (char*)feature_type) != 1) {
 				printf("Optional Feature type error: %s\n", filename);
-				return -1;
+				break;
 			}
 
 			if (strcmp(feature_type, "random") == 0) {
 				
-				if (fscanf(fp, "%d %d %d", &(animationComponent->rand_animation), &(animationComponent->rand_occurance_min), &(animationComponent->rand_occurance_max)) != 3) {
+				if (fscanf(fp, "%d %d %d", &(definition->rand_animation), &(definition->rand_occurance_min), &(definition->rand_occurance_max)) != 3) {
 					
 					printf("Wrong parameters for random. It should be 'random <animation index> <min delay in milliseconds> <max delay in milliseconds>\n");
 					
-					animationComponent->rand_animation = -1;
+					definition->rand_animation = -1;
 					
 				}
-				else {
-					animationComponent->last_random_occurance = SDL_GetTicks();
-					animationComponent->next_random_occurance = (rand() % (animationComponent->rand_occurance_max - animationComponent->rand_occurance_min)) + animationComponent->rand_occurance_min + SDL_GetTicks();
-				}
 			}
 			else if (strcmp(feature_type, "hover") == 0) {
 
-				if (fscanf(fp, "%d", &animationComponent->hover_animation) != 1) {
-					animationComponent->hover_animation = -1;
+				if (fscanf(fp, "%d", &definition->hover_animation) != 1) {
+					definition->hover_animation = -1;
 				}
 
 			}
@@ -230,9 +297,154 @@ int load_animation(const char *filename, World *world, unsigned int entity) {
 		}
 	}
 
+	fclose(fp);
+
+	definition->next = animation_definitions;
+	animation_definitions = definition;
+
+	return definition;
+}
+
+/**
+ * Gets the animations in an animation text file, reading the file in if it hasn't been yet.
+ *
+ * This may be called from the map loader thread to read a floor's animations
+ * before they are needed. Every definition that is got has to be given back with
+ * release_animation_definition, so its images can be freed once nothing uses it.
+ *
+ * @param filename The filename of the animation text file
+ *
+ * @return The animations in the file, or NULL if the file couldn't be read.
+ */
+const AnimationDefinition *get_animation_definition(const char *filename) {
+
+	AnimationDefinition *definition;
+
+	//the lock is held while reading so the sound effects aren't loaded by two threads at once.
+	pthread_mutex_lock(&animation_definitions_lock);
+
+	for(definition = animation_definitions; definition != NULL; definition = definition->next) {
+		if (strcmp(definition->filename, filename) == 0)
+			break;
+	}
+
+	if (definition == NULL) {
+		definition = read_animation_definition(filename);
+	}
+
+	if (definition != NULL) {
+		definition->users++;
+	}
+
+	pthread_mutex_unlock(&animation_definitions_lock);
+
+	return definition;
+}
+
+/**
+ * Gives back an animation definition from get_animation_definition.
+ *
+ * When nothing uses the definition any more it is freed, which gives back its
+ * images so release_unused_images can free them.
+ *
+ * @param definition The definition, or NULL.
+ */
+void release_animation_definition(const AnimationDefinition *definition) {
+
+	AnimationDefinition **link;
+
+	if (definition == NULL || definition == &empty_definition) {
+		return;
+	}
+
+	pthread_mutex_lock(&animation_definitions_lock);
+
+	for(link = &animation_definitions; *link != NULL; link = &(*link)->next) {
+
+		if (*link != definition)
+			continue;
+
+		if (--(*link)->users == 0) {
+			*link = definition->next;
+			free_animation_definition((AnimationDefinition*)definition);
+		}
+		break;
+	}
+
+	pthread_mutex_unlock(&animation_definitions_lock);
+}
+
+/**
+ * This loads in an animation text file to create an animated component.
+ *
+ * The file is only read the first time it is used. After that the entity
+ * shares the animations that were already loaded and only its playback
+ * state is set up.
+ *
+ * @param filename The filename of the animation text file
+ * @param world Pointer to the world structure (contains "world" info, entities / components)
+ * @param entity The entity to create the animation for
+ *
+ * @return 0 on success, -1 if the animation file couldn't be read.
+ *
+ * @designer Mat Siwoski
+ * @designer Damien Sathanielle
+ *
+ * @author Damien Sathanielle
+ */
+int load_animation(const char *filename, World *world, unsigned int entity) {
+	AnimationComponent *animationComponent = &(world->animation[entity]);
+	RenderPlayerComponent *renderComponent = &(world->renderPlayer[entity]);
+	const AnimationDefinition *definition = get_animation_definition(filename);
+
+	//an entity that is given a new animation lets go of the old one.
+	release_animation_definition(animationComponent->definition);
+
+	if (definition == NULL) {
+		//the entity still has the component, so give it nothing to play.
+		animationComponent->definition = &empty_definition;
+		animationComponent->current_animation = -1;
+		renderComponent->playerSurface = NULL;
+		return -1;
+	}
+
+	animationComponent->definition = definition;
+	animationComponent->current_animation = -1;
+	animationComponent->index = 0;
+	animationComponent->ms_last = 0;
+	animationComponent->sound_enabled = true;
+	animationComponent->id = -1;
+
+	if (definition->rand_animation > -1) {
+		animationComponent->last_random_occurance = SDL_GetTicks();
+		animationComponent->next_random_occurance = (rand() % (definition->rand_occurance_max - definition->rand_occurance_min)) + definition->rand_occurance_min + SDL_GetTicks();
+	}
+
+	renderComponent->playerSurface = (definition->animation_count > 0) ? definition->animations[0].surfaces[0] : NULL;
+
 	return 0;
 }
 
+/**
+ * Frees every animation definition that was loaded.
+ *
+ * Must only be called once no entities are using them.
+ */
+void cleanup_animations() {
+
+	AnimationDefinition *next;
+
+	pthread_mutex_lock(&animation_definitions_lock);
+
+	while (animation_definitions != NULL) {
+		next = animation_definitions->next;
+		free_animation_definition(animation_definitions);
+		animation_definitions = next;
+	}
+
+	pthread_mutex_unlock(&animation_definitions_lock);
+}
+
 /**
  * This cancels an entities animation and freezes it on the first frame specified by the animation_name
  *
@@ -258,7 +470,7 @@ void cancel_animation(World *world, unsigned int entity) {
 		return;
 	
 	
-	render->playerSurface = animation->animations[animation->current_animation].surfaces[0];
+	render->playerSurface = animation->definition->animations[animation->current_animation].surfaces[0];
 	
 	animation->current_animation = -1;
 	
@@ -282,28 +494,29 @@ void play_animation(World *world, unsigned int entity, const char *animation_nam
 	int i;
 	AnimationComponent *animationComponent = &(world->animation[entity]);
 	RenderPlayerComponent *renderComponent = &(world->renderPlayer[entity]);
+	const AnimationDefinition *definition = animationComponent->definition;
 	
 	if (!IN_THIS_COMPONENT(world->mask[entity], COMPONENT_ANIMATION)) {
 		return;
 	}
 	
 	//Check if the current animation is already playing.
-	if (animationComponent->current_animation > -1 && strcmp(animationComponent->animations[animationComponent->current_animation].name, animation_name) == 0) {
+	if (animationComponent->current_animation > -1 && strcmp(definition->animations[animationComponent->current_animation].name, animation_name) == 0) {
 		return;
 	}
-	for(i = 0; i < animationComponent->animation_count; i++) {
+	for(i = 0; i < definition->animation_count; i++) {
 
-		if (strcmp(animationComponent->animations[i].name, animation_name) == 0) {
+		if (strcmp(definition->animations[i].name, animation_name) == 0) {
 			
 			animationComponent->current_animation = i;
-			animationComponent->animations[i].ms_last = SDL_GetTicks();
-			animationComponent->animations[i].index = 0;
+			animationComponent->ms_last = SDL_GetTicks();
+			animationComponent->index = 0;
 			
-			renderComponent->playerSurface = animationComponent->animations[i].surfaces[0];
+			renderComponent->playerSurface = definition->animations[i].surfaces[0];
 			
-			if (animationComponent->animations[i].sound_effect != MAX_EFFECTS &&
-				animationComponent->animations[i].sound_enabled == true) {
-				play_effect(animationComponent->animations[i].sound_effect);
+			if (definition->animations[i].sound_effect != MAX_EFFECTS &&
+				animationComponent->sound_enabled == true) {
+				play_effect(definition->animations[i].sound_effect);
 			}
 			
 			return;
@@ -57,35 +57,54 @@ typedef struct {
 	
 	char *name; //name of animation
 	SDL_Surface **surfaces; //surface array
-	int index; //current surface to be drawn
 	int surface_count; //total amount of surfaces
 	unsigned int ms_to_skip; //milliseconds in between surface changes
-	unsigned int ms_last; //current amount of frames between surface change
 	unsigned int sound_effect; //sound effect to be played
-	bool sound_enabled; //if the sound effect is enabled or not.
 	int loop; //-1 is no loop, 1 is loop
 	
 } Animation;
 
 
 /**
- * Contains the components related to animation.
+ * Contains the animations read in from an animation text file.
  *
- * @enum Components Contains the information for rendering an animation.
+ * Each file is only read in once. Every entity using the file shares the same
+ * definition, so it must not be changed after it is loaded.
  *
- * @struct AnimationComponent
+ * @struct AnimationDefinition
  */
-typedef struct {
+typedef struct AnimationDefinition {
 	
+	char *filename; //the animation text file this was read from
 	Animation *animations; //animation array
 	int animation_count; //amount of animations
-	int current_animation; //current animation to be played, -1 is none
 	
 	int hover_animation; //id of the animation to be played while hovered over, -1 is none
-	int id; //this is used to trigger an event at the end of an animation, -1 is none
 	int rand_animation; //id of the animation to be played when triggered. -1 is none
 	int rand_occurance_min; //the minimum time delay for a random animation
 	int rand_occurance_max; //the maximum time delay for a random animation
+	
+	unsigned int users; //the entities and prefetched floors using this, it is freed when the last lets go
+	struct AnimationDefinition *next; //the next loaded definition
+} AnimationDefinition;
+
+
+/**
+ * Contains the components related to animation.
+ *
+ * @enum Components Contains the information for rendering an animation.
+ *
+ * @struct AnimationComponent
+ */
+typedef struct {
+	
+	const AnimationDefinition *definition; //the shared animations of this entity
+	int current_animation; //current animation to be played, -1 is none
+	int index; //current surface to be drawn
+	unsigned int ms_last; //the last time the surface was changed
+	bool sound_enabled; //if the sound effects are enabled or not.
+	
+	int id; //this is used to trigger an event at the end of an animation, -1 is none
 	unsigned int last_random_occurance; //the last time the random animation was played
 	unsigned int next_random_occurance; //the next time the random animation is played
 } AnimationComponent;
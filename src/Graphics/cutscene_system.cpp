@@ -18,6 +18,16 @@
 
 void start_cutscene_section(int id, World *world, unsigned int entity);
 
+/**
+ * Ends a cutscene from the deferred commands.
+ *
+ * @param world  Pointer to the world structure
+ * @param entity The cutscene.
+ * @param value  Unused.
+ */
+static void cutscene_end_command(World *world, unsigned int entity, int value) {
+	cutscene_end(world, entity);
+}
 
 /**
  * Creates the Cutscene Animation system
@@ -52,65 +62,65 @@ void cutscene_system(World *world) {
 	float x_start, y_start;
 	float x_diff, y_diff;
 	
-	for(entity = 0; entity < MAX_ENTITIES; entity++) {
+	EntityList *list = get_entity_list(world, SYSTEM_MASK);
+	
+	for(entity = first_entity(list); entity < MAX_ENTITIES; entity = next_entity(list, entity)) {
 		
-		if (IN_THIS_COMPONENT(world->mask[entity], SYSTEM_MASK)) {
-			
-			position = &world->position[entity];
-			cutscene = &world->cutscene[entity];
-			
-			section = &cutscene->sections[cutscene->current_section];
-			
-			//printf("[%u] total ms: %u section: %d\n", entity, section->total_ms, cutscene->current_section);
+		position = &world->position[entity];
+		cutscene = &world->cutscene[entity];
+		
+		section = &cutscene->sections[cutscene->current_section];
+		
+		//printf("[%u] total ms: %u section: %d\n", entity, section->total_ms, cutscene->current_section);
+		
+		//If the animation has gone too long, switch it
+		if (section->total_ms <= SDL_GetTicks() - section->start_ms) {
 			
-			//If the animation has gone too long, switch it
-			if (section->total_ms <= SDL_GetTicks() - section->start_ms) {
-				
-				cutscene->current_section++;
-				//check to see if the cutscene is over
-				if (cutscene->current_section >= cutscene->num_sections) {
-					
-					cutscene_end(world, entity);
-					destroy_entity(world, entity);
-					//printf("Destroyed entity\n");
-					
-					continue;
-				}
+			cutscene->current_section++;
+			//check to see if the cutscene is over
+			if (cutscene->current_section >= cutscene->num_sections) {
 				
-				//printf("Playing cutscene %s\n", cutscene->sections[cutscene->current_section].animation_name);
+				//ending a cutscene can tear the world down, so wait until every cutscene has been updated.
+				defer_call(world, cutscene_end_command, entity, 0);
+				defer_destroy_entity(world, entity);
+				//printf("Destroyed entity\n");
 				
-				//If the animation name is 0, don't render
-				if (strcmp(cutscene->sections[cutscene->current_section].animation_name, "0") == 0) {
-					disable_component(world, entity, COMPONENT_RENDER_PLAYER);
-				}
-				else {
-					enable_component(world, entity, COMPONENT_RENDER_PLAYER);
-					play_animation(world, entity, cutscene->sections[cutscene->current_section].animation_name);
-				}
-				cutscene->sections[cutscene->current_section].start_ms = SDL_GetTicks();
+				continue;
+			}
+			
+			//printf("Playing cutscene %s\n", cutscene->sections[cutscene->current_section].animation_name);
+			
+			//If the animation name is 0, don't render
+			if (strcmp(cutscene->sections[cutscene->current_section].animation_name, "0") == 0) {
+				defer_disable_component(world, entity, COMPONENT_RENDER_PLAYER);
 			}
 			else {
-				
-				//get the percent of the position.
-				percent_time = (float)(SDL_GetTicks() - section->start_ms) / section->total_ms;
-				
-				x_start = cutscene->xpos;
-				y_start = cutscene->ypos;
-				
-				//if the section is not the first, get the last x and y positions.
-				if (cutscene->current_section > 0) {
-					x_start = cutscene->sections[cutscene->current_section - 1].x_end;
-					y_start = cutscene->sections[cutscene->current_section - 1].y_end;
-				}
-				
-				x_diff = section->x_end - x_start;
-				y_diff = section->y_end - y_start;
-				
-				position->x = (percent_time * x_diff) + x_start;
-				position->y = (percent_time * y_diff) + y_start;
-				
-				//printf("New position: %f %f [%f]\n", position->x, position->y, percent_time);
+				defer_enable_component(world, entity, COMPONENT_RENDER_PLAYER);
+				play_animation(world, entity, cutscene->sections[cutscene->current_section].animation_name);
+			}
+			cutscene->sections[cutscene->current_section].start_ms = SDL_GetTicks();
+		}
+		else {
+			
+			//get the percent of the position.
+			percent_time = (float)(SDL_GetTicks() - section->start_ms) / section->total_ms;
+			
+			x_start = cutscene->xpos;
+			y_start = cutscene->ypos;
+			
+			//if the section is not the first, get the last x and y positions.
+			if (cutscene->current_section > 0) {
+				x_start = cutscene->sections[cutscene->current_section - 1].x_end;
+				y_start = cutscene->sections[cutscene->current_section - 1].y_end;
 			}
+			
+			x_diff = section->x_end - x_start;
+			y_diff = section->y_end - y_start;
+			
+			position->x = (percent_time * x_diff) + x_start;
+			position->y = (percent_time * y_diff) + y_start;
+			
+			//printf("New position: %f %f [%f]\n", position->x, position->y, percent_time);
 		}
 		
 		
@@ -10,39 +10,38 @@
 #include <SDL2/SDL_image.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "map.h"
+#include "renderer.h"
+#include "../Gameplay/level.h"
 
 
 extern SDL_Rect map_rect;
 
-int subOne(int n);
-int addOne(int n);
+#define FOW_LOS_EDGE 0.05f /**< How far a line of sight has to go into a tile for the tile to block it. */
 
-int is_wall_collision            (World *world           , PositionComponent newposition);
-PositionComponent set_newposition(PositionComponent *pos , int yDel, int xDel);
-int set_visibility_type          (FowPlayerPosition *fowp, int yDel, int xDel);
-void setBlockedTileCoords        (BlockedTiles       bt[7][7]);
-
-int fogOfWarHeight = 64;
-int fogOfWarWidth  = 32;
+void init_line_of_sight(FowComponent *fow);
+void make_fog_masks    (FowComponent *fow);
+void colour_fog_masks  (FowComponent *fow);
+void paint_fog_tile    (FowComponent *fow, FowFloor *floor, int x, int y, int visibility);
 
 extern int      level;
 extern teamNo_t player_team;
 
-static int visMap[7][7];
-
 
 
 /**
- * Renders all fog of war tiles to the window surface:
+ * Renders the fog of war of the current floor to the window:
  * 
- * Loops through the tile map to blit all the tiles that need blitting.
+ * The floor's mask has one pixel per tile, so the whole floor is drawn with one
+ * stretched copy and linear filtering softens the edges of the fog. Only the
+ * tiles that changed since the last frame are copied to the mask's texture.
+ * Floors nobody has seen yet are covered by the full fog.
  *
  * Revisions:
  *     None.
  *loading
- * @param surface 	The window surface.
  * @param fow   		A pointer to a fogOfWarStruct. Contains a reference to the tile's visibility, i.e. whether or not it should be blitted.
  *
  * @return void.
@@ -52,339 +51,245 @@ static int visMap[7][7];
  *
  * @date March 29, 2014
  */
-void render_fog_of_war_system(SDL_Surface *surface, FowComponent *fow)
+void render_fog_of_war_system(FowComponent *fow)
 {
-	int xOffset = fow -> xOffset;
-	int yOffset = fow -> yOffset;
+	SDL_Rect fogRect;
 
-	
-	int count = 0;
-	
-	for(int y = 0; y < fogOfWarHeight; y++)
+	if(fow -> teamNo != COPS && fow -> teamNo != ROBBERS)
+		return;
+
+	make_fog_masks(fow);
+
+	if(fow -> teamNo != fow -> maskTeam)
+		colour_fog_masks(fow);
+
+	fow -> xOffset = -map_rect.x;
+	fow -> yOffset = -map_rect.y;
+
+	fogRect.x = -(fow -> xOffset);
+	fogRect.y = -(fow -> yOffset);
+	fogRect.w = map_rect.w;
+	fogRect.h = map_rect.h;
+
+	if(level < 0 || level >= NUMLEVELS || fow -> floors[ level ].mask == NULL)
 	{
-		for(int x = 0; x < fogOfWarWidth; x++)
-		{
-			int visible = fow -> tiles[y][x].visible[ level  ];
-
-			SDL_Rect tileRect;
-			tileRect.x = fow -> tiles[y][x].rect.x - xOffset;
-			tileRect.y = fow -> tiles[y][x].rect.y - yOffset;
-				
-			tileRect.w = TILE_WIDTH;
-			tileRect.h = TILE_HEIGHT;
-
-			if(fow -> teamNo == COPS)
-			{
-				switch(visible)
-				{
-					case CLEAR_VIS:	fow -> tiles[y][x].visible[ level ] = TRANSP_VIS;	break;
-					case OPAQUE_VIS: SDL_BlitSurface(fow -> alphaFog[count++], NULL, surface, &tileRect); break;
-					case TRANSP_VIS: SDL_BlitSurface(fow -> alphaFog[count++], NULL, surface, &tileRect); break;
-				}
-			}
-			
-			else if(fow -> teamNo == ROBBERS)
-			{
-				switch(visible)
-				{
-					case CLEAR_VIS:	fow -> tiles[y][x].visible[ level ] = TRANSP_VIS;	break;
-					case OPAQUE_VIS: SDL_BlitSurface(fow -> fogOfWar[count++], NULL, surface, &tileRect); break;
-					case TRANSP_VIS: SDL_BlitSurface(fow -> alphaFog[count++], NULL, surface, &tileRect); break;
-				}
-			}
-		}
+		renderer_draw((fow -> teamNo == COPS) ? fow -> alphaFog : fow -> fogOfWar, NULL, &fogRect);
+		return;
 	}
-}
 
+	FowFloor *floor = &fow -> floors[ level ];
+
+	if(floor -> dirty.w > 0)
+	{
+		renderer_update(floor -> mask, &floor -> dirty);
+		floor -> dirty.w = 0;
+		floor -> dirty.h = 0;
+	}
+
+	renderer_draw(floor -> mask, NULL, &fogRect);
+}
 
 
 /**
- * Allocates memory for each component of the fogOfWarStruct.
- * 
- * Sets the default positions in absolute coords of all fog tiles.
- * Sets the visibility of each fog tile at each level to opaque.
+ * Works out what the player's team can see.
  *
- * Initializes opaque fog surfaces
- * Initializes transparent fog surfaces
+ * The team is taken from the controllable player, and each teammate reveals the
+ * tiles around them. This only touches the fog, so it can run on a worker thread
+ * while other systems update the world. Nothing here uses SDL: the masks of new
+ * floors are made when the fog is next drawn.
  *
  * Revisions:
  *     None.
- *loading
- * @param fow   		A double pointer to a null fogOfWarStruct which is to be initialized
  *
- * @return void.
- * 
- * @designer Sam Youssef
- * @author Sam Youssef
+ * @param world 		The world struct.
+ * @param fow   		The team's fog.
  *
- * @date March 29, 2014
+ * @return void.
  */
-void init_fog_of_war_system(FowComponent **fow)
+void fog_of_war_system(World *world, FowComponent *fow)
 {
-	fogOfWarWidth  = 64; // screen width (tiles/screen)
-	fogOfWarHeight = 38; // screen height (tiles/screen)
+	unsigned int entity;
+	FowPlayerPosition fowp;
+	EntityList *players = get_entity_list(world, COMPONENT_PLAYER | COMPONENT_CONTROLLABLE);
+	EntityList *list = get_entity_list(world, COMPONENT_RENDER_PLAYER | COMPONENT_POSITION | COMPONENT_PLAYER);
 
-	int const TOTALTILESX = 2560;
-	int const TOTALTILESY = 1520;
-	
+	for(entity = first_entity(players); entity < MAX_ENTITIES; entity = next_entity(players, entity))
+		fow -> teamNo = world -> player[ entity ].teamNo;
 
-	(*fow) = (FowComponent*)malloc(sizeof(FowComponent));
+	for(entity = first_entity(list); entity < MAX_ENTITIES; entity = next_entity(list, entity))
+	{
+		if(IN_THIS_COMPONENT(world -> mask[ entity ], COMPONENT_MENU_ITEM) || world -> player[ entity ].teamNo != fow -> teamNo)
+			continue;
+
+		fowp.world  = world;
+		fowp.pos    = &world -> position[ entity ];
+		fowp.fow    = fow;
+		fowp.entity = entity;
+		fowp.isControllablePlayer = IN_THIS_COMPONENT(world -> mask[ entity ], COMPONENT_CONTROLLABLE);
+		make_surrounding_tiles_visible(&fowp);
+	}
 
+	release_fog_viewers(fow);
+}
 
-	// fog of war tile map
-	(*fow) -> tiles = (FowTile**)malloc(sizeof(FowTile*) * TOTALTILESY);
 
-	for(int y = 0; y < TOTALTILESY; y++)
+/**
+ * Makes the mask of every floor that was visited or changed size since the fog was last drawn.
+ *
+ * The masks are surfaces that are drawn, so they are made and freed here on the
+ * main thread rather than when the floor is visited. A new mask is coloured in
+ * with the rest by colour_fog_masks.
+ *
+ * Revisions:
+ *     None.
+ *
+ * @param fow   		A pointer to a fogOfWarStruct.
+ *
+ * @return void.
+ */
+void make_fog_masks(FowComponent *fow)
+{
+	for(int lev = 0; lev < NUMLEVELS; lev++)
 	{
-		(*fow) -> tiles[y] = (FowTile*)malloc(sizeof(FowTile) * TOTALTILESX);
+		FowFloor *floor = &fow -> floors[ lev ];
 
-		for(int x = 0; x < TOTALTILESX; x++)
+		// floors that couldn't be allocated are drawn as full fog
+		if(floor -> visible == NULL)
 		{
-			for(int lev = 0; lev < NUMLEVELS; lev++)
-			{
-				(*fow) -> tiles[y][x].visible[ lev ] = OPAQUE_VIS;
-				(*fow) -> tiles[y][x].rect.x = (x * TILE_WIDTH );
-				(*fow) -> tiles[y][x].rect.y = (y * TILE_HEIGHT);
-				(*fow) -> tiles[y][x].rect.w = ( TILE_WIDTH  );
-				(*fow) -> tiles[y][x].rect.h = ( TILE_HEIGHT );				
-			}
-		}	
-	}
+			renderer_free_surface(floor -> mask);
+			floor -> mask = NULL;
+			continue;
+		}
 
+		if(floor -> mask != NULL && floor -> mask -> w == floor -> width && floor -> mask -> h == floor -> height)
+			continue;
 
-	// array of surfaces
-	(*fow) -> fogOfWar = (SDL_Surface**)malloc(sizeof(SDL_Surface*) * fogOfWarWidth * fogOfWarHeight);
-	(*fow) -> alphaFog = (SDL_Surface**)malloc(sizeof(SDL_Surface*) * fogOfWarWidth * fogOfWarHeight);
-		
-	for(int i = 0; i < (fogOfWarHeight * fogOfWarWidth); i++)
-	{	
-		(*fow) -> alphaFog[ i ] = SDL_CreateRGBSurface(0, TILE_WIDTH, TILE_HEIGHT, 32, 0, 0, 0, 0);
-		SDL_FillRect((*fow) -> alphaFog[ i ], 0, TRANSP_FOG_COLOUR);
-		
-		
-		SDL_SetSurfaceBlendMode((*fow)->alphaFog[ i ], SDL_BLENDMODE_BLEND);
-		SDL_SetSurfaceAlphaMod ((*fow)->alphaFog[ i ] , 102);
+		renderer_free_surface(floor -> mask);
+
+		// ARGB8888 so changed pixels can be copied straight into the texture
+		floor -> mask = SDL_CreateRGBSurface(0, floor -> width, floor -> height, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
 
+		if(floor -> mask == NULL)
+		{
+			printf("Error allocating the fog of war mask of floor %d\n", lev);
+			continue;
+		}
 
-		(*fow) -> fogOfWar[ i ] = SDL_CreateRGBSurface(0, TILE_WIDTH, TILE_HEIGHT, 32, 0, 0, 0, 0);
-		SDL_FillRect((*fow) -> fogOfWar[ i ], 0, OPAQUE_FOG_COLOUR);
+		SDL_SetSurfaceBlendMode(floor -> mask, SDL_BLENDMODE_BLEND);
 
+		// colour the new mask before it is drawn
+		fow -> maskTeam = 0;
 	}
-
-	setBlockedTileCoords((*fow) -> bt);
 }
 
 
 /**
- * Fills map of blockable tiles.
+ * Sets the mask colours for the team and repaints every floor's mask with them.
+ * 
+ * Cops see transparent fog everywhere they aren't looking, robbers see black
+ * fog where they haven't been yet.
  *
  * Revisions:
  *     None.
- *loading
- * @param bt		Tile map 			
  *
- * @return void.
- * 
- * @designer Sam Youssef
- * @author Sam Youssef
+ * @param fow   		A pointer to a fogOfWarStruct.
  *
- * @date April 6, 2014
+ * @return void.
  */
-void setBlockedTileCoords(BlockedTiles bt[7][7])
+void colour_fog_masks(FowComponent *fow)
 {
-	for(int i = 0; i < 7; i++)
-	{
-		memset(bt[i], 0, sizeof(bt[i]));
-	}
+	SDL_PixelFormat *format = NULL;
 
+	for(int lev = 0; lev < NUMLEVELS && format == NULL; lev++)
+		if(fow -> floors[ lev ].mask != NULL)
+			format = fow -> floors[ lev ].mask -> format;
 
-	// first corner
-	bt[1][2].coords[1][1] = 1;
-	bt[1][2].coords[0][2] = 1;
+	fow -> maskTeam = fow -> teamNo;
 
-	bt[2][1].coords[1][1] = 1;
-	bt[2][1].coords[2][0] = 1;
-	
-	bt[2][2].coords[0][2] = 1;
-	bt[2][2].coords[1][1] = 1;
-	bt[2][2].coords[1][2] = 1;
-	bt[2][2].coords[2][1] = 1;
-	bt[2][2].coords[2][0] = 1;
-
-	// top mid
-	bt[1][3].coords[0][2] = 1;
-	bt[1][3].coords[0][3] = 1;
-	bt[1][3].coords[0][4] = 1;
-
-	bt[2][3].coords[0][2] = 1;
-	bt[2][3].coords[1][1] = 1;
-	bt[2][3].coords[1][2] = 1;
-	bt[2][3].coords[2][0] = 1;
-	bt[2][3].coords[2][1] = 1;
-	bt[2][3].coords[2][2] = 1;
-	bt[2][3].coords[0][3] = 1;
-	bt[2][3].coords[1][3] = 1;
-	bt[2][3].coords[0][4] = 1;
-	bt[2][3].coords[1][4] = 1;
-	bt[2][3].coords[1][5] = 1;
-	bt[2][3].coords[2][4] = 1;
-	bt[2][3].coords[2][5] = 1;
-	bt[2][3].coords[2][6] = 1;
-
-	// second corner
-	bt[1][4].coords[1][5] = 1;
-	bt[1][4].coords[0][4] = 1;
-
-	bt[2][5].coords[1][5] = 1;
-	bt[2][5].coords[2][6] = 1;
-	
-	bt[2][4].coords[0][4] = 1;
-	bt[2][4].coords[1][4] = 1;
-	bt[2][4].coords[1][5] = 1;
-	bt[2][4].coords[2][5] = 1;
-	bt[2][4].coords[2][6] = 1;
-
-	// right mid
-	bt[3][5].coords[2][6] = 1;
-	bt[3][5].coords[3][6] = 1;
-	bt[3][5].coords[4][6] = 1;
-
-	bt[3][4].coords[0][4] = 1;
-	bt[3][4].coords[1][4] = 1;
-	bt[3][4].coords[1][5] = 1;
-	bt[3][4].coords[2][4] = 1;
-	bt[3][4].coords[2][5] = 1;
-	bt[3][4].coords[2][6] = 1;
-	bt[3][4].coords[3][5] = 1;
-	bt[3][4].coords[3][6] = 1;
-	bt[3][4].coords[4][4] = 1;
-	bt[3][4].coords[4][5] = 1;
-	bt[3][4].coords[4][6] = 1;
-	bt[3][4].coords[5][5] = 1;
-	bt[3][4].coords[5][4] = 1;
-	bt[3][4].coords[6][4] = 1;
-
-	// third corner
-	bt[4][4].coords[4][5] = 1;
-	bt[4][4].coords[4][6] = 1;
-	bt[4][4].coords[5][4] = 1;
-	bt[4][4].coords[5][5] = 1;
-	bt[4][4].coords[6][4] = 1;
-
-	bt[4][5].coords[4][6] = 1;
-	bt[4][5].coords[5][5] = 1;
-
-	bt[5][4].coords[5][5] = 1;
-	bt[5][4].coords[6][4] = 1;
-
-	// bot mid
-	bt[5][3].coords[6][2] = 1;
-	bt[5][3].coords[6][3] = 1;
-	bt[5][3].coords[6][4] = 1;
-
-	bt[4][3].coords[4][0] = 1;
-	bt[4][3].coords[4][1] = 1;
-	bt[4][3].coords[4][2] = 1;
-	bt[4][3].coords[4][4] = 1;
-	bt[4][3].coords[4][5] = 1;
-	bt[4][3].coords[4][6] = 1;
-	bt[4][3].coords[5][1] = 1;
-	bt[4][3].coords[5][2] = 1;
-	bt[4][3].coords[5][3] = 1;
-	bt[4][3].coords[5][4] = 1;
-	bt[4][3].coords[5][5] = 1;
-	bt[4][3].coords[6][2] = 1;
-	bt[4][3].coords[6][3] = 1;
-	bt[4][3].coords[6][4] = 1;
-
-	// fourth corner
-	bt[4][2].coords[4][0] = 1;
-	bt[4][2].coords[4][1] = 1;
-	bt[4][2].coords[5][1] = 1;
-	bt[4][2].coords[5][2] = 1;
-	bt[4][2].coords[6][2] = 1;
-
-	bt[5][2].coords[5][1] = 1;
-	bt[5][2].coords[6][2] = 1;
-
-	bt[4][1].coords[4][0] = 1;
-	bt[4][1].coords[5][1] = 1;
-
-	// left mid
-	bt[3][1].coords[2][0] = 1;
-	bt[3][1].coords[3][0] = 1;
-	bt[3][1].coords[4][0] = 1;
-
-	bt[3][2].coords[0][2] = 1;
-	bt[3][2].coords[1][2] = 1;
-	bt[3][2].coords[2][2] = 1;
-	bt[3][2].coords[4][2] = 1;
-	bt[3][2].coords[5][2] = 1;
-	bt[3][2].coords[6][2] = 1;
-	bt[3][2].coords[1][1] = 1;
-	bt[3][2].coords[2][1] = 1;
-	bt[3][2].coords[3][1] = 1;
-	bt[3][2].coords[4][1] = 1;
-	bt[3][2].coords[5][1] = 1;
-	bt[3][2].coords[2][0] = 1;
-	bt[3][2].coords[3][0] = 1;
-	bt[3][2].coords[4][0] = 1;
+	if(format == NULL)
+		return;
+
+	fow -> maskColours[ CLEAR_VIS  ] = SDL_MapRGBA(format, 0, 0, 0, 0);
+	fow -> maskColours[ TRANSP_VIS ] = SDL_MapRGBA(format, (TRANSP_FOG_COLOUR >> 16) & 0xFF, (TRANSP_FOG_COLOUR >> 8) & 0xFF, TRANSP_FOG_COLOUR & 0xFF, TRANSP_FOG_ALPHA);
+
+	if(fow -> teamNo == COPS)
+		fow -> maskColours[ OPAQUE_VIS ] = fow -> maskColours[ TRANSP_VIS ];
+	else
+		fow -> maskColours[ OPAQUE_VIS ] = SDL_MapRGBA(format, (OPAQUE_FOG_COLOUR >> 16) & 0xFF, (OPAQUE_FOG_COLOUR >> 8) & 0xFF, OPAQUE_FOG_COLOUR & 0xFF, 0xFF);
+
+	for(int lev = 0; lev < NUMLEVELS; lev++)
+	{
+		FowFloor *floor = &fow -> floors[ lev ];
+
+		if(floor -> mask == NULL)
+			continue;
+
+		for(int y = 0; y < floor -> height; y++)
+			for(int x = 0; x < floor -> width; x++)
+				paint_fog_tile(fow, floor, x, y, get_fog_visibility(fow, lev, x, y));
+	}
 }
 
 
 /**
- * Frees the fow struct and its components' allocated heap memories
+ * Colours a tile's pixel in a floor's mask and adds it to the floor's dirty rect.
  *
  * Revisions:
  *     None.
- *loading
- * @param fow   		A double pointer to a null fogOfWarStruct which is to be freed
  *
- * @return void.
- * 
- * @designer Sam Youssef
- * @author Sam Youssef
+ * @param fow   		A pointer to a fogOfWarStruct.
+ * @param floor			The floor the tile is on.
+ * @param x				The tile's column.
+ * @param y				The tile's row.
+ * @param visibility	The tile's visibility.
  *
- * @date March 29, 2014
+ * @return void.
  */
-void cleanup_fog_of_war(FowComponent *fow)
+void paint_fog_tile(FowComponent *fow, FowFloor *floor, int x, int y, int visibility)
 {
+	Uint32 *row = (Uint32*)((Uint8*)floor -> mask -> pixels + y * floor -> mask -> pitch);
+	row[x] = fow -> maskColours[ visibility ];
 
-	for(int i = 0; i < (fogOfWarHeight); i++)
+	if(floor -> dirty.w == 0)
 	{
-		free(fow -> tiles [i]);
+		floor -> dirty.x = x;
+		floor -> dirty.y = y;
+		floor -> dirty.w = 1;
+		floor -> dirty.h = 1;
+		return;
 	}
 
-	free(fow -> tiles);
-
-	for(int i = 0; i < (fogOfWarHeight * fogOfWarWidth); i++)
+	if(x < floor -> dirty.x)
 	{
-		SDL_FreeSurface(fow -> fogOfWar[i]);
-		SDL_FreeSurface(fow -> alphaFog[i]);
+		floor -> dirty.w += floor -> dirty.x - x;
+		floor -> dirty.x = x;
 	}
-	
-	for(int i = 0; i < NUMSPEECHCOP; i++)
-	{
-		Mix_FreeChunk(fow -> speech.cop[i]);
-	}
-	
+	else if(x >= floor -> dirty.x + floor -> dirty.w)
+		floor -> dirty.w = x - floor -> dirty.x + 1;
 
-	for(int i = 0; i < NUMSPEECHROB; i++)
+	if(y < floor -> dirty.y)
 	{
-		Mix_FreeChunk(fow -> speech.rob[i]);
+		floor -> dirty.h += floor -> dirty.y - y;
+		floor -> dirty.y = y;
 	}
+	else if(y >= floor -> dirty.y + floor -> dirty.h)
+		floor -> dirty.h = y - floor -> dirty.y + 1;
 }
 
 
+
 /**
- * Resets all fog of war tiles to opaque
+ * Allocates memory for each component of the fogOfWarStruct.
  * 
- * Loops through the tile map to reset the visibility level
+ * No floors are allocated yet, so every tile starts opaque.
+ *
+ * Initializes the opaque fog surface
+ * Initializes the transparent fog surface
  *
  * Revisions:
  *     None.
  *loading
- * @param fow   		A pointer to a fogOfWarStruct. Contains a reference to the tile's visibility, i.e. whether or not it should be blitted.
+ * @param fow   		A double pointer to a null fogOfWarStruct which is to be initialized
  *
  * @return void.
  * 
@@ -393,478 +298,453 @@ void cleanup_fog_of_war(FowComponent *fow)
  *
  * @date March 29, 2014
  */
-void reset_fog_of_war(FowComponent *fow)
+void init_fog_of_war_system(FowComponent **fow)
 {
+	(*fow) = (FowComponent*)malloc(sizeof(FowComponent));
 
-	int const TOTALTILESX = 2560;
-	int const TOTALTILESY = 1520;
 
-	for(int y = 0; y < TOTALTILESY; y++)
-	{
-		for(int x = 0; x < TOTALTILESX; x++)
-		{
-			for(int lev = 0; lev < NUMLEVELS; lev++)
-			{
-				fow -> tiles[y][x].visible[ lev ] = OPAQUE_VIS;			
-			}
-		}	
-	}
-}
+	// floors are allocated as they are visited
+	memset((*fow) -> floors, 0, sizeof((*fow) -> floors));
 
+	memset((*fow) -> viewers, 0, sizeof((*fow) -> viewers));
+	(*fow) -> frame = 0;
+	(*fow) -> maskTeam = 0;
+	memset((*fow) -> maskColours, 0, sizeof((*fow) -> maskColours));
+	(*fow) -> tilesVisibleToControllablePlayerCount = 0;
 
-/**
- * Checks whether a near tile is a wall
- * 
- * Loops through the tile map to blit all the tiles that need blitting.
- *
- * Revisions:
- *     None.
- *loading
- * @param fow   		A pointer to a fogOfWarStruct. Contains a reference to the tile's visibility, i.e. whether or not it should be blitted.
- * @param yd			Delta y from current position
- * @param xd			Delta x from current position
- *
- * @return int. 0 on wall collision. 1 otherwise
- * 
- * @designer Sam Youssef
- * @author Sam Youssef
- *
- * @date March 29, 2014
- */
-int get_visibility_of_near_wall(FowPlayerPosition *fowp, int y, int x)
-{
-		PositionComponent newposition;
-		
-		int yd = y-3;
-		int xd = x-3;
 
-		newposition = set_newposition(fowp -> pos, yd, xd);
-		
-		if(is_wall_collision(fowp -> world, newposition) == COLLISION_WALL) return 1;
-		return 0;
+	// fog images, drawn over floors nobody has seen yet
+	(*fow) -> alphaFog = SDL_CreateRGBSurface(0, TILE_WIDTH, TILE_HEIGHT, 32, 0, 0, 0, 0);
+	SDL_FillRect((*fow) -> alphaFog, 0, TRANSP_FOG_COLOUR);
+	
+	SDL_SetSurfaceBlendMode((*fow) -> alphaFog, SDL_BLENDMODE_BLEND);
+	SDL_SetSurfaceAlphaMod ((*fow) -> alphaFog, 102);
+
+	(*fow) -> fogOfWar = SDL_CreateRGBSurface(0, TILE_WIDTH, TILE_HEIGHT, 32, 0, 0, 0, 0);
+	SDL_FillRect((*fow) -> fogOfWar, 0, OPAQUE_FOG_COLOUR);
+
+	init_line_of_sight(*fow);
 }
 
+
 /**
- * Makes the tiles surrounding the player (by a radius of two) visible.
- *
- * Handles walls by removing the line of sight behind them. 
+ * Checks whether the line of sight from the player's tile to a tile passes through another tile.
+ * 
+ * Coordinates are in tiles relative to the player's tile. Lines that only graze
+ * the corner of a tile aren't blocked by it.
  *
  * Revisions:
- *     None.
- *loading
- * @param fow   		A double pointer to a null fogOfWarStruct which contains the tile map
+ *     -# Replaces setBlockedTileCoords: the tiles in the way of each line of sight are
+ *        worked out once in init_line_of_sight instead of kept in a fixed table.
  *
- * @return void.
- * 
- * @designer Sam Youssef
- * @author Sam Youssef
+ * @param xEnd		The x offset of the tile being looked at.
+ * @param yEnd		The y offset of the tile being looked at.
+ * @param x			The x offset of the tile that may be in the way.
+ * @param y			The y offset of the tile that may be in the way.
  *
- * @date March 29, 2014
+ * @return int. 1 if the line passes through the tile, 0 otherwise.
  */
-void make_surrounding_tiles_visible(FowPlayerPosition *fowp)
+int line_crosses_tile(int xEnd, int yEnd, int x, int y)
 {
-	fowp -> fow -> xOffset = -map_rect.x;
-	fowp -> fow -> yOffset = -map_rect.y;
-	
-	memset(visMap, 0, sizeof(int) * 7 * 7);
-
-	visMap[0][0] = 3;
-	visMap[0][1] = 3;
-	visMap[1][0] = 3;
-
-	visMap[0][5] = 3;
-	visMap[0][6] = 3;
-	visMap[1][6] = 3;
-
-	visMap[5][6] = 3;
-	visMap[6][5] = 3;
-	visMap[6][6] = 3;
-
-	visMap[5][0] = 3;
-	visMap[6][0] = 3;
-	visMap[6][1] = 3;
+	float half = 0.5f - FOW_LOS_EDGE;
+	float tMin = 0.0f;
+	float tMax = 1.0f;
 
+	int end[2]  = { xEnd, yEnd };
+	int tile[2] = { x, y };
 
-	for(int y = 0; y < 7; y++) 
+	for(int i = 0; i < 2; i++)
 	{
-		for(int x = 0; x < 7; x++) 
+		if(end[i] == 0)
 		{
-			if(visMap[y][x] == 0)
-			{
-				if((visMap[y][x] = get_visibility_of_near_wall(fowp, y, x)) != 0)
-				{
-					for(int yi = 0; yi < 7; yi++)
-						for(int xi = 0; xi < 7; xi++)
-							if(fowp->fow->bt[y][x].coords[yi][xi] == 1)
-								visMap[yi][xi] = 1;
-				}
-			}		
+			if(tile[i] != 0)
+				return 0;
+			continue;
 		}
-	}
 
+		float t1 = (tile[i] - half) / end[i];
+		float t2 = (tile[i] + half) / end[i];
 
-	// grey out the walls
-	for(int y = 3, x = 3; x >= 0; --x) {
-		if(visMap[y][x] == 1) {
-			visMap[y][x] = 2;
-			break;
+		if(t1 > t2)
+		{
+			float t = t1;
+			t1 = t2;
+			t2 = t;
 		}
-	}
-
 
-	for(int y = 3, x = 3; x <= 6; ++x) {
-		if(visMap[y][x] == 1) {
-			visMap[y][x] = 2;
-			break;
-		}
-	}
+		if(t1 > tMin) tMin = t1;
+		if(t2 < tMax) tMax = t2;
 
-	for(int y = 3, x = 3; y >= 0; --y) {
-		if(visMap[y][x] == 1) {
-			visMap[y][x] = 2;
-			break;
-		}
+		if(tMin > tMax)
+			return 0;
 	}
 
-	for(int y = 3, x = 3; y <= 6; ++y) {
-		if(visMap[y][x] == 1) {
-			visMap[y][x] = 2;
-			break;
-		}
-	}
+	return 1;
+}
 
 
-	for(int y = 3, x = 3; y <= 6; ++y, ++x) {
+/**
+ * Builds the line of sight tables for FOW_LOS_RADIUS.
+ * 
+ * For every tile around the player, marks whether it is within the circle the player
+ * can see and which tiles are between it and the player. At run time a tile is hidden
+ * if any of its blockers is a wall, so no masks have to be written by hand.
+ *
+ * Revisions:
+ *     None.
+ *
+ * @param fow		The FowComponent to fill the tables of.
+ *
+ * @return void.
+ */
+void init_line_of_sight(FowComponent *fow)
+{
+	int const RANGE = FOW_LOS_RADIUS * FOW_LOS_RADIUS + FOW_LOS_RADIUS;
 
-		if(visMap[y][x] == 1) {
-			visMap[y][x] = 2;
-			break;
-		}
-	}
+	memset(fow -> blockers, 0, sizeof(fow -> blockers));
 
-	for(int y = 3, x = 3; y >= 0; --y, --x) {
-		if(visMap[y][x] == 1) {
-			visMap[y][x] = 2;
-			break;
-		}
-	}
+	for(int tile = 0; tile < FOW_LOS_TILES; tile++)
+	{
+		int xEnd = tile % FOW_LOS_SIZE - FOW_LOS_RADIUS;
+		int yEnd = tile / FOW_LOS_SIZE - FOW_LOS_RADIUS;
 
+		fow -> inRange[ tile ] = (xEnd * xEnd + yEnd * yEnd <= RANGE);
 
-	for(int y = 3, x = 3; y >= 0; --y, ++x) {
-		if(visMap[y][x] == 1) {
-			visMap[y][x] = 2;
-			break;
-		}
-	}
+		for(int other = 0; other < FOW_LOS_TILES; other++)
+		{
+			int x = other % FOW_LOS_SIZE - FOW_LOS_RADIUS;
+			int y = other / FOW_LOS_SIZE - FOW_LOS_RADIUS;
 
+			// the player's tile and the tile itself never hide it
+			if((x == 0 && y == 0) || (x == xEnd && y == yEnd))
+				continue;
 
-	for(int y = 3, x = 3; y <= 6; ++y, --x) {
-		if(visMap[y][x] == 1) {
-			visMap[y][x] = 2;
-			break;
+			if(line_crosses_tile(xEnd, yEnd, x, y))
+				fow -> blockers[ tile ].bits[ other / 64 ] |= (Uint64)1 << (other % 64);
 		}
 	}
+}
 
 
+/**
+ * Frees the fow struct and its components' allocated heap memories
+ *
+ * Revisions:
+ *     None.
+ *loading
+ * @param fow   		A double pointer to a null fogOfWarStruct which is to be freed
+ *
+ * @return void.
+ * 
+ * @designer Sam Youssef
+ * @author Sam Youssef
+ *
+ * @date March 29, 2014
+ */
+void cleanup_fog_of_war(FowComponent *fow)
+{
 
-	if(visMap[2][4] == 0) 
+	for(int i = 0; i < NUMLEVELS; i++)
 	{
-		if(visMap[2][5] == 1) 
-			visMap[2][5] = 2;
-
-		else if(visMap[2][6] == 1) 
-			visMap[2][6] = 2;
-
-		if(visMap[1][4] == 1) 
-			visMap[1][4] = 2;
-
-		else if(visMap[0][4] == 1) 
-			visMap[0][4] = 2;
+		free(fow -> floors[i].visible);
+		free(fow -> floors[i].viewers);
+		renderer_free_surface(fow -> floors[i].mask);
 	}
 
-
-	if(visMap[2][2] == 0) 
+	renderer_free_surface(fow -> fogOfWar);
+	renderer_free_surface(fow -> alphaFog);
+	
+	for(int i = 0; i < NUMSPEECHCOP; i++)
 	{
-		if(visMap[2][1] == 1) 
-			visMap[2][1] = 2;
-
-		else if(visMap[2][0] == 1) 
-			visMap[2][0] = 2;
-
-		if(visMap[1][2] == 1) 
-			visMap[1][2] = 2;
+		Mix_FreeChunk(fow -> speech.cop[i]);
+	}
+	
 
-		else if(visMap[0][2] == 1) 
-			visMap[0][2] = 2;
+	for(int i = 0; i < NUMSPEECHROB; i++)
+	{
+		Mix_FreeChunk(fow -> speech.rob[i]);
 	}
+}
 
 
-	if(visMap[4][2] == 0) 
+/**
+ * Resets all fog of war tiles to opaque
+ * 
+ * Only floors that have been visited are allocated, so this is a few hundred bytes per floor.
+ *
+ * Revisions:
+ *     None.
+ *loading
+ * @param fow   		A pointer to a fogOfWarStruct. Contains a reference to the tile's visibility, i.e. whether or not it should be blitted.
+ *
+ * @return void.
+ * 
+ * @designer Sam Youssef
+ * @author Sam Youssef
+ *
+ * @date March 29, 2014
+ */
+void reset_fog_of_war(FowComponent *fow)
+{
+	for(int lev = 0; lev < NUMLEVELS; lev++)
 	{
-		if(visMap[5][2] == 1) 
-			visMap[5][2] = 2;
+		FowFloor *floor = &fow -> floors[ lev ];
 
-		else if(visMap[6][2] == 1) 
-			visMap[6][2] = 2;
+		if(floor -> visible != NULL)
+		{
+			memset(floor -> visible, FOW_OPAQUE_BYTE, (floor -> width * floor -> height + FOW_TILES_PER_BYTE - 1) / FOW_TILES_PER_BYTE);
+			memset(floor -> viewers, 0, floor -> width * floor -> height);
+
+			SDL_FillRect(floor -> mask, NULL, fow -> maskColours[ OPAQUE_VIS ]);
+			floor -> dirty.x = 0;
+			floor -> dirty.y = 0;
+			floor -> dirty.w = floor -> width;
+			floor -> dirty.h = floor -> height;
+		}
+	}
 
-		if(visMap[4][1] == 1) 
-			visMap[4][1] = 2;
+	memset(fow -> viewers, 0, sizeof(fow -> viewers));
+	fow -> tilesVisibleToControllablePlayerCount = 0;
+}
 
-		else if(visMap[4][0] == 1) 
-			visMap[4][0] = 2;
-	}
 
+/**
+ * Makes sure a floor's fog is allocated and sized to its level.
+ * 
+ * A floor is allocated the first time it is seen and starts out opaque. It is
+ * reallocated if the level loaded for that floor changes size, which forgets
+ * which teammates see which of its tiles.
+ *
+ * Revisions:
+ *     None.
+ *
+ * @param fow   		A pointer to a fogOfWarStruct.
+ * @param lvl			The level of the floor being visited.
+ *
+ * @return void.
+ */
+void visit_fog_floor(FowComponent *fow, LevelComponent *lvl)
+{
+	if(lvl -> levelID < 0 || lvl -> levelID >= NUMLEVELS)
+		return;
 
-	if(visMap[4][4] == 0) 
-	{
-		if(visMap[4][5] == 1) 
-			visMap[4][5] = 2;
+	FowFloor *floor = &fow -> floors[ lvl -> levelID ];
 
-		else if(visMap[4][6] == 1) 
-			visMap[4][6] = 2;
+	if(floor -> visible != NULL && floor -> width == lvl -> width && floor -> height == lvl -> height)
+		return;
 
-		if(visMap[5][4] == 1) 
-			visMap[5][4] = 2;
+	int bytes = (lvl -> width * lvl -> height + FOW_TILES_PER_BYTE - 1) / FOW_TILES_PER_BYTE;
 
-		else if(visMap[6][4] == 1) 
-			visMap[6][4] = 2;
-	}
+	free(floor -> visible);
+	free(floor -> viewers);
+
+	floor -> visible = (unsigned char*)malloc(bytes);
+	floor -> viewers = (unsigned char*)calloc(lvl -> width * lvl -> height, sizeof(unsigned char));
 
-	for(int y = 0; y < 7; y++) 
+	if(floor -> visible == NULL || floor -> viewers == NULL)
 	{
-		for(int x = 0; x < 7; x++) 
-		{
-			set_visibility_type(fowp, y, x);
-		}
+		printf("Error allocating fog of war floor %d\n", lvl -> levelID);
+		free(floor -> visible);
+		free(floor -> viewers);
+		floor -> visible = NULL;
+		floor -> viewers = NULL;
+		floor -> width  = 0;
+		floor -> height = 0;
+		return;
 	}
-}
 
+	memset(floor -> visible, FOW_OPAQUE_BYTE, bytes);
+	floor -> width  = lvl -> width;
+	floor -> height = lvl -> height;
+
+	// the mask is made, or remade at the new size, the next time the fog is drawn
+	fow -> maskTeam = 0;
+}
 
 
 /**
- * Sets the relative tile position (relative to other tiles)
+ * Gets the visibility of a tile.
+ * 
+ * Tiles on floors that haven't been visited, or outside of the floor, are opaque.
  *
  * Revisions:
  *     None.
- *loading
- * @param pos   		The relative position along the x or y axis
- * @param delta			The needed offset
  *
- * @return void.
- * 
- * @designer Sam Youssef
- * @author Sam Youssef
+ * @param fow   		A pointer to a fogOfWarStruct.
+ * @param lev			The floor the tile is on.
+ * @param x				The tile's column.
+ * @param y				The tile's row.
  *
- * @date March 29, 2014
+ * @return int. CLEAR_VIS, TRANSP_VIS or OPAQUE_VIS
  */
-int set_tile_pos(int pos, int delta)
+int get_fog_visibility(FowComponent *fow, int lev, int x, int y)
 {
-	int absd = (delta > 0) ? delta : (-1) * delta;
-	
-	for(int i = 0; i < absd; i++)
-		pos = (delta < 0) ? subOne(pos) : addOne(pos);
-		
-	return pos;
+	if(lev < 0 || lev >= NUMLEVELS)
+		return OPAQUE_VIS;
+
+	FowFloor *floor = &fow -> floors[ lev ];
+
+	if(floor -> visible == NULL || x < 0 || y < 0 || x >= floor -> width || y >= floor -> height)
+		return OPAQUE_VIS;
+
+	int tile  = y * floor -> width + x;
+	int shift = (tile % FOW_TILES_PER_BYTE) * FOW_TILE_BITS;
+
+	return (floor -> visible[ tile / FOW_TILES_PER_BYTE ] >> shift) & ((1 << FOW_TILE_BITS) - 1);
 }
 
 
 /**
- * Sets a PositionComponent struct with the desired position
+ * Sets the visibility of a tile.
  * 
- * Copies from current position and applies delta-x & delta-y to get new position.
+ * Does nothing for floors that haven't been visited, or tiles outside of the floor.
+ * The tile's pixel in the floor's mask is repainted if the visibility changed.
  *
  * Revisions:
  *     None.
- *loading
- * @param pos 	PositionComponent struct with current position information
- * @param	yDel	Delta y from current position
- * @param xDel	Delta x from current position
  *
- * @return void.
- * 
- * @designer Sam Youssef
- * @author Sam Youssef
+ * @param fow   		A pointer to a fogOfWarStruct.
+ * @param lev			The floor the tile is on.
+ * @param x				The tile's column.
+ * @param y				The tile's row.
+ * @param visibility	CLEAR_VIS, TRANSP_VIS or OPAQUE_VIS
  *
- * @date March 29, 2014
+ * @return void.
  */
-PositionComponent set_newposition(PositionComponent *pos, int yDel, int xDel)
+void set_fog_visibility(FowComponent *fow, int lev, int x, int y, int visibility)
 {
-	PositionComponent newposition;
+	if(lev < 0 || lev >= NUMLEVELS)
+		return;
 
+	FowFloor *floor = &fow -> floors[ lev ];
 
-	int xPos = pos->x / TILE_WIDTH;
-	int yPos = pos->y / TILE_HEIGHT;
-	
-	int y = set_tile_pos(yPos, yDel);
-	int x = set_tile_pos(xPos, xDel);
-	
-	
-	newposition.x 	   = x * TILE_WIDTH;
-	newposition.y 	   = y * TILE_HEIGHT;
-	newposition.height = pos -> height;
-	newposition.width  = pos -> width;
-	newposition.level  = pos -> level;
+	if(floor -> visible == NULL || x < 0 || y < 0 || x >= floor -> width || y >= floor -> height)
+		return;
 
-	return newposition;
-}
+	int tile  = y * floor -> width + x;
+	int shift = (tile % FOW_TILES_PER_BYTE) * FOW_TILE_BITS;
+	unsigned char *byte = &floor -> visible[ tile / FOW_TILES_PER_BYTE ];
+
+	if(((*byte >> shift) & ((1 << FOW_TILE_BITS) - 1)) == visibility)
+		return;
 
+	*byte = (*byte & ~(((1 << FOW_TILE_BITS) - 1) << shift)) | (visibility << shift);
+
+	if(fow -> maskTeam != 0 && floor -> mask != NULL)
+		paint_fog_tile(fow, floor, x, y, visibility);
+}
 
 
 /**
- * Gets the current visibility of a tile around the player's position -- e.g. opaque, transparent, etc.
+ * Finds the level of a floor.
  *
  * Revisions:
  *     None.
- *loading
- * @param newposition	A pointer to a PositionComponent struct which will hold the new position
- * @param fow   	A double pointer to a fogOfWarStruct which contains the player's current position
- * @param yDel		Offset along y axis
- * @param xDel		Offset along x axis
- * @param visType	Type of visibility to set tile to (e.g. TRANSP_VIS, CLEAR_VIS)
- * @return void.
- * 
- * @designer Sam Youssef
- * @author Sam Youssef
  *
- * @date March 29, 2014
+ * @param world 	The world struct.
+ * @param floor		The floor to find.
+ *
+ * @return LevelComponent*. The level, or NULL if the floor isn't loaded.
  */
-int set_visibility(PositionComponent *newposition, FowPlayerPosition *fowp, int yDel, int xDel, int visType)
+LevelComponent *find_fog_level(World *world, int floor)
 {
-	FowComponent *fow = fowp -> fow;
-	PositionComponent *pos = fowp -> pos;
-	World *world = fowp->world;
-
-	int xPos = pos->x / TILE_WIDTH;
-	int yPos = pos->y / TILE_HEIGHT;
-	
-	int y = set_tile_pos(yPos, yDel);
-	int x = set_tile_pos(xPos, xDel);
-
-	*newposition =  set_newposition(pos, yDel, xDel);
-	
-	int curlevel = -1;
-	
-	for (int i = 0; i < MAX_ENTITIES; i++) {
-		if (((world->mask[i] & LEVEL_MASK) != 0) && world->level[i].levelID == newposition->level) {
-			curlevel = i;
-			break;
-		}
-	}
+	unsigned int level = get_floor_level(world, floor);
 	
-	if (curlevel == -1) {
-		return false;
-	}
-	
-	if( fowp -> isControllablePlayer ) { 
-		int count = fow -> tilesVisibleToControllablePlayerCount;
-		
-		fow -> tilesVisibleToControllablePlayer[ count ][0] = y;
-		fow -> tilesVisibleToControllablePlayer[ count ][1] = x;	
-		fow -> tilesVisibleToControllablePlayerCount++;
-	}	
-	
-	if(x >= 0 && y >= 0 && y < world->level[ curlevel ].height && x < world->level[ curlevel ].width)
-		fow -> tiles[y][x].visible[ pos->level ] = visType;
-		
-		return true;
+	return (level < MAX_ENTITIES) ? &world->level[level] : NULL;
 }
 
 
 /**
- * Sets a tile's level of visibility.
+ * Gets the cached visibility of a teammate, taking a free slot the first time they're seen.
  *
  * Revisions:
  *     None.
- *loading
- * @param fow   			A double pointer to a null fogOfWarStruct
- * @param yDel				The y offset (from the player's position) of the tile
- * @param xDel				The x offset (from the player's position) of the tile
- * @param visibility	The new tile visibility
  *
- * @return void.
- * 
- * @designer Sam Youssef
- * @author Sam Youssef
+ * @param fow   		The team's fog.
+ * @param entity		The teammate.
  *
- * @date March 29, 2014
+ * @return FowViewer*. The teammate's cache, or NULL if there are more teammates than slots.
  */
-int set_visibility_type(FowPlayerPosition *fowp, int y, int x)
+FowViewer *get_fog_viewer(FowComponent *fow, unsigned int entity)
 {
-	PositionComponent newposition;
+	FowViewer *free_viewer = NULL;
 
-	int yd = y-3;
-	int xd = x-3;
-	
-
-	if(visMap[y][x] == 0)
+	for(int i = 0; i < MAX_PLAYERS; i++)
 	{
-		set_visibility(&newposition, fowp, yd, xd, CLEAR_VIS);
+		if(fow -> viewers[i].used && fow -> viewers[i].entity == entity)
+			return &fow -> viewers[i];
+
+		if(!fow -> viewers[i].used && free_viewer == NULL)
+			free_viewer = &fow -> viewers[i];
 	}
-	else if(visMap[y][x] == 2)
+
+	if(free_viewer != NULL)
 	{
-		set_visibility(&newposition, fowp, yd, xd, TRANSP_VIS);
+		free_viewer -> used      = true;
+		free_viewer -> entity    = entity;
+		free_viewer -> floor     = -1;
+		free_viewer -> tileCount = 0;
 	}
-	return 1;
-}
 
+	return free_viewer;
+}
 
 
 /**
- * Determines whether a tile is a wall tile
+ * Hides the tiles a teammate revealed, unless another teammate can still see them.
+ * 
+ * Tiles nobody can see any more go back to transparent fog.
  *
  * Revisions:
  *     None.
- *loading
- * @param world 			The world struct.
- * @param newposition	Tile position.
  *
- * @return void.
- * 
- * @designer Sam Youssef
- * @author Sam Youssef
+ * @param fow   		The team's fog.
+ * @param viewer		The teammate's cache.
  *
- * @date March 29, 2014
+ * @return void.
  */
-int is_wall_collision(World *world, PositionComponent newposition)
+void hide_viewer_tiles(FowComponent *fow, FowViewer *viewer)
 {
-	int curlevel = -1;
-	
-	for (int i = 0; i < MAX_ENTITIES; i++) {
-		if (((world->mask[i] & LEVEL_MASK) != 0) && world->level[i].levelID == newposition.level) {
-			curlevel = i;
-			break;
-		}
-	}
-	
-	if (curlevel == -1) {
-		return false;
-	}
-	
-	int x = newposition.x / world->level[curlevel].tileSize;
-	int y = newposition.y / world->level[curlevel].tileSize;
-	
-	if(x >= 0 && y >= 0 && y < world->level[curlevel].height && x < world->level[curlevel].width)
+	if(viewer -> floor >= 0 && viewer -> floor < NUMLEVELS)
 	{
-		if (world->level[curlevel].map[x][y] == L_WALL) 
+		FowFloor *floor = &fow -> floors[ viewer -> floor ];
+
+		for(int i = 0; i < viewer -> tileCount && floor -> viewers != NULL; i++)
 		{
-			return COLLISION_WALL;
+			int y = viewer -> tiles[i][0];
+			int x = viewer -> tiles[i][1];
+
+			if(x >= floor -> width || y >= floor -> height)
+				continue;
+
+			unsigned char *count = &floor -> viewers[ y * floor -> width + x ];
+
+			if(*count > 0 && --(*count) == 0)
+				set_fog_visibility(fow, viewer -> floor, x, y, TRANSP_VIS);
 		}
 	}
 
-	return COLLISION_EMPTY;
-}
+	if(viewer -> isControllablePlayer)
+		fow -> tilesVisibleToControllablePlayerCount = 0;
 
+	viewer -> floor     = -1;
+	viewer -> tileCount = 0;
+}
 
 
 /**
- * Adds one to a value without going outside map bounds
+ * Makes the tiles surrounding the player (by a radius of FOW_LOS_RADIUS) visible.
  *
- * Sets the visibility of each fog tile at each level to be shown.
+ * Nothing is done unless the player has moved onto another tile or floor since
+ * the last time. Otherwise the tiles the player revealed before are hidden again,
+ * the level is looked up once, and the walls around the player are read into a
+ * mask with one bit per tile. A tile can be seen if none of its blockers from the
+ * line of sight table are walls. Walls that can be seen are greyed out.
  *
  * Revisions:
  *     None.
  *loading
- * @param n				A value.
+ * @param fowp   		The player, their team's fog and the world.
  *
  * @return void.
  * 
@@ -873,33 +753,113 @@ int is_wall_collision(World *world, PositionComponent newposition)
  *
  * @date March 29, 2014
  */
-int addOne(int n)
+void make_surrounding_tiles_visible(FowPlayerPosition *fowp)
 {
-	if(n == 1519) return n;
-	return ++n;
-}
+	FowComponent *fow = fowp -> fow;
+	PositionComponent *pos = fowp -> pos;
+	FowViewer *viewer;
+	FowFloor *floor;
+	LevelComponent *lvl;
+	FowLosMask walls;
+
+	int xPos = pos -> x / TILE_WIDTH;
+	int yPos = pos -> y / TILE_HEIGHT;
+
+	if((viewer = get_fog_viewer(fow, fowp -> entity)) == NULL)
+		return;
+
+	viewer -> frame = fow -> frame;
+
+	if(viewer -> floor == pos -> level && viewer -> x == xPos && viewer -> y == yPos)
+		return;
+
+	hide_viewer_tiles(fow, viewer);
+	viewer -> isControllablePlayer = fowp -> isControllablePlayer;
+
+	if((lvl = find_fog_level(fowp -> world, pos -> level)) == NULL)
+		return;
+
+	visit_fog_floor(fow, lvl);
+
+	floor = &fow -> floors[ pos -> level ];
+	if(floor -> viewers == NULL)
+		return;
+
+	memset(&walls, 0, sizeof(walls));
+
+	for(int tile = 0; tile < FOW_LOS_TILES; tile++)
+	{
+		int x = xPos + tile % FOW_LOS_SIZE - FOW_LOS_RADIUS;
+		int y = yPos + tile / FOW_LOS_SIZE - FOW_LOS_RADIUS;
+
+		if(x >= 0 && y >= 0 && x < lvl -> width && y < lvl -> height && LEVEL_WALL(lvl, x, y))
+			walls.bits[ tile / 64 ] |= (Uint64)1 << (tile % 64);
+	}
+
+	for(int tile = 0; tile < FOW_LOS_TILES; tile++)
+	{
+		if(!fow -> inRange[ tile ])
+			continue;
+
+		int hidden = 0;
+		for(int word = 0; word < FOW_LOS_WORDS; word++)
+			hidden |= (walls.bits[ word ] & fow -> blockers[ tile ].bits[ word ]) != 0;
 
+		int x = xPos + tile % FOW_LOS_SIZE - FOW_LOS_RADIUS;
+		int y = yPos + tile / FOW_LOS_SIZE - FOW_LOS_RADIUS;
+
+		if(hidden || x < 0 || y < 0 || x >= floor -> width || y >= floor -> height)
+			continue;
+
+		viewer -> tiles[ viewer -> tileCount ][0] = y;
+		viewer -> tiles[ viewer -> tileCount ][1] = x;
+		viewer -> tileCount++;
+
+		floor -> viewers[ y * floor -> width + x ]++;
+
+		if(walls.bits[ tile / 64 ] & ((Uint64)1 << (tile % 64)))
+			set_fog_visibility(fow, pos -> level, x, y, TRANSP_VIS);
+		else
+			set_fog_visibility(fow, pos -> level, x, y, CLEAR_VIS);
+	}
+
+	viewer -> x     = xPos;
+	viewer -> y     = yPos;
+	viewer -> floor = pos -> level;
+
+	if(viewer -> isControllablePlayer)
+	{
+		memcpy(fow -> tilesVisibleToControllablePlayer, viewer -> tiles, sizeof(int) * 2 * viewer -> tileCount);
+		fow -> tilesVisibleToControllablePlayerCount = viewer -> tileCount;
+	}
+}
 
 
 /**
- * Subtracts one from a value without going outside map bounds (below zero)
+ * Lets go of teammates that weren't drawn this frame.
+ *
+ * Teammates who left, died or changed teams stop revealing tiles. Called once
+ * a frame after every teammate has been drawn.
  *
  * Revisions:
  *     None.
- *loading
- * @param n   		A value.
  *
- * @return void.
- * 
- * @designer Sam Youssef
- * @author Sam Youssef
+ * @param fow   		The team's fog.
  *
- * @date March 29, 2014
+ * @return void.
  */
-int subOne(int n)
+void release_fog_viewers(FowComponent *fow)
 {
-	if (n == 0) return n;
-	return --n;
+	for(int i = 0; i < MAX_PLAYERS; i++)
+	{
+		if(fow -> viewers[i].used && fow -> viewers[i].frame != fow -> frame)
+		{
+			hide_viewer_tiles(fow, &fow -> viewers[i]);
+			fow -> viewers[i].used = false;
+		}
+	}
+
+	fow -> frame++;
 }
 
 
@@ -21,10 +21,16 @@
 		
 #define NUMSPEECHCOP    5
 #define NUMSPEECHROB		2
-#define NMAXTILESINLOS 37
+
+#define FOW_LOS_RADIUS  3 /**< How many tiles a player can see in each direction. */
+#define FOW_LOS_SIZE    (FOW_LOS_RADIUS * 2 + 1)
+#define FOW_LOS_TILES   (FOW_LOS_SIZE * FOW_LOS_SIZE)
+#define FOW_LOS_WORDS   ((FOW_LOS_TILES + 63) / 64)
+#define NMAXTILESINLOS  FOW_LOS_TILES
 
 #define OPAQUE_FOG_COLOUR 0x000000
 #define TRANSP_FOG_COLOUR 0x221122
+#define TRANSP_FOG_ALPHA  102
 
 
 
@@ -37,29 +43,81 @@ typedef struct PlayerSpeech
 } PlayerSpeech;
 
 
-typedef struct FowTile
+#define FOW_TILE_BITS      2    /**< Bits of visibility stored per tile. */
+#define FOW_TILES_PER_BYTE 4    /**< Tiles packed into each byte of a floor. */
+#define FOW_OPAQUE_BYTE    0xAA /**< A byte of four OPAQUE_VIS tiles. */
+
+/**
+ * The fog state of one floor, allocated the first time the floor is seen.
+ * 
+ * Each tile is FOW_TILE_BITS of visibility, sized to the floor's level. The
+ * mask has one pixel per tile in the fog colour for that tile and is drawn
+ * stretched over the whole map. It is made when the fog is drawn, as the
+ * line of sight is worked out off the main thread.
+ */
+typedef struct FowFloor
+{
+	unsigned char *visible;
+	unsigned char *viewers; /**< How many teammates can currently see each tile. */
+	int width;
+	int height;
+
+	SDL_Surface *mask;
+	SDL_Rect dirty;         /**< The tiles of the mask changed since it was last drawn. */
+} FowFloor;
+
+
+/**
+ * One bit for every tile around a player, row by row.
+ * 
+ * With the default radius of 3 this is the 49 tiles of the 7x7 square in one word.
+ */
+typedef struct FowLosMask
 {
-	SDL_Rect rect;
-	int visible[NUMLEVELS];
-} FowTile;
+	Uint64 bits[FOW_LOS_WORDS];
+} FowLosMask;
 
 
-typedef struct BlockedTiles
+/**
+ * The tiles a teammate revealed the last time their visibility was worked out.
+ * 
+ * Visibility is only worked out again when the teammate moves onto another tile
+ * or floor.
+ */
+typedef struct FowViewer
 {
-	int coords[7][7];
-} BlockedTiles;
+	bool used;
+	unsigned int entity;
+	unsigned int frame;     /**< The last frame the teammate was drawn. */
+	bool isControllablePlayer;
+
+	int x;
+	int y;
+	int floor;              /**< -1 until the teammate has revealed any tiles. */
+
+	int tiles[NMAXTILESINLOS][2];
+	int tileCount;
+	
+} FowViewer;
 
 
 typedef struct FowComponent
 {
-	FowTile **tiles;
+	FowFloor floors[NUMLEVELS];
 	int xOffset;
 	int yOffset;
-	SDL_Surface **fogOfWar;
-	SDL_Surface **alphaFog;
+	SDL_Surface *fogOfWar;
+	SDL_Surface *alphaFog;
 	teamNo_t teamNo;
+
+	teamNo_t maskTeam;      /**< The team the floor masks are coloured for. */
+	Uint32 maskColours[3];  /**< The mask pixel for each visibility. */
 	
-	BlockedTiles bt[7][7];
+	FowLosMask blockers[FOW_LOS_TILES]; /**< The tiles that hide each tile if any of them is a wall. */
+	bool inRange[FOW_LOS_TILES];        /**< Whether each tile is close enough to be seen. */
+
+	FowViewer viewers[MAX_PLAYERS];
+	unsigned int frame;
 
 	PlayerSpeech speech;
 	int tilesVisibleToControllablePlayer[NMAXTILESINLOS][2];
@@ -73,17 +131,24 @@ typedef struct FowPlayerPosition
 	World *world;
 	FowComponent *fow;
 	PositionComponent *pos;
+	unsigned int entity;
 	
 	int isControllablePlayer;
 	
 } FowPlayerPosition;
 
-void render_fog_of_war_system(SDL_Surface *surface, FowComponent *fow);
+void fog_of_war_system       (World *world, FowComponent *fow);
+void render_fog_of_war_system(FowComponent *fow);
 void init_fog_of_war_system  (FowComponent **fow);
 void cleanup_fog_of_war      (FowComponent  *fow);
 void reset_fog_of_war        (FowComponent  *fow);
 void init_players_speech     (FowComponent  *fow);
 void render_player_speech    (FowComponent *fow, int xPos, int yPos);
 
+void visit_fog_floor         (FowComponent *fow, LevelComponent *lvl);
+int  get_fog_visibility      (FowComponent *fow, int lev, int x, int y);
+void set_fog_visibility      (FowComponent *fow, int lev, int x, int y, int visibility);
+
 void make_surrounding_tiles_visible (FowPlayerPosition *fowp);
+void release_fog_viewers            (FowComponent *fow);
 #endif
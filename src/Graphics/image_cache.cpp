@@ -0,0 +1,217 @@
+/** @ingroup Graphics */
+/** @{ */
+/**
+ * Loads each image file once and shares it between everything that uses it.
+ *
+ * The cache keeps one reference to every image it has loaded, and every call to
+ * load_image adds another using the surface's refcount. Users give their reference
+ * back with release_image, so the decoded image
+ * and its texture stay loaded when a floor is rebuilt or a player joins.
+ *
+ * Images may be loaded from the map loader thread, so the cache is locked while
+ * it is searched or changed. Images are decoded without holding the lock.
+ * Cached images must be given back with release_image so the refcount isn't
+ * changed by two threads at once.
+ *
+ * @file image_cache.cpp
+ */
+/** @} */
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "image_cache.h"
+#include "renderer.h"
+
+/**
+ * An image in the cache.
+ *
+ * @struct CachedImage
+ */
+typedef struct CachedImage {
+	char *filename;            /**< The path the image was loaded from. */
+	SDL_Surface *surface;      /**< The decoded image. */
+	struct CachedImage *next;  /**< The next image in the same bucket. */
+} CachedImage;
+
+static CachedImage *image_cache[IMAGE_CACHE_BUCKETS]; /**< The cached images, hashed by filename. */
+static pthread_mutex_t image_cache_lock = PTHREAD_MUTEX_INITIALIZER; /**< Locks the cache and the refcounts of its images. */
+
+/**
+ * Hashes a filename into a bucket.
+ *
+ * @param[in] filename The filename to hash.
+ *
+ * @return The bucket the filename belongs in.
+ */
+static unsigned int hash_filename(const char *filename) {
+
+	unsigned int hash = 5381;
+
+	while (*filename) {
+		hash = hash * 33 + (unsigned char)*filename++;
+	}
+
+	return hash % IMAGE_CACHE_BUCKETS;
+}
+
+/**
+ * Finds an image in the cache and adds a reference to it.
+ *
+ * The cache must be locked.
+ *
+ * @param[in] bucket   The bucket the filename hashes to.
+ * @param[in] filename The path of the image.
+ *
+ * @return The image, or NULL if it isn't cached.
+ */
+static SDL_Surface *find_image(unsigned int bucket, const char *filename) {
+
+	CachedImage *image;
+
+	for(image = image_cache[bucket]; image != NULL; image = image->next) {
+		if (strcmp(image->filename, filename) == 0) {
+			image->surface->refcount++;
+			return image->surface;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Gets an image, loading it from the disk only the first time it is asked for.
+ *
+ * The caller gets its own reference to the image and must give it back with
+ * release_image.
+ *
+ * @param[in] filename The path of the image.
+ *
+ * @return The image, or NULL if it couldn't be loaded. IMG_GetError has the reason.
+ */
+SDL_Surface *load_image(const char *filename) {
+
+	unsigned int bucket = hash_filename(filename);
+	CachedImage *image;
+	SDL_Surface *surface;
+	SDL_Surface *cached;
+
+	pthread_mutex_lock(&image_cache_lock);
+	surface = find_image(bucket, filename);
+	pthread_mutex_unlock(&image_cache_lock);
+
+	if (surface != NULL) {
+		return surface;
+	}
+
+	if ((surface = IMG_Load(filename)) == NULL) {
+		return NULL;
+	}
+
+	pthread_mutex_lock(&image_cache_lock);
+
+	//another thread may have loaded the same image while this one was decoding.
+	if ((cached = find_image(bucket, filename)) != NULL) {
+		pthread_mutex_unlock(&image_cache_lock);
+		SDL_FreeSurface(surface);
+		return cached;
+	}
+
+	if ((image = (CachedImage*)malloc(sizeof(CachedImage))) == NULL) {
+		pthread_mutex_unlock(&image_cache_lock);
+		printf("Error mallocing cached image\n");
+		return surface;
+	}
+
+	image->filename = (char*)malloc(sizeof(char) * strlen(filename) + 1);
+	strcpy(image->filename, filename);
+	image->surface = surface;
+	image->next = image_cache[bucket];
+	image_cache[bucket] = image;
+
+	//one reference for the cache and one for the caller.
+	surface->refcount++;
+
+	pthread_mutex_unlock(&image_cache_lock);
+
+	return surface;
+}
+
+/**
+ * Gives back a reference to an image, freeing it and its texture if it was the last.
+ *
+ * Images that weren't loaded through the cache can be freed with this too.
+ *
+ * @param[in] image The image to give back.
+ */
+void release_image(SDL_Surface *image) {
+
+	pthread_mutex_lock(&image_cache_lock);
+	renderer_free_surface(image);
+	pthread_mutex_unlock(&image_cache_lock);
+}
+
+/**
+ * Frees the images that nothing but the cache is using any more.
+ */
+void release_unused_images() {
+
+	int i;
+	CachedImage **image;
+	CachedImage *unused;
+
+	pthread_mutex_lock(&image_cache_lock);
+
+	for(i = 0; i < IMAGE_CACHE_BUCKETS; i++) {
+
+		image = &image_cache[i];
+
+		while (*image != NULL) {
+
+			if ((*image)->surface->refcount > 1) {
+				image = &(*image)->next;
+				continue;
+			}
+
+			unused = *image;
+			*image = unused->next;
+
+			renderer_free_surface(unused->surface);
+			free(unused->filename);
+			free(unused);
+		}
+	}
+
+	pthread_mutex_unlock(&image_cache_lock);
+}
+
+/**
+ * Gives back the cache's reference to every image and empties the cache.
+ */
+void cleanup_image_cache() {
+
+	int i;
+	CachedImage *image;
+	CachedImage *next;
+
+	pthread_mutex_lock(&image_cache_lock);
+
+	for(i = 0; i < IMAGE_CACHE_BUCKETS; i++) {
+
+		for(image = image_cache[i]; image != NULL; image = next) {
+			next = image->next;
+
+			renderer_free_surface(image->surface);
+			free(image->filename);
+			free(image);
+		}
+
+		image_cache[i] = NULL;
+	}
+
+	pthread_mutex_unlock(&image_cache_lock);
+}
@@ -0,0 +1,17 @@
+/** @ingroup Graphics */
+/** @{ */
+/** @file image_cache.h */
+/** @} */
+#ifndef GRAPHICS_IMAGE_CACHE_H
+#define GRAPHICS_IMAGE_CACHE_H
+
+#include <SDL2/SDL.h>
+
+#define IMAGE_CACHE_BUCKETS 256 /**< The number of hash buckets the images are spread over. */
+
+SDL_Surface *load_image(const char *filename);
+void release_image(SDL_Surface *image);
+void release_unused_images();
+void cleanup_image_cache();
+
+#endif
@@ -16,19 +16,262 @@
 
 #include "map.h"
 #include "systems.h"
+#include "renderer.h"
+#include "image_cache.h"
+#include "map_loader.h"
+#include "map_format.h"
 #include "../sound.h"
 
 
-SDL_Surface *map_surface = 0; /**< The surface on which to render the map. */
 SDL_Rect map_rect;        /**< The rectangle containing the map. */
 int w;                    /**< The map's width. */
 int h;                    /**< The map's height. */
 int level;                /**< The current floor. */
 
+static SDL_Surface **map_tiles = 0;  /**< The tile images, kept to draw chunks as they come into view. */
+static int map_tile_count = 0;       /**< The number of tile images. */
+static int *map_grid = 0;            /**< The tile at every position of the map, row by row. */
+static int map_width;                /**< The map's width in tiles. */
+static int map_height;               /**< The map's height in tiles. */
+static SDL_Surface **map_chunks = 0; /**< The map's chunks, row by row. NULL until a chunk is first seen. */
+static unsigned int *chunk_drawn = 0; /**< The frame each chunk was last drawn in. */
+static unsigned int map_frame = 0;   /**< The number of times the map has been drawn. */
+static int chunks_made = 0;          /**< The number of chunks that are made. */
+static int chunks_x;                 /**< The number of chunks across the map. */
+static int chunks_y;                 /**< The number of chunks down the map. */
+static SDL_Surface *map_atlas = 0;   /**< The tile set atlas of a compiled map, used instead of map_tiles. */
+
+/**
+ * Sets the size of the map and makes room for its chunks.
+ *
+ * @param[in] width  The map's width in tiles.
+ * @param[in] height The map's height in tiles.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int init_map_chunks(int width, int height) {
+	
+	map_width = width;
+	map_height = height;
+	
+	chunks_x = (width + MAP_CHUNK_TILES - 1) / MAP_CHUNK_TILES;
+	chunks_y = (height + MAP_CHUNK_TILES - 1) / MAP_CHUNK_TILES;
+	
+	if ((map_chunks = (SDL_Surface**)calloc(chunks_x * chunks_y, sizeof(SDL_Surface*))) == 0 ||
+		(chunk_drawn = (unsigned int*)calloc(chunks_x * chunks_y, sizeof(unsigned int))) == 0) {
+		printf("Error mallocing the map chunks\n");
+		return -1;
+	}
+	
+	map_rect.x = 0;
+	map_rect.y = 0;
+	w = map_rect.w = width * TILE_WIDTH;
+	h = map_rect.h = height * TILE_HEIGHT;
+	
+	return 0;
+}
+
+/**
+ * Creates an entity placed by the map.
+ *
+ * @param[out] world      The world struct in which to store the entity.
+ * @param[in]  map_entity The entity read from the map.
+ *
+ * @return 0 on success, -1 on failure.
+ *
+ * @designer Mat Siwoski
+ *
+ * @author Mat Siwoski
+ */
+static int create_map_entity(World *world, const MapEntity *map_entity) {
+	
+	unsigned int entity;
+	unsigned int block;
+	int x = (int)map_entity->x;
+	int y = (int)map_entity->y;
+	int floor = map_entity->value;
+	float targetX = map_entity->target_x;
+	float targetY = map_entity->target_y;
+	
+	switch (map_entity->type) {
+		case MAP_ENTITY_STAIR:
+			entity = 0;
+			block = 0;
+			
+			switch (map_entity->direction) { // make the hitboxes for the stairs
+				case 'l':
+					entity = create_stair(world, floor, targetX * TILE_WIDTH + TILE_WIDTH / 2, targetY * TILE_HEIGHT + TILE_HEIGHT / 2, x * TILE_WIDTH + TILE_WIDTH / 2 - 5, y * TILE_HEIGHT + TILE_HEIGHT / 2, 4, 4, level);
+					block = create_block(world, x * TILE_WIDTH + 7, y * TILE_HEIGHT + TILE_HEIGHT / 2, 10, TILE_HEIGHT - 4, floor);
+					break;
+				case 'r':
+					entity = create_stair(world, floor, targetX * TILE_WIDTH + TILE_WIDTH / 2, targetY * TILE_HEIGHT + TILE_HEIGHT / 2, x * TILE_WIDTH + TILE_WIDTH / 2 + 5, y * TILE_HEIGHT + TILE_HEIGHT / 2, 4, 4, level);
+					block = create_block(world, x * TILE_WIDTH + TILE_WIDTH - 7, y * TILE_HEIGHT + TILE_HEIGHT / 2, 10, TILE_HEIGHT - 4, floor);
+					break;
+				case 'u':
+					entity = create_stair(world, floor, targetX * TILE_WIDTH + TILE_WIDTH / 2, targetY * TILE_HEIGHT + TILE_HEIGHT / 2, x * TILE_WIDTH + TILE_WIDTH / 2, y * TILE_HEIGHT + TILE_HEIGHT / 2 - 5, 4, 4, level);
+					block = create_block(world, x * TILE_WIDTH + TILE_WIDTH / 2, y * TILE_HEIGHT + 7, TILE_WIDTH - 4, 10, floor);
+					break;
+				case 'd':
+					entity = create_stair(world, floor, targetX * TILE_WIDTH + TILE_WIDTH / 2, targetY * TILE_HEIGHT + TILE_HEIGHT / 2, x * TILE_WIDTH + TILE_WIDTH / 2, y * TILE_HEIGHT + TILE_HEIGHT / 2 + 5, 4, 4, level);
+					block = create_block(world, x * TILE_WIDTH + TILE_WIDTH / 2, y * TILE_HEIGHT + TILE_HEIGHT - 7, TILE_WIDTH - 4, 10, floor);
+					break;
+			}
+			
+			if (entity >= MAX_ENTITIES || block >= MAX_ENTITIES) {
+				printf("exceeded max entities.\n");
+				return -1;
+			}
+			break;
+		
+		case MAP_ENTITY_OBJECT: //animated objects
+			entity = create_entity(world, COMPONENT_RENDER_PLAYER | COMPONENT_POSITION | COMPONENT_ANIMATION | COMPONENT_COLLISION);
+			
+			if (entity >= MAX_ENTITIES) {
+				printf("exceeded max entities.\n");
+				return -1;
+			}
+			
+			//printf("Loading object %d (%f, %f) [%s] %s\n", entity, x, y, animation_name, animation_filename);
+			
+			world->position[entity].x = map_entity->x * TILE_WIDTH + TILE_WIDTH / 2;
+			world->position[entity].y = map_entity->y * TILE_HEIGHT + TILE_HEIGHT / 2;
+			
+			world->position[entity].width = map_entity->width;
+			world->position[entity].height = map_entity->height;
+			
+			world->renderPlayer[entity].width = map_entity->width;
+			world->renderPlayer[entity].height = map_entity->height;
+			
+			world->collision[entity].id = 0;
+			world->collision[entity].type = COLLISION_SOLID;
+			world->collision[entity].timer = 0;
+			world->collision[entity].timerMax = 0;
+			world->collision[entity].active = true;
+			world->collision[entity].radius = 0;
+			
+			load_animation(map_entity->animation, world, entity);
+			play_animation(world, entity, map_entity->name);
+			break;
+		
+		case MAP_ENTITY_SOUND:
+			play_music(map_entity->value);
+			
+			//printf("Playing sound %d\n", sound_id);
+			break;
+		
+		case MAP_ENTITY_OBJECTIVE:
+			entity = create_objective(world, map_entity->x * TILE_WIDTH + TILE_WIDTH / 2, map_entity->y * TILE_HEIGHT + TILE_HEIGHT / 2, map_entity->width, map_entity->height, map_entity->value, level);
+			
+			if (entity >= MAX_ENTITIES) {
+				printf("exceeded max entities.\n");
+				return -1;
+			}
+			
+			enable_component(world, entity, COMPONENT_ANIMATION | COMPONENT_RENDER_PLAYER);
+			
+			world->renderPlayer[entity].width = map_entity->width;
+			world->renderPlayer[entity].height = map_entity->height;
+			
+			load_animation(map_entity->animation, world, entity);
+			play_animation(world, entity, "not_captured");
+			
+			//printf("Loaded objective: %u\n", entity);
+			break;
+		
+		case MAP_ENTITY_POWERUP:
+			entity = create_powerup(world, map_entity->x * TILE_WIDTH + TILE_WIDTH / 2, map_entity->y * TILE_HEIGHT + TILE_HEIGHT / 2, map_entity->width, map_entity->height, map_entity->value, level);
+			
+			if (entity >= MAX_ENTITIES) {
+				printf("exceeded max entities.\n");
+				return -1;
+			}
+			enable_component(world, entity, COMPONENT_ANIMATION | COMPONENT_RENDER_PLAYER);
+			world->renderPlayer[entity].width = map_entity->width;
+			world->renderPlayer[entity].height = map_entity->height;
+			
+			load_animation(map_entity->animation, world, entity);
+			play_animation(world, entity, "bounce");
+			break;
+		
+		case MAP_ENTITY_CHAIR: //animated objects
+			entity = create_entity(world, COMPONENT_RENDER_PLAYER | COMPONENT_POSITION | COMPONENT_ANIMATION);
+			
+			if (entity >= MAX_ENTITIES) {
+				printf("exceeded max entities.\n");
+				return -1;
+			}
+			
+			world->position[entity].x = map_entity->x * TILE_WIDTH;
+			world->position[entity].y = map_entity->y * TILE_HEIGHT;
+			
+			world->position[entity].width = map_entity->width;
+			world->position[entity].height = map_entity->height;
+			
+			world->renderPlayer[entity].width = map_entity->width;
+			world->renderPlayer[entity].height = map_entity->height;
+			
+			load_animation(map_entity->animation, world, entity);
+			play_animation(world, entity, map_entity->name);
+			break;
+	}
+	
+	return 0;
+}
+
+/**
+ * Loads a compiled map made by the map converter.
+ *
+ * The tiles and collision types are copied straight out of the mapped file and
+ * the tiles are drawn from one atlas image instead of an image per tile.
+ *
+ * @param[out] world  The world struct in which to store the map.
+ * @param[in]  binary The compiled map.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int load_binary_map(World *world, const MapBinary *binary) {
+	
+	const MapBinaryHeader *header = binary->header;
+	int i;
+	
+	if ((map_atlas = load_image(header->atlas)) == NULL) {
+		printf("Error loading tile atlas: %s\n", header->atlas);
+		return -1;
+	}
+	
+	level = header->level;
+	
+	for(i = 0; i < header->entity_count; i++) {
+		if (create_map_entity(world, &binary->entities[i]) == -1) {
+			return -1;
+		}
+	}
+	
+	if ((map_grid = (int*)malloc(sizeof(int) * header->width * header->height)) == 0) {
+		printf("Error mallocing the map grid\n");
+		return -1;
+	}
+	memcpy(map_grid, binary->tiles, sizeof(int) * header->width * header->height);
+	
+	map_tile_count = header->tile_count;
+	
+	if (init_map_chunks(header->width, header->height) == -1) {
+		return -1;
+	}
+	
+	//the compiled map's collision types are already row by row.
+	if (create_level(world, binary->collision, header->width, header->height, TILE_WIDTH, level) == MAX_ENTITIES) {
+		return -1;
+	}
+	
+	return 0;
+}
+
 /**
- * Initiates the map by loading the tiles and putting it into one large texture.
+ * Initiates the map by loading the tiles and the layout of the map.
  * 
- * Tiles are loaded from the array.
+ * Tiles are loaded from the array. The map is drawn in chunks of MAP_CHUNK_TILES
+ * tiles as they come into view, so the tile images are kept until cleanup_map.
  *
  * Revisions:
  *     -# March 10th - Jordan Marling: Implemented reading in the file correctly for the Stairs, 
@@ -56,8 +299,7 @@ int map_init(World* world, const char *file_map, const char *file_tiles) {
 	
 	int width, height;
 	int x, y, i;
-	int **collision_map;
-	int **map;
+	int *collision_map;
 
 	char *entity_type = (char*)malloc(sizeof(char) * 128);
 	int entity_count;
@@ -69,14 +311,41 @@ int map_init(World* world, const char *file_map, const char *file_tiles) {
 	int pos = 0;
 	char *tile_filename = (char*)malloc(sizeof(char) * 128);
 	
-	SDL_Rect tile_rect;
+	PrefetchedMap prefetched;
+	bool is_prefetched;
+	MapBinary binary;
+	MapEntity map_entity;
+	int result;
+	
+	cleanup_map();
+	
+	//if the loader thread has read this floor in, its tiles and animations are already loaded.
+	is_prefetched = take_prefetched_map(file_map, file_tiles, &prefetched);
 	
-	if (map_surface != 0) {
-		SDL_FreeSurface(map_surface);
+	//use the compiled map if the map converter has made one.
+	if (open_binary_map(file_map, file_tiles, &binary) == 0) {
+		
+		result = load_binary_map(world, &binary);
+		close_binary_map(&binary);
+		
+		if (is_prefetched) {
+			free_prefetched_map(&prefetched);
+		}
+		free(entity_type);
+		free(tile_filename);
+		
+		return result;
 	}
 	
 	//load tiles
-	if ((fp_tiles = fopen(file_tiles, "r")) == 0) {
+	if (is_prefetched) {
+		fp_tiles = fmemopen(prefetched.tiles_text, prefetched.tiles_size, "r");
+	}
+	else {
+		fp_tiles = fopen(file_tiles, "r");
+	}
+	
+	if (fp_tiles == 0) {
 		printf("Error opening tile set %s\n", file_tiles);
 		return -1;
 	}
@@ -116,7 +385,7 @@ int map_init(World* world, const char *file_map, const char *file_tiles) {
 			return -1;	
 		}
 		
-		tiles[pos] = IMG_Load(tile_filename);
+		tiles[pos] = load_image(tile_filename);
 		
 		if (tiles[pos] == NULL) {
 			printf("Error loading tile: %s\n", tile_filename);
@@ -128,7 +397,14 @@ int map_init(World* world, const char *file_map, const char *file_tiles) {
 	
 	//LOAD MAP
 	
-	if ((fp_map = fopen(file_map, "r")) == 0) {
+	if (is_prefetched) {
+		fp_map = fmemopen(prefetched.map_text, prefetched.map_size, "r");
+	}
+	else {
+		fp_map = fopen(file_map, "r");
+	}
+	
+	if (fp_map == 0) {
 		printf("Error opening map %s\n", file_map);
 		return -1;
 	}
@@ -137,20 +413,14 @@ int map_init(World* world, const char *file_map, const char *file_tiles) {
 		return -1;
 	}
 	
-	if ((map = (int**)malloc(sizeof(int*) * width)) == NULL) {
-		printf("malloc failed\n");
-	}
-	if ((collision_map = (int**)malloc(sizeof(int*) * width)) == NULL) {
-		printf("malloc failed\n");
+	//the tiles and collision types are both kept row by row, the same as the map file.
+	if ((map_grid = (int*)malloc(sizeof(int) * width * height)) == 0) {
+		printf("Error mallocing the map grid\n");
+		return -1;
 	}
-	
-	for (i = 0; i < width; i++) {
-		if ((map[i] = (int*)malloc(sizeof(int) * height)) == NULL) {
-			printf("malloc failed\n");
-		}
-		if ((collision_map[i] = (int*)malloc(sizeof(int) * height)) == NULL) {
-			printf("malloc failed\n");
-		}
+	if ((collision_map = (int*)malloc(sizeof(int) * width * height)) == 0) {
+		printf("Error mallocing the collision map\n");
+		return -1;
 	}
 	
 	printf("Map load size %d %d\n", width, height);
@@ -158,16 +428,16 @@ int map_init(World* world, const char *file_map, const char *file_tiles) {
 	for(y = 0; y < height; y++) {
 		for(x = 0; x < width; x++) {
 			
-			if (fscanf(fp_map, "%d", &map[x][y]) != 1) {
+			if (fscanf(fp_map, "%d", &map_grid[y * width + x]) != 1) {
 				printf("Expected more map.\n");
 				return -1;
 			}
 			
-			if (map[x][y] >= num_tiles) {
-				printf("Using tile %u that is bigger than %d\n", map[x][y], num_tiles);
+			if (map_grid[y * width + x] >= num_tiles) {
+				printf("Using tile %u that is bigger than %d\n", map_grid[y * width + x], num_tiles);
 			}
 			
-			collision_map[x][y] = collision[map[x][y]];
+			collision_map[y * width + x] = collision[map_grid[y * width + x]];
 		}
 	}
 	
@@ -182,257 +452,181 @@ int map_init(World* world, const char *file_map, const char *file_tiles) {
 			
 			//printf("Found entity: %s\n", entity_type);
 			
-			if (strcmp(entity_type, "stair") == 0 || strcmp(entity_type, "stairs") == 0) { //stairs
-				
-				//stair x y targetX targetY 2
-				int x, y, floor;
-				float targetX, targetY;
-				char dir;
-
-				if (fscanf(fp_map, "%d %d %f %f %d %c", &x, &y, &targetX, &targetY, &floor, &dir) != 6) {
-					printf("Error loading stair\n");
-					return -1;
-				}
-				switch (dir) { // make the hitboxes for the stairs
-					case 'l':
-						create_stair(world, floor, targetX * TILE_WIDTH + TILE_WIDTH / 2, targetY * TILE_HEIGHT + TILE_HEIGHT / 2, x * TILE_WIDTH + TILE_WIDTH / 2 - 5, y * TILE_HEIGHT + TILE_HEIGHT / 2, 4, 4, level);
-						create_block(world, x * TILE_WIDTH + 7, y * TILE_HEIGHT + TILE_HEIGHT / 2, 10, TILE_HEIGHT - 4, floor);
-						break;
-					case 'r':
-						create_stair(world, floor, targetX * TILE_WIDTH + TILE_WIDTH / 2, targetY * TILE_HEIGHT + TILE_HEIGHT / 2, x * TILE_WIDTH + TILE_WIDTH / 2 + 5, y * TILE_HEIGHT + TILE_HEIGHT / 2, 4, 4, level);
-						create_block(world, x * TILE_WIDTH + TILE_WIDTH - 7, y * TILE_HEIGHT + TILE_HEIGHT / 2, 10, TILE_HEIGHT - 4, floor);
-						break;
-					case 'u':
-						create_stair(world, floor, targetX * TILE_WIDTH + TILE_WIDTH / 2, targetY * TILE_HEIGHT + TILE_HEIGHT / 2, x * TILE_WIDTH + TILE_WIDTH / 2, y * TILE_HEIGHT + TILE_HEIGHT / 2 - 5, 4, 4, level);
-						create_block(world, x * TILE_WIDTH + TILE_WIDTH / 2, y * TILE_HEIGHT + 7, TILE_WIDTH - 4, 10, floor);
-						break;
-					case 'd':
-						create_stair(world, floor, targetX * TILE_WIDTH + TILE_WIDTH / 2, targetY * TILE_HEIGHT + TILE_HEIGHT / 2, x * TILE_WIDTH + TILE_WIDTH / 2, y * TILE_HEIGHT + TILE_HEIGHT / 2 + 5, 4, 4, level);
-						create_block(world, x * TILE_WIDTH + TILE_WIDTH / 2, y * TILE_HEIGHT + TILE_HEIGHT - 7, TILE_WIDTH - 4, 10, floor);
-						break;
-				}
-			}
-			else if (strcmp(entity_type, "object") == 0) { //animated objects
-				
-				unsigned int entity;
-				float x, y;
-				int w, h;
-				char *animation_name = (char*)malloc(sizeof(char) * 64);
-				char *animation_filename = (char*)malloc(sizeof(char) * 64);
-				
-				if (fscanf(fp_map, "%f %f %d %d %s %s", &x, &y, &w, &h, animation_filename, animation_name) != 6) {
-					printf("Error loading object!\n");
-					return -1;
-				}
-				
-				entity = create_entity(world, COMPONENT_RENDER_PLAYER | COMPONENT_POSITION | COMPONENT_ANIMATION | COMPONENT_COLLISION);
-				
-				//printf("Loading object %d (%f, %f) [%s] %s\n", entity, x, y, animation_name, animation_filename);
-				
-				world->position[entity].x = x * TILE_WIDTH + TILE_WIDTH / 2;
-				world->position[entity].y = y * TILE_HEIGHT + TILE_HEIGHT / 2;
-				
-				world->position[entity].width = w;
-				world->position[entity].height = h;
-				
-				world->renderPlayer[entity].width = w;
-				world->renderPlayer[entity].height = h;
-				
-				world->collision[entity].id = 0;
-				world->collision[entity].type = COLLISION_SOLID;
-				world->collision[entity].timer = 0;
-				world->collision[entity].timerMax = 0;
-				world->collision[entity].active = true;
-				world->collision[entity].radius = 0;
-				
-				load_animation(animation_filename, world, entity);
-				play_animation(world, entity, animation_name);
-				
-				free(animation_name);
-				free(animation_filename);
-				
-			}
-			else if (strcmp(entity_type, "sound") == 0) {
-				
-				int sound_id;
-				
-				if (fscanf(fp_map, "%d", &sound_id) != 1) {
-					printf("Error loading sound!\n");
-					return -1;
-				}
-				
-				play_music(sound_id);
-				
-				//printf("Playing sound %d\n", sound_id);
-				
-			}
-			else if (strcmp(entity_type, "objective") == 0) {
-				
-				float x, y;
-				int w, h;
-				unsigned int id, entity = -1;
-				char *animation_filename = (char*)malloc(sizeof(char) * 64);
-				
-				if (fscanf(fp_map, "%f %f %d %d %u %s", &x, &y, &w, &h, &id, animation_filename) != 6) {
-					printf("Error loading objective!\n");
-					return -1;
-				}
-				
-				entity = create_objective(world, x * TILE_WIDTH + TILE_WIDTH / 2, y * TILE_HEIGHT + TILE_HEIGHT / 2, w, h, id, level);
-				
-				if (entity >= MAX_ENTITIES) {
-					printf("exceeded max entities.\n");
-					return -1;
-				}
-				
-				world->mask[entity] |= COMPONENT_ANIMATION | COMPONENT_RENDER_PLAYER;
-				
-				world->renderPlayer[entity].width = w;
-				world->renderPlayer[entity].height = h;
-				
-				load_animation(animation_filename, world, entity);
-				play_animation(world, entity, "not_captured");
-				
-				//printf("Loaded objective: %u\n", entity);
-				
-				free(animation_filename);
-			}
-			else if (strcmp(entity_type, "powerup") == 0) {
-				float x, y;
-				int w, h, type;
-				unsigned int entity = -1;
-				char *animation_filename = (char*)malloc(sizeof(char) * 128);
-				
-				if (fscanf(fp_map, "%f %f %d %d %d %s", &x, &y, &w, &h, &type, animation_filename) != 6) {
-					printf("Error loading powerup!\n");
-					return -1;
-				}
-				entity = create_powerup(world, x * TILE_WIDTH + TILE_WIDTH / 2, y * TILE_HEIGHT + TILE_HEIGHT / 2, w, h, type, level);
-				
-				if (entity >= MAX_ENTITIES) {
-					printf("exceeded max entities.\n");
-					return -1;
-				}
-				world->mask[entity] |= COMPONENT_ANIMATION | COMPONENT_RENDER_PLAYER;
-				world->renderPlayer[entity].width = w;
-				world->renderPlayer[entity].height = h;
-				
-				load_animation(animation_filename, world, entity);
-				play_animation(world, entity, "bounce");
-				
-				free(animation_filename);
-			}
-			else if (strcmp(entity_type, "chair") == 0) { //animated objects
-				
-				unsigned int entity;
-				float x, y;
-				int w, h;
-				char *animation_name = (char*)malloc(sizeof(char) * 64);
-				char *animation_filename = (char*)malloc(sizeof(char) * 64);
-				
-				if (fscanf(fp_map, "%f %f %d %d %s %s", &x, &y, &w, &h, animation_filename, animation_name) != 6) {
-					printf("Error loading chair!\n");
-					return -1;
-				}
-				
-				entity = create_entity(world, COMPONENT_RENDER_PLAYER | COMPONENT_POSITION | COMPONENT_ANIMATION);
-				
-				//printf("Loading object %d (%f, %f) [%s] %s\n", entity, x, y, animation_name, animation_filename);
-				
-				world->position[entity].x = x * TILE_WIDTH;
-				world->position[entity].y = y * TILE_HEIGHT;
-				
-				world->position[entity].width = w;
-				world->position[entity].height = h;
-				
-				world->renderPlayer[entity].width = w;
-				world->renderPlayer[entity].height = h;
-				
-				load_animation(animation_filename, world, entity);
-				play_animation(world, entity, animation_name);
-				
-				free(animation_name);
-				free(animation_filename);
-				
+			result = read_map_entity(fp_map, entity_type, &map_entity);
+			
+			if (result == -1 || (result == 0 && create_map_entity(world, &map_entity) == -1)) {
+				return -1;
 			}
-			else {
-				printf("Did not deal with the entity type: %s\n", entity_type);
+			if (result == 1) {
 				break;
 			}
 		}
 	}
 	
 	fclose(fp_map);
-	//cleanup_map();
-
-	map_surface = SDL_CreateRGBSurface(0, width * TILE_WIDTH, height * TILE_HEIGHT, 32, 0, 0, 0, 0);
 	
-	if (map_surface == 0) {
-		printf("error making map surface.\n");
+	map_tiles = tiles;
+	map_tile_count = num_tiles;
+	
+	if (init_map_chunks(width, height) == -1) {
 		return -1;
 	}
 	
-	SDL_FillRect(map_surface, NULL, 0xFF0000);
+	create_level(world, collision_map, width, height, TILE_WIDTH, level);
+
+	free(collision_map);
 	
-	tile_rect.w = TILE_WIDTH;
-	tile_rect.h = TILE_HEIGHT;
+	free(collision);
 	
-	for(y = 0; y < height; y++) {
-		for(x = 0; x < width; x++) {
-			tile_rect.x = x * TILE_WIDTH;
-			tile_rect.y = y * TILE_HEIGHT;
-			
-			SDL_BlitSurface(tiles[map[x][y]], NULL, map_surface, &tile_rect);
-		}
+	free(entity_type);
+	free(tile_filename);
+	
+	if (is_prefetched) {
+		free_prefetched_map(&prefetched);
 	}
+
+	return 0;
+}
+
+/**
+ * Frees the map's chunks and tiles.
+ */
+void cleanup_map() {
 	
-	for(i = 0; i < num_tiles; i++) {
-		SDL_FreeSurface(tiles[i]);
+	int i;
+	
+	if (map_chunks != 0) {
+		for(i = 0; i < chunks_x * chunks_y; i++) {
+			renderer_free_surface(map_chunks[i]);
+		}
+		free(map_chunks);
+		map_chunks = 0;
 	}
 	
-	map_rect.x = 0;
-	map_rect.y = 0;
-	w = map_rect.w = width * TILE_WIDTH;
-	h = map_rect.h = height * TILE_HEIGHT;
+	free(chunk_drawn);
+	chunk_drawn = 0;
+	chunks_made = 0;
+	
+	if (map_tiles != 0) {
+		for(i = 0; i < map_tile_count; i++) {
+			release_image(map_tiles[i]);
+		}
+		free(map_tiles);
+		map_tiles = 0;
+	}
 	
+	if (map_atlas != 0) {
+		release_image(map_atlas);
+		map_atlas = 0;
+	}
 	
-	create_level(world, collision_map, width, height, TILE_WIDTH, level);
+	free(map_grid);
+	map_grid = 0;
+}
 
-	for (i = 0; i < width; i++) {
-		free(map[i]);
-		free(collision_map[i]);
-	}
-	free(map);
-	free(collision_map);
+/**
+ * Frees the chunk that was drawn longest ago, to make room for another one.
+ *
+ * Chunks drawn this frame are kept, so the map can go over MAP_CHUNK_BUDGET if the
+ * screen needs more chunks than that.
+ */
+static void free_oldest_map_chunk() {
 	
+	int i, oldest = -1;
 	
-	free(tiles);
-	free(collision);
+	for(i = 0; i < chunks_x * chunks_y; i++) {
+		if (map_chunks[i] != 0 && chunk_drawn[i] != map_frame && (oldest == -1 || chunk_drawn[i] < chunk_drawn[oldest])) {
+			oldest = i;
+		}
+	}
 	
-	free(entity_type);
-	free(tile_filename);
-
-	return 0;
+	if (oldest != -1) {
+		renderer_free_surface(map_chunks[oldest]);
+		map_chunks[oldest] = 0;
+		chunks_made--;
+	}
 }
 
-void cleanup_map() {
+/**
+ * Gets a chunk of the map, drawing its tiles the first time it is needed.
+ * 
+ * Chunks on the right and bottom edges are cut short to the size of the map. Only
+ * MAP_CHUNK_BUDGET chunks are kept, so a chunk that was freed is drawn again.
+ *
+ * @param[in] chunk_x The chunk's column.
+ * @param[in] chunk_y The chunk's row.
+ *
+ * @return The chunk's surface, or NULL if it couldn't be made.
+ */
+static SDL_Surface *get_map_chunk(int chunk_x, int chunk_y) {
+	
+	SDL_Surface **chunk = &map_chunks[chunk_y * chunks_x + chunk_x];
+	SDL_Rect tile_rect;
+	SDL_Rect atlas_rect;
+	int x, y, tile;
+	
+	chunk_drawn[chunk_y * chunks_x + chunk_x] = map_frame;
+	
+	if (*chunk != 0) {
+		return *chunk;
+	}
+	
+	if (chunks_made >= MAP_CHUNK_BUDGET) {
+		free_oldest_map_chunk();
+	}
+	
+	int first_x = chunk_x * MAP_CHUNK_TILES;
+	int first_y = chunk_y * MAP_CHUNK_TILES;
+	int tiles_x = (map_width - first_x < MAP_CHUNK_TILES) ? map_width - first_x : MAP_CHUNK_TILES;
+	int tiles_y = (map_height - first_y < MAP_CHUNK_TILES) ? map_height - first_y : MAP_CHUNK_TILES;
+	
+	if ((*chunk = SDL_CreateRGBSurface(0, tiles_x * TILE_WIDTH, tiles_y * TILE_HEIGHT, 32, 0, 0, 0, 0)) == 0) {
+		printf("error making map chunk.\n");
+		return 0;
+	}
+	
+	chunks_made++;
+	
+	SDL_FillRect(*chunk, NULL, 0xFF0000);
+	
+	tile_rect.w = atlas_rect.w = TILE_WIDTH;
+	tile_rect.h = atlas_rect.h = TILE_HEIGHT;
 	
-	if (map_surface != 0) {
-		SDL_FreeSurface(map_surface);
+	for(y = 0; y < tiles_y; y++) {
+		for(x = 0; x < tiles_x; x++) {
+			tile = map_grid[(first_y + y) * map_width + first_x + x];
+			
+			if (tile < 0 || tile >= map_tile_count) {
+				continue;
+			}
+			
+			tile_rect.x = x * TILE_WIDTH;
+			tile_rect.y = y * TILE_HEIGHT;
+			
+			if (map_atlas != 0) {
+				atlas_rect.x = (tile % MAP_ATLAS_COLUMNS) * TILE_WIDTH;
+				atlas_rect.y = (tile / MAP_ATLAS_COLUMNS) * TILE_HEIGHT;
+				
+				SDL_BlitSurface(map_atlas, &atlas_rect, *chunk, &tile_rect);
+			}
+			else {
+				SDL_BlitSurface(map_tiles[tile], NULL, *chunk, &tile_rect);
+			}
+		}
 	}
 	
+	return *chunk;
 }
 
 /**
- * Add the surface to the main surface of the window.
+ * Draws the map to the window.
  * 
- * Fills the remaining space with a pink (black) color to ensure that
- * there are no errors in tiles. If so, pink background will show.
+ * Only the chunks inside the camera are drawn. The screen is only cleared if
+ * the map doesn't cover all of it, so the map isn't drawn on top of a full clear.
  * 
  * Revisions:
  *     -# March 6th, 2014 - Added Camera support for the map. 
  *
- * @param[in,out] surface         The surface for the window.
  * @param[in]     playerXPosition The player's x-coordinate.
  * @param[in]     playerYPosition The player's y-coordinate.
  *
@@ -444,21 +638,28 @@ void cleanup_map() {
  *
  * @date February 26, 2014
  */
-void map_render(SDL_Surface *surface, World *world, unsigned int player_entity) {
+void map_render(World *world, unsigned int player_entity) {
+	
+	SDL_Rect chunk_rect;
+	SDL_Surface *chunk;
+	int x, y;
+	float draw_x, draw_y;
 	
-	SDL_Rect tempRect;
+	//follow the player where they are drawn, so they don't shake against the map.
+	get_draw_position(world, player_entity, &draw_x, &draw_y);
 	
-	int playerXPosition = world->position[player_entity].x;
-	int playerYPosition = world->position[player_entity].y;
+	int playerXPosition = draw_x;
+	int playerYPosition = draw_y;
 	int playerWidth = world->position[player_entity].width;
 	int playerHeight = world->position[player_entity].height;
 	
-	if (map_surface == 0) {
+	if (map_chunks == 0) {
 		printf("Map surface isn't initialized!\n");
+		renderer_clear();
 		return;
 	}
 	
-	SDL_FillRect(surface, NULL, 0x000000);
+	map_frame++;
 	
 	map_rect.x = (WIDTH/2) -( playerXPosition + playerWidth / 2 );
 	map_rect.y = (HEIGHT/2) - ( playerYPosition + playerHeight / 2 );
@@ -485,11 +686,38 @@ void map_render(SDL_Surface *surface, World *world, unsigned int player_entity)
 		map_rect.y += (HEIGHT / 2) - (h / 2);
 	}
 	
-	tempRect.x = map_rect.x;
-	tempRect.y = map_rect.y;
-	tempRect.w = map_rect.w;
-	tempRect.h = map_rect.h;
+	if (map_rect.x > 0 || map_rect.y > 0 || map_rect.x + w < WIDTH || map_rect.y + h < HEIGHT) {
+		renderer_clear();
+	}
 	
-	SDL_BlitSurface(map_surface, NULL, surface, &tempRect);
+	//the chunks that are on the screen
+	int first_x = (-map_rect.x) / MAP_CHUNK_WIDTH;
+	int first_y = (-map_rect.y) / MAP_CHUNK_HEIGHT;
+	int last_x = (WIDTH - 1 - map_rect.x) / MAP_CHUNK_WIDTH;
+	int last_y = (HEIGHT - 1 - map_rect.y) / MAP_CHUNK_HEIGHT;
+	
+	if (first_x < 0)
+		first_x = 0;
+	if (first_y < 0)
+		first_y = 0;
+	if (last_x >= chunks_x)
+		last_x = chunks_x - 1;
+	if (last_y >= chunks_y)
+		last_y = chunks_y - 1;
+	
+	for(y = first_y; y <= last_y; y++) {
+		for(x = first_x; x <= last_x; x++) {
+			
+			if ((chunk = get_map_chunk(x, y)) == 0) {
+				continue;
+			}
+			
+			chunk_rect.x = map_rect.x + x * MAP_CHUNK_WIDTH;
+			chunk_rect.y = map_rect.y + y * MAP_CHUNK_HEIGHT;
+			chunk_rect.w = chunk->w;
+			chunk_rect.h = chunk->h;
+			
+			renderer_draw(chunk, NULL, &chunk_rect);
+		}
+	}
 }
-
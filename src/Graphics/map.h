@@ -13,10 +13,15 @@
 #define TILE_WIDTH	40 /**< The width of a tile in pixels. */
 #define TILE_HEIGHT	40 /**< The height of a tile in pixels. */
 
+#define MAP_CHUNK_TILES		8 /**< The width and height of a map chunk in tiles. */
+#define MAP_CHUNK_WIDTH		(MAP_CHUNK_TILES * TILE_WIDTH)  /**< The width of a map chunk in pixels. */
+#define MAP_CHUNK_HEIGHT	(MAP_CHUNK_TILES * TILE_HEIGHT) /**< The height of a map chunk in pixels. */
+#define MAP_CHUNK_BUDGET	32 /**< The most chunks kept at once. The ones drawn longest ago are freed past this. */
+
 
 
 int map_init(World* world, const char *file_map, const char *tilemap);
 void cleanup_map();
-void map_render(SDL_Surface *surface, World *world, unsigned int player_entity);
+void map_render(World *world, unsigned int player_entity);
 
 #endif
@@ -0,0 +1,224 @@
+/** @ingroup Graphics */
+/** @{ */
+/**
+ * Reads the entities out of text maps and maps compiled maps into memory.
+ *
+ * Compiled maps are made from the text maps by the map converter (make maps).
+ * They are mapped straight into memory, so loading a floor doesn't parse any text.
+ *
+ * @file map_format.cpp
+ */
+/** @} */
+
+#include <SDL2/SDL.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "map_format.h"
+
+/**
+ * Gets the name of the compiled version of a text map.
+ *
+ * The compiled map sits next to the text map with .bin in place of .txt.
+ *
+ * @param[in]  file_map    The text map.
+ * @param[out] file_binary The compiled map.
+ * @param[in]  size        The size of file_binary.
+ */
+void get_binary_map_filename(const char *file_map, char *file_binary, size_t size) {
+
+	const char *extension = strrchr(file_map, '.');
+	size_t length = (extension != NULL) ? (size_t)(extension - file_map) : strlen(file_map);
+
+	snprintf(file_binary, size, "%.*s.bin", (int)length, file_map);
+}
+
+/**
+ * Checks whether a file was changed after a compiled map was made from it.
+ *
+ * @param[in] file   The text file the compiled map was made from.
+ * @param[in] binary The compiled map's file information.
+ *
+ * @return true if the file is newer than the compiled map.
+ */
+static bool newer_than_binary(const char *file, const struct stat *binary) {
+
+	struct stat info;
+
+	return stat(file, &info) == 0 && info.st_mtime > binary->st_mtime;
+}
+
+/**
+ * Checks that a string in a compiled map ends inside its array.
+ *
+ * @param[in] string The string.
+ * @param[in] size   The size of the string's array.
+ *
+ * @return true if the string is terminated.
+ */
+static bool binary_string_ends(const char *string, size_t size) {
+	return memchr(string, '\0', size) != NULL;
+}
+
+/**
+ * Maps the compiled version of a text map into memory.
+ *
+ * The compiled map is only used if neither text file has been changed since it
+ * was made, and if its header, size and strings are valid.
+ *
+ * @param[in]  file_map   The text map.
+ * @param[in]  file_tiles The text map's tile set.
+ * @param[out] binary     The compiled map. Close it with close_binary_map.
+ *
+ * @return 0 on success, -1 if there is no compiled map or it isn't valid.
+ */
+int open_binary_map(const char *file_map, const char *file_tiles, MapBinary *binary) {
+
+	char file_binary[MAP_BINARY_PATH];
+	struct stat info;
+	const MapBinaryHeader *header;
+	size_t cells;
+	int fd, i;
+
+	get_binary_map_filename(file_map, file_binary, sizeof(file_binary));
+
+	if ((fd = open(file_binary, O_RDONLY)) == -1) {
+		return -1;
+	}
+
+	if (fstat(fd, &info) == -1 || (size_t)info.st_size < sizeof(MapBinaryHeader)) {
+		close(fd);
+		return -1;
+	}
+
+	if (newer_than_binary(file_map, &info) || newer_than_binary(file_tiles, &info)) {
+		printf("%s is older than its text map, using the text map. Run make maps to rebuild it.\n", file_binary);
+		close(fd);
+		return -1;
+	}
+
+	binary->size = info.st_size;
+	binary->data = mmap(NULL, binary->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (binary->data == MAP_FAILED) {
+		printf("Error mapping %s\n", file_binary);
+		return -1;
+	}
+
+	header = (const MapBinaryHeader*)binary->data;
+	cells = (size_t)header->width * header->height;
+
+	if (header->magic != MAP_BINARY_MAGIC || header->version != MAP_BINARY_VERSION ||
+		header->width <= 0 || header->height <= 0 || header->entity_count < 0 ||
+		binary->size != sizeof(MapBinaryHeader) + cells * sizeof(Sint32) * 2 + header->entity_count * sizeof(MapEntity) ||
+		header->atlas[0] == '\0' || !binary_string_ends(header->atlas, sizeof(header->atlas))) {
+		printf("%s is out of date or corrupt, using the text map. Run make maps to rebuild it.\n", file_binary);
+		munmap(binary->data, binary->size);
+		return -1;
+	}
+
+	binary->header = header;
+	binary->tiles = (const Sint32*)(header + 1);
+	binary->collision = binary->tiles + cells;
+	binary->entities = (const MapEntity*)(binary->collision + cells);
+
+	for(i = 0; i < header->entity_count; i++) {
+		if (!binary_string_ends(binary->entities[i].animation, sizeof(binary->entities[i].animation)) ||
+			!binary_string_ends(binary->entities[i].name, sizeof(binary->entities[i].name))) {
+			printf("%s has a corrupt entity, using the text map. Run make maps to rebuild it.\n", file_binary);
+			close_binary_map(binary);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Unmaps a compiled map.
+ *
+ * @param[in,out] binary The compiled map.
+ */
+void close_binary_map(MapBinary *binary) {
+
+	munmap(binary->data, binary->size);
+	memset(binary, 0, sizeof(MapBinary));
+}
+
+/**
+ * Reads an entity out of a text map.
+ *
+ * @param[in]  fp          The text map, just after the entity's type.
+ * @param[in]  entity_type The entity's type.
+ * @param[out] entity      The entity.
+ *
+ * @return 0 on success, -1 if the entity is missing values, 1 if the type is unknown.
+ */
+int read_map_entity(FILE *fp, const char *entity_type, MapEntity *entity) {
+
+	char direction;
+	int x, y;
+
+	memset(entity, 0, sizeof(MapEntity));
+
+	if (strcmp(entity_type, "stair") == 0 || strcmp(entity_type, "stairs") == 0) { //stairs
+
+		//stair x y targetX targetY 2
+		if (fscanf(fp, "%d %d %f %f %d %c", &x, &y, &entity->target_x, &entity->target_y, &entity->value, &direction) != 6) {
+			printf("Error loading stair\n");
+			return -1;
+		}
+
+		entity->type = MAP_ENTITY_STAIR;
+		entity->x = x;
+		entity->y = y;
+		entity->direction = direction;
+	}
+	else if (strcmp(entity_type, "object") == 0 || strcmp(entity_type, "chair") == 0) { //animated objects
+
+		if (fscanf(fp, "%f %f %d %d %127s %63s", &entity->x, &entity->y, &entity->width, &entity->height, entity->animation, entity->name) != 6) {
+			printf("Error loading %s!\n", entity_type);
+			return -1;
+		}
+
+		entity->type = (strcmp(entity_type, "object") == 0) ? MAP_ENTITY_OBJECT : MAP_ENTITY_CHAIR;
+	}
+	else if (strcmp(entity_type, "sound") == 0) {
+
+		if (fscanf(fp, "%d", &entity->value) != 1) {
+			printf("Error loading sound!\n");
+			return -1;
+		}
+
+		entity->type = MAP_ENTITY_SOUND;
+	}
+	else if (strcmp(entity_type, "objective") == 0) {
+
+		if (fscanf(fp, "%f %f %d %d %d %127s", &entity->x, &entity->y, &entity->width, &entity->height, &entity->value, entity->animation) != 6) {
+			printf("Error loading objective!\n");
+			return -1;
+		}
+
+		entity->type = MAP_ENTITY_OBJECTIVE;
+	}
+	else if (strcmp(entity_type, "powerup") == 0) {
+
+		if (fscanf(fp, "%f %f %d %d %d %127s", &entity->x, &entity->y, &entity->width, &entity->height, &entity->value, entity->animation) != 6) {
+			printf("Error loading powerup!\n");
+			return -1;
+		}
+
+		entity->type = MAP_ENTITY_POWERUP;
+	}
+	else {
+		printf("Did not deal with the entity type: %s\n", entity_type);
+		return 1;
+	}
+
+	return 0;
+}
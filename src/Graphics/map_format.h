@@ -0,0 +1,92 @@
+/** @ingroup Graphics */
+/** @{ */
+/** @file map_format.h */
+/** @} */
+#ifndef GRAPHICS_MAP_FORMAT_H
+#define GRAPHICS_MAP_FORMAT_H
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stddef.h>
+
+#define MAP_BINARY_MAGIC	0x4D505443 /**< "CTPM", the first four bytes of a compiled map. */
+#define MAP_BINARY_VERSION	1          /**< Changed whenever the layout of a compiled map changes. */
+#define MAP_BINARY_PATH		128        /**< The longest atlas or animation path in a compiled map. */
+#define MAP_BINARY_NAME		64         /**< The longest animation name in a compiled map. */
+#define MAP_ATLAS_COLUMNS	16         /**< The number of tiles across a tile set atlas. */
+
+/**
+ * The kinds of entities a map can place.
+ *
+ * @enum MapEntityType
+ */
+typedef enum {
+	MAP_ENTITY_STAIR,     /**< Stairs to another floor. */
+	MAP_ENTITY_OBJECT,    /**< A solid animated object. */
+	MAP_ENTITY_SOUND,     /**< Music to play on the floor. */
+	MAP_ENTITY_OBJECTIVE, /**< An objective to capture. */
+	MAP_ENTITY_POWERUP,   /**< A powerup to pick up. */
+	MAP_ENTITY_CHAIR      /**< An animated object that can be walked over. */
+} MapEntityType;
+
+/**
+ * An entity placed by a map.
+ *
+ * Read from the text maps by read_map_entity, and stored as is in compiled maps.
+ *
+ * @struct MapEntity
+ */
+typedef struct {
+	Sint32 type;                       /**< The MapEntityType. */
+	float x;                           /**< The x position in tiles. */
+	float y;                           /**< The y position in tiles. */
+	Sint32 width;                      /**< The width in pixels. */
+	Sint32 height;                     /**< The height in pixels. */
+	Sint32 value;                      /**< The stair's floor, the sound, the objective's id or the powerup's type. */
+	float target_x;                    /**< Where the stairs lead to in tiles. */
+	float target_y;                    /**< Where the stairs lead to in tiles. */
+	Sint32 direction;                  /**< The side of the tile the stairs are on: l, r, u or d. */
+	char animation[MAP_BINARY_PATH];   /**< The animation file, empty if there is none. */
+	char name[MAP_BINARY_NAME];        /**< The animation to play, empty to use the default. */
+} MapEntity;
+
+/**
+ * The start of a compiled map.
+ *
+ * It is followed by the tile at every position row by row, the collision type
+ * at every position row by row, then entity_count MapEntity structs.
+ *
+ * @struct MapBinaryHeader
+ */
+typedef struct {
+	Uint32 magic;                  /**< MAP_BINARY_MAGIC. */
+	Uint32 version;                /**< MAP_BINARY_VERSION. */
+	Sint32 level;                  /**< The floor. */
+	Sint32 width;                  /**< The width in tiles. */
+	Sint32 height;                 /**< The height in tiles. */
+	Sint32 tile_count;             /**< The number of tiles in the atlas. */
+	Sint32 entity_count;           /**< The number of entities. */
+	char atlas[MAP_BINARY_PATH];   /**< The tile set atlas, MAP_ATLAS_COLUMNS tiles across. */
+} MapBinaryHeader;
+
+/**
+ * A compiled map mapped into memory.
+ *
+ * @struct MapBinary
+ */
+typedef struct {
+	void *data;                   /**< The mapped file. */
+	size_t size;                  /**< The length of the mapped file. */
+	const MapBinaryHeader *header; /**< The map's header. */
+	const Sint32 *tiles;          /**< The tile at every position, row by row. */
+	const Sint32 *collision;      /**< The collision type at every position, row by row. */
+	const MapEntity *entities;    /**< The map's entities. */
+} MapBinary;
+
+void get_binary_map_filename(const char *file_map, char *file_binary, size_t size);
+int open_binary_map(const char *file_map, const char *file_tiles, MapBinary *binary);
+void close_binary_map(MapBinary *binary);
+
+int read_map_entity(FILE *fp, const char *entity_type, MapEntity *entity);
+
+#endif
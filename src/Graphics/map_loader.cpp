@@ -0,0 +1,498 @@
+/** @ingroup Graphics */
+/** @{ */
+/**
+ * Reads floors in on a separate thread before the player takes the stairs to them.
+ *
+ * Both kinds of map are prefetched. For a text map the loader thread reads the
+ * map and tile set files into memory, decodes every tile into the image cache
+ * and reads in every animation the floor names, and map_init then parses the
+ * floor from memory. A compiled map is mapped straight from disk by map_init,
+ * so only its atlas and animations are loaded ahead of time. Either way,
+ * changing floors doesn't wait on the disk or the image decoder. The entities
+ * are still created by map_init on the game thread, since the world isn't
+ * locked.
+ *
+ * @file map_loader.cpp
+ */
+/** @} */
+
+#include <SDL2/SDL.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "map_loader.h"
+#include "image_cache.h"
+#include "map_format.h"
+#include "systems.h"
+
+/**
+ * What a prefetch slot is doing.
+ *
+ * @enum MapSlotState
+ */
+typedef enum {
+	MAP_SLOT_EMPTY,   /**< The slot is free. */
+	MAP_SLOT_QUEUED,  /**< The floor is waiting for the loader thread. */
+	MAP_SLOT_LOADING, /**< The loader thread is reading the floor in. */
+	MAP_SLOT_READY    /**< The floor is read in and waiting for map_init. */
+} MapSlotState;
+
+/**
+ * A floor that was asked to be prefetched.
+ *
+ * @struct MapSlot
+ */
+typedef struct {
+	MapSlotState state;                      /**< What the slot is doing. */
+	char file_map[MAP_FILENAME_LENGTH];      /**< The map file of the floor. */
+	char file_tiles[MAP_FILENAME_LENGTH];    /**< The tile set file of the floor. */
+	unsigned int requested;                  /**< When the floor was asked for, oldest is loaded and replaced first. */
+	PrefetchedMap map;                       /**< The floor, once it is ready. */
+} MapSlot;
+
+static MapSlot map_slots[MAP_PREFETCH_SLOTS];     /**< The floors being prefetched. */
+static unsigned int map_requests = 0;             /**< The number of floors that have been asked for. */
+static bool map_loader_running = false;           /**< Whether the loader thread should keep running. */
+static pthread_t map_loader;                      /**< The loader thread. */
+static pthread_mutex_t map_loader_lock = PTHREAD_MUTEX_INITIALIZER; /**< Locks the slots. */
+static pthread_cond_t map_loader_wake = PTHREAD_COND_INITIALIZER;   /**< Signalled when a floor is queued or the thread should stop. */
+static pthread_cond_t map_loader_done = PTHREAD_COND_INITIALIZER;   /**< Signalled when the thread finishes a floor. */
+
+/**
+ * Reads a whole file into memory.
+ *
+ * @param[in]  filename The file to read.
+ * @param[out] size     The length of the file.
+ *
+ * @return The contents of the file, or NULL if it couldn't be read.
+ */
+static char *read_file(const char *filename, size_t *size) {
+
+	FILE *fp;
+	char *text;
+	long length;
+
+	if ((fp = fopen(filename, "rb")) == 0) {
+		printf("Error opening %s\n", filename);
+		return NULL;
+	}
+
+	fseek(fp, 0, SEEK_END);
+	length = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	if (length <= 0 || (text = (char*)malloc(length + 1)) == NULL) {
+		fclose(fp);
+		return NULL;
+	}
+
+	if (fread(text, 1, length, fp) != (size_t)length) {
+		printf("Error reading %s\n", filename);
+		free(text);
+		fclose(fp);
+		return NULL;
+	}
+
+	text[length] = 0;
+	*size = length;
+
+	fclose(fp);
+	return text;
+}
+
+/**
+ * Decodes the tiles in a tile set that was read into memory.
+ *
+ * @param[in,out] map The floor being prefetched.
+ */
+static void load_map_tiles(PrefetchedMap *map) {
+
+	FILE *fp;
+	char tile_filename[128];
+	int num_tiles, pos, collision;
+	int i;
+
+	if ((fp = fmemopen(map->tiles_text, map->tiles_size, "r")) == 0) {
+		return;
+	}
+
+	if (fscanf(fp, "%d", &num_tiles) != 1 || num_tiles <= 0) {
+		fclose(fp);
+		return;
+	}
+
+	if ((map->tiles = (SDL_Surface**)calloc(num_tiles, sizeof(SDL_Surface*))) == 0) {
+		fclose(fp);
+		return;
+	}
+
+	for(i = 0; i < num_tiles; i++) {
+
+		if (fscanf(fp, "%d %127s %d", &pos, tile_filename, &collision) != 3) {
+			break;
+		}
+
+		map->tiles[map->tile_count++] = load_image(tile_filename);
+	}
+
+	fclose(fp);
+}
+
+/**
+ * Reads in an animation for a prefetched floor and keeps a reference to it.
+ *
+ * @param[in,out] map      The floor being prefetched.
+ * @param[in]     filename The animation file.
+ */
+static void keep_map_animation(PrefetchedMap *map, const char *filename) {
+
+	const AnimationDefinition *definition;
+	const AnimationDefinition **animations;
+
+	if ((definition = get_animation_definition(filename)) == NULL) {
+		return;
+	}
+
+	if ((animations = (const AnimationDefinition**)realloc(map->animations, sizeof(AnimationDefinition*) * (map->animation_count + 1))) == NULL) {
+		release_animation_definition(definition);
+		return;
+	}
+
+	map->animations = animations;
+	map->animations[map->animation_count++] = definition;
+}
+
+/**
+ * Reads in every animation named in a map that was read into memory.
+ *
+ * Objects, objectives, powerups and chairs all name their animation file,
+ * so every word ending in .txt is read in as an animation.
+ *
+ * @param[in] map The floor being prefetched.
+ */
+static void load_map_animations(PrefetchedMap *map) {
+
+	FILE *fp;
+	char word[128];
+	size_t length;
+
+	if ((fp = fmemopen(map->map_text, map->map_size, "r")) == 0) {
+		return;
+	}
+
+	while (fscanf(fp, "%127s", word) == 1) {
+
+		length = strlen(word);
+
+		if (length > 4 && strcmp(word + length - 4, ".txt") == 0) {
+			keep_map_animation(map, word);
+		}
+	}
+
+	fclose(fp);
+}
+
+/**
+ * Reads in a floor for the loader thread.
+ *
+ * @param[in]  file_map   The map file of the floor.
+ * @param[in]  file_tiles The tile set file of the floor.
+ * @param[out] map        The floor. The text is NULL if it couldn't be read.
+ */
+static void load_map(const char *file_map, const char *file_tiles, PrefetchedMap *map) {
+
+	MapBinary binary;
+	int i;
+
+	memset(map, 0, sizeof(PrefetchedMap));
+
+	//map_init maps compiled maps itself, so only their atlas and animations are loaded.
+	if (open_binary_map(file_map, file_tiles, &binary) == 0) {
+
+		if ((map->tiles = (SDL_Surface**)malloc(sizeof(SDL_Surface*))) != 0) {
+			map->tiles[map->tile_count++] = load_image(binary.header->atlas);
+		}
+
+		for(i = 0; i < binary.header->entity_count; i++) {
+			if (binary.entities[i].animation[0] != 0) {
+				keep_map_animation(map, binary.entities[i].animation);
+			}
+		}
+
+		close_binary_map(&binary);
+		return;
+	}
+
+	if ((map->tiles_text = read_file(file_tiles, &map->tiles_size)) == NULL ||
+		(map->map_text = read_file(file_map, &map->map_size)) == NULL) {
+		free_prefetched_map(map);
+		return;
+	}
+
+	load_map_tiles(map);
+	load_map_animations(map);
+}
+
+/**
+ * Gets the slot that has been waiting the longest to be loaded.
+ *
+ * The loader must be locked.
+ *
+ * @return The slot, or NULL if nothing is queued.
+ */
+static MapSlot *next_queued_map() {
+
+	MapSlot *next = NULL;
+	int i;
+
+	for(i = 0; i < MAP_PREFETCH_SLOTS; i++) {
+		if (map_slots[i].state == MAP_SLOT_QUEUED && (next == NULL || map_slots[i].requested < next->requested)) {
+			next = &map_slots[i];
+		}
+	}
+
+	return next;
+}
+
+/**
+ * The loader thread. Reads in queued floors until cleanup_map_loader is called.
+ *
+ * @param[in] arg Unused.
+ *
+ * @return NULL.
+ */
+static void *map_loader_thread(void *arg) {
+
+	MapSlot *slot;
+	PrefetchedMap map;
+	char file_map[MAP_FILENAME_LENGTH];
+	char file_tiles[MAP_FILENAME_LENGTH];
+
+	pthread_mutex_lock(&map_loader_lock);
+
+	while (map_loader_running) {
+
+		if ((slot = next_queued_map()) == NULL) {
+			pthread_cond_wait(&map_loader_wake, &map_loader_lock);
+			continue;
+		}
+
+		slot->state = MAP_SLOT_LOADING;
+		strcpy(file_map, slot->file_map);
+		strcpy(file_tiles, slot->file_tiles);
+
+		pthread_mutex_unlock(&map_loader_lock);
+		load_map(file_map, file_tiles, &map);
+		pthread_mutex_lock(&map_loader_lock);
+
+		//the slot is emptied if the prefetch was cancelled while it was loading.
+		if (slot->state == MAP_SLOT_LOADING) {
+			slot->map = map;
+			slot->state = MAP_SLOT_READY;
+		}
+		else {
+			free_prefetched_map(&map);
+		}
+
+		pthread_cond_broadcast(&map_loader_done);
+	}
+
+	pthread_mutex_unlock(&map_loader_lock);
+
+	return NULL;
+}
+
+/**
+ * Starts the loader thread.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int init_map_loader() {
+
+	memset(map_slots, 0, sizeof(map_slots));
+	map_loader_running = true;
+
+	if (pthread_create(&map_loader, NULL, map_loader_thread, NULL) != 0) {
+		printf("Error creating the map loader thread\n");
+		map_loader_running = false;
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Stops the loader thread and frees every prefetched floor.
+ */
+void cleanup_map_loader() {
+
+	if (!map_loader_running)
+		return;
+
+	pthread_mutex_lock(&map_loader_lock);
+	map_loader_running = false;
+	pthread_cond_signal(&map_loader_wake);
+	pthread_mutex_unlock(&map_loader_lock);
+
+	pthread_join(map_loader, NULL);
+
+	clear_prefetched_maps();
+}
+
+/**
+ * Asks the loader thread to read in a floor.
+ *
+ * Does nothing if the floor is already prefetched. If every slot is taken, the
+ * oldest floor that isn't being loaded is replaced.
+ *
+ * @param[in] file_map   The map file of the floor.
+ * @param[in] file_tiles The tile set file of the floor.
+ */
+void prefetch_map(const char *file_map, const char *file_tiles) {
+
+	MapSlot *slot = NULL;
+	int i;
+
+	if (!map_loader_running || strlen(file_map) >= MAP_FILENAME_LENGTH || strlen(file_tiles) >= MAP_FILENAME_LENGTH)
+		return;
+
+	pthread_mutex_lock(&map_loader_lock);
+
+	for(i = 0; i < MAP_PREFETCH_SLOTS; i++) {
+
+		if (map_slots[i].state == MAP_SLOT_EMPTY) {
+			if (slot == NULL || slot->state != MAP_SLOT_EMPTY)
+				slot = &map_slots[i];
+			continue;
+		}
+
+		if (strcmp(map_slots[i].file_map, file_map) == 0 && strcmp(map_slots[i].file_tiles, file_tiles) == 0) {
+			map_slots[i].requested = map_requests++;
+			pthread_mutex_unlock(&map_loader_lock);
+			return;
+		}
+
+		if (map_slots[i].state != MAP_SLOT_LOADING && (slot == NULL || (slot->state != MAP_SLOT_EMPTY && map_slots[i].requested < slot->requested))) {
+			slot = &map_slots[i];
+		}
+	}
+
+	if (slot == NULL) {
+		pthread_mutex_unlock(&map_loader_lock);
+		return;
+	}
+
+	if (slot->state == MAP_SLOT_READY) {
+		free_prefetched_map(&slot->map);
+	}
+
+	strcpy(slot->file_map, file_map);
+	strcpy(slot->file_tiles, file_tiles);
+	slot->requested = map_requests++;
+	slot->state = MAP_SLOT_QUEUED;
+
+	pthread_cond_signal(&map_loader_wake);
+	pthread_mutex_unlock(&map_loader_lock);
+}
+
+/**
+ * Takes a floor from the loader thread, waiting for it if it is being read in.
+ *
+ * A floor that is still queued is dropped, since map_init can read it in
+ * sooner than waiting behind the other floors.
+ *
+ * @param[in]  file_map   The map file of the floor.
+ * @param[in]  file_tiles The tile set file of the floor.
+ * @param[out] prefetched The floor. Free it with free_prefetched_map.
+ *
+ * @return true if the floor was prefetched, false if map_init must read it in.
+ */
+bool take_prefetched_map(const char *file_map, const char *file_tiles, PrefetchedMap *prefetched) {
+
+	MapSlot *slot = NULL;
+	int i;
+
+	pthread_mutex_lock(&map_loader_lock);
+
+	for(i = 0; i < MAP_PREFETCH_SLOTS; i++) {
+		if (map_slots[i].state != MAP_SLOT_EMPTY &&
+			strcmp(map_slots[i].file_map, file_map) == 0 && strcmp(map_slots[i].file_tiles, file_tiles) == 0) {
+			slot = &map_slots[i];
+			break;
+		}
+	}
+
+	if (slot == NULL) {
+		pthread_mutex_unlock(&map_loader_lock);
+		return false;
+	}
+
+	while (slot->state == MAP_SLOT_LOADING) {
+		pthread_cond_wait(&map_loader_done, &map_loader_lock);
+	}
+
+	if (slot->state != MAP_SLOT_READY || slot->map.map_text == NULL) {
+		if (slot->state == MAP_SLOT_READY)
+			free_prefetched_map(&slot->map);
+		slot->state = MAP_SLOT_EMPTY;
+		pthread_mutex_unlock(&map_loader_lock);
+		return false;
+	}
+
+	*prefetched = slot->map;
+	slot->state = MAP_SLOT_EMPTY;
+
+	pthread_mutex_unlock(&map_loader_lock);
+
+	return true;
+}
+
+/**
+ * Frees a prefetched floor and gives back its tiles and animations.
+ *
+ * @param[in,out] prefetched The floor to free.
+ */
+void free_prefetched_map(PrefetchedMap *prefetched) {
+
+	int i;
+
+	for(i = 0; i < prefetched->tile_count; i++) {
+		release_image(prefetched->tiles[i]);
+	}
+
+	for(i = 0; i < prefetched->animation_count; i++) {
+		release_animation_definition(prefetched->animations[i]);
+	}
+
+	free(prefetched->tiles);
+	free(prefetched->animations);
+	free(prefetched->map_text);
+	free(prefetched->tiles_text);
+
+	memset(prefetched, 0, sizeof(PrefetchedMap));
+}
+
+/**
+ * Frees every prefetched floor and cancels the ones still waiting.
+ *
+ * Used when leaving a game, so the tiles can be freed by release_unused_images.
+ */
+void clear_prefetched_maps() {
+
+	int i;
+
+	pthread_mutex_lock(&map_loader_lock);
+
+	for(i = 0; i < MAP_PREFETCH_SLOTS; i++) {
+
+		if (map_slots[i].state == MAP_SLOT_READY) {
+			free_prefetched_map(&map_slots[i].map);
+		}
+
+		map_slots[i].state = MAP_SLOT_EMPTY;
+	}
+
+	pthread_mutex_unlock(&map_loader_lock);
+}
@@ -0,0 +1,40 @@
+/** @ingroup Graphics */
+/** @{ */
+/** @file map_loader.h */
+/** @} */
+#ifndef GRAPHICS_MAP_LOADER_H
+#define GRAPHICS_MAP_LOADER_H
+
+#include <SDL2/SDL.h>
+#include <stddef.h>
+
+#define MAP_PREFETCH_SLOTS		4   /**< The most floors that can be prefetched at once. */
+#define MAP_FILENAME_LENGTH		128 /**< The longest map or tile set path that can be prefetched. */
+
+struct AnimationDefinition;
+
+/**
+ * A floor that the loader thread has read in ahead of time.
+ *
+ * @struct PrefetchedMap
+ */
+typedef struct {
+	char *map_text;       /**< The contents of the map file. */
+	size_t map_size;      /**< The length of the map file. */
+	char *tiles_text;     /**< The contents of the tile set file. */
+	size_t tiles_size;    /**< The length of the tile set file. */
+	SDL_Surface **tiles;  /**< References to the decoded tiles, so they stay cached until the floor is built. */
+	int tile_count;       /**< The number of tile references. */
+	const struct AnimationDefinition **animations; /**< References to the floor's animations, so they stay loaded until the floor is built. */
+	int animation_count;  /**< The number of animation references. */
+} PrefetchedMap;
+
+int init_map_loader();
+void cleanup_map_loader();
+
+void prefetch_map(const char *file_map, const char *file_tiles);
+bool take_prefetched_map(const char *file_map, const char *file_tiles, PrefetchedMap *prefetched);
+void free_prefetched_map(PrefetchedMap *prefetched);
+void clear_prefetched_maps();
+
+#endif
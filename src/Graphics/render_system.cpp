@@ -5,14 +5,18 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 #include <SDL2/SDL_ttf.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "../world.h"
 #include "components.h"
 #include "systems.h"
 #include "text.h"
+#include "renderer.h"
+#include "image_cache.h"
 #include "../Input/menu.h"
 
-static void render_opponent_players(World& world, SDL_Surface *surface, FowComponent *fow, SDL_Rect map_rect);
+static void render_opponent_players(World& world, FowComponent *fow, SDL_Rect map_rect);
 static int opponentPlayers[32];
 static int opponentPlayersCount = 0;
 extern int curlevel;
@@ -25,8 +29,8 @@ SDL_Surface *ibeam;
 /**
  * Render a player onto the map. 
  *
- * Player is added as a texture then painted onto the surface. Multiple players can
- * be added.
+ * Player is drawn through the renderer, so with textures on it is only copied
+ * to the window. Multiple players can be added.
  *
  * Revisions: 
  * <ol>
@@ -39,7 +43,7 @@ SDL_Surface *ibeam;
  * </ol>
  *
  * @param[in,out] world   A reference to the world structure containing entities to render.
- * @param[in,out] surface Surface player is being rendered to.
+ * @param[in,out] fow     The fog of war that hides the other team.
  *
  * @designer Jordan Marling
  * @designer Mat Siwoski
@@ -47,33 +51,29 @@ SDL_Surface *ibeam;
  * @author Mat Siwoski
  * @date Feb 14, 2024
  */
-void render_player_system(World& world, SDL_Surface* surface, FowComponent *fow) {
+void render_player_system(World& world, FowComponent *fow) {
 	
 	unsigned int entity;
 	RenderPlayerComponent 	*renderPlayer;
-	PositionComponent 	*position;
 	SDL_Rect playerRect;
-	
-	SDL_Rect clipRect;
+	float x, y;
 
 	opponentPlayersCount = 0;
 	memset(opponentPlayers, 0, sizeof(opponentPlayers));
 
 
-	for(entity = 0; entity < MAX_ENTITIES; entity++){
-		
-		if(IN_THIS_COMPONENT(world.mask[entity], COMPONENT_PLAYER | COMPONENT_CONTROLLABLE)) {
-			fow->teamNo = world.player[entity].teamNo;
-		}
+	EntityList *list = get_entity_list(&world, SYSTEM_MASK);
 
+	for(entity = first_entity(list); entity < MAX_ENTITIES; entity = next_entity(list, entity)){
 
-		if (IN_THIS_COMPONENT(world.mask[entity], SYSTEM_MASK) && !IN_THIS_COMPONENT(world.mask[entity], COMPONENT_MENU_ITEM)){
+		if (!IN_THIS_COMPONENT(world.mask[entity], COMPONENT_MENU_ITEM)){
 			
-			position = &(world.position[entity]);
 			renderPlayer = &(world.renderPlayer[entity]);
 			
-			playerRect.x = position->x + map_rect.x;
-			playerRect.y = position->y + map_rect.y;
+			get_draw_position(&world, entity, &x, &y);
+			
+			playerRect.x = x + map_rect.x;
+			playerRect.y = y + map_rect.y;
 			playerRect.w = renderPlayer->width;
 			playerRect.h = renderPlayer->height;
 			
@@ -84,24 +84,7 @@ void render_player_system(World& world, SDL_Surface* surface, FowComponent *fow)
 			
 			if(!IN_THIS_COMPONENT(world.mask[entity], COMPONENT_PLAYER))
 			{
-				clipRect.x = -playerRect.x;
-				clipRect.y = -playerRect.y;
-				clipRect.w = playerRect.w;
-				clipRect.h = playerRect.h;
-		
-				if (clipRect.x < 0)
-					clipRect.x = 0;
-		
-				if (clipRect.y < 0)
-					clipRect.y = 0;
-		
-				if (clipRect.h > HEIGHT - playerRect.y)
-					clipRect.h = HEIGHT - playerRect.y;
-		
-				if (clipRect.w > WIDTH - playerRect.x)
-					clipRect.w = WIDTH - playerRect.x;
-				
-				SDL_BlitScaled(renderPlayer->playerSurface, &clipRect, surface, &playerRect);
+				renderer_draw_clipped(renderPlayer->playerSurface, &playerRect);
 			}
 			
 			if(IN_THIS_COMPONENT(world.mask[entity], COMPONENT_PLAYER)) {
@@ -109,33 +92,7 @@ void render_player_system(World& world, SDL_Surface* surface, FowComponent *fow)
 
 				// only render players on my team
 				if ((fow->teamNo == world.player[entity].teamNo)) {	
-		
-					FowPlayerPosition fowp;
-		
-					fowp.world = &world;
-					fowp.pos   = position;
-					fowp.fow   = fow;		
-					fowp.isControllablePlayer = IN_THIS_COMPONENT(world.mask[entity], COMPONENT_CONTROLLABLE);
-					make_surrounding_tiles_visible(&fowp);
-
-					clipRect.x = -playerRect.x;
-					clipRect.y = -playerRect.y;
-					clipRect.w = playerRect.w;
-					clipRect.h = playerRect.h;
-		
-					if (clipRect.x < 0)
-						clipRect.x = 0;
-		
-					if (clipRect.y < 0)
-						clipRect.y = 0;
-		
-					if (clipRect.h > HEIGHT - playerRect.y)
-						clipRect.h = HEIGHT - playerRect.y;
-		
-					if (clipRect.w > WIDTH - playerRect.x)
-						clipRect.w = WIDTH - playerRect.x;
-			
-					SDL_BlitScaled(renderPlayer->playerSurface, &clipRect, surface, &playerRect);
+					renderer_draw_clipped(renderPlayer->playerSurface, &playerRect);
 				}
 
 				else {
@@ -145,11 +102,7 @@ void render_player_system(World& world, SDL_Surface* surface, FowComponent *fow)
 		}
 	}
 
-	render_opponent_players(world, surface, fow, map_rect);
-	
-	fow->tilesVisibleToControllablePlayerCount = 0;
-	for(int i = 0; i < NMAXTILESINLOS; i++)
-		memset(fow->tilesVisibleToControllablePlayer[i], 0, 2 * sizeof(int));
+	render_opponent_players(world, fow, map_rect);
 }
 
 
@@ -161,7 +114,6 @@ void render_player_system(World& world, SDL_Surface* surface, FowComponent *fow)
  *     None.
  *loading
  * @param world			The world struct
- * @param surface		The surface to blit to
  * @param map_rect		A struct containing the camera offset from the map's origin
  * @param fow   		A pointer to a FogComponent struct which contains a tile map and sound effects
  * @return void.
@@ -171,7 +123,7 @@ void render_player_system(World& world, SDL_Surface* surface, FowComponent *fow)
  *
  * @date April 3rd, 2014
  */
-void render_opponent_players(World& world, SDL_Surface *surface, FowComponent *fow, SDL_Rect map_rect) {
+void render_opponent_players(World& world, FowComponent *fow, SDL_Rect map_rect) {
 
 	for(int entity = 0; entity < opponentPlayersCount && entity < 32; entity++) {
 
@@ -179,10 +131,12 @@ void render_opponent_players(World& world, SDL_Surface *surface, FowComponent *f
 		RenderPlayerComponent *renderPlayer = &(world.renderPlayer[ opponentPlayers[entity] ]);
 
 		SDL_Rect playerRect;
-		SDL_Rect clipRect;
+		float x, y;
+
+		get_draw_position(&world, opponentPlayers[entity], &x, &y);
 
-		playerRect.x = position->x + map_rect.x - 20;
-		playerRect.y = position->y + map_rect.y - 20 ;
+		playerRect.x = x + map_rect.x - 20;
+		playerRect.y = y + map_rect.y - 20 ;
 		playerRect.w = renderPlayer->width;
 		playerRect.h = renderPlayer->height;
 
@@ -190,28 +144,11 @@ void render_opponent_players(World& world, SDL_Surface *surface, FowComponent *f
 		int yPos = position->y / TILE_HEIGHT;
 
 		//if(xPos >= 0 && yPos >= 0 && yPos < world.level[ position->level ].height && xPos < world.level[ position->level ].width)
-		if(fow -> tiles[yPos][xPos].visible[ position->level ] == 0)
+		if(get_fog_visibility(fow, position->level, xPos, yPos) == CLEAR_VIS)
 		{
 			// show enemy player
 	
-			clipRect.x = -playerRect.x;
-			clipRect.y = -playerRect.y;
-			clipRect.w = playerRect.w;
-			clipRect.h = playerRect.h;
-
-			if (clipRect.x < 0)
-				clipRect.x = 0;
-
-			if (clipRect.y < 0)
-				clipRect.y = 0;
-
-			if (clipRect.h > HEIGHT - playerRect.y)
-				clipRect.h = HEIGHT - playerRect.y;
-
-			if (clipRect.w > WIDTH - playerRect.x)
-				clipRect.w = WIDTH - playerRect.x;
-
-			SDL_BlitScaled(renderPlayer->playerSurface, &clipRect, surface, &playerRect);
+			renderer_draw_clipped(renderPlayer->playerSurface, &playerRect);
 
 			render_player_speech(fow, xPos, yPos);
 		}
@@ -221,68 +158,81 @@ void render_opponent_players(World& world, SDL_Surface *surface, FowComponent *f
 /**
  * Render the menu to the screen.
  *
+ * The text in a text field is only redrawn when it changes.
+ *
  * @param[in,out] world   A reference to the world structure containing entities to render.
- * @param[in,out] surface Surface player is being rendered to.
  *
  * @designer Jordan Marling
  *
  * @author Jordan Marling
  * @date March 12s, 2024
  */
-void render_menu_system(World *world, SDL_Surface *surface) {
+void render_menu_system(World *world) {
 	
 	unsigned int entity;
 	RenderPlayerComponent 	*renderPlayer;
 	PositionComponent 	*position;
 	TextFieldComponent *text;
 	SDL_Rect menu_rect;
+	EntityList *list = get_entity_list(world, SYSTEM_MASK | COMPONENT_MENU_ITEM);
 	
-	for(entity = 0; entity < MAX_ENTITIES; entity++){
+	for(entity = first_entity(list); entity < MAX_ENTITIES; entity = next_entity(list, entity)){
 		
-		if (IN_THIS_COMPONENT(world->mask[entity], SYSTEM_MASK | COMPONENT_MENU_ITEM)) {
-			
-			position = &(world->position[entity]);
-			renderPlayer = &(world->renderPlayer[entity]);
+		position = &(world->position[entity]);
+		renderPlayer = &(world->renderPlayer[entity]);
+		
+		
+		menu_rect.x = position->x;
+		menu_rect.y = position->y;
+		menu_rect.w = renderPlayer->width;
+		menu_rect.h = renderPlayer->height;
+		
+		if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_BUTTON)) {
 			
+			if (world->button[entity].hovered) {
+				menu_rect.x -= 5;
+				menu_rect.y -= 5;
+				menu_rect.w += 10;
+				menu_rect.h += 10;
+			}
+		}
+		
+		renderer_draw(renderPlayer->playerSurface, NULL, &menu_rect);
+		
+		
+	
+		//check if a textbox.
+		if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_TEXTFIELD)) {
 			
-			menu_rect.x = position->x;
-			menu_rect.y = position->y;
-			menu_rect.w = renderPlayer->width;
-			menu_rect.h = renderPlayer->height;
+			text = &(world->text[entity]);
 			
-			if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_BUTTON)) {
+			//only redraw the text when it has changed.
+			if (text->drawn_text == NULL || strcmp(text->drawn_text, text->text) != 0) {
 				
-				if (world->button[entity].hovered) {
-					menu_rect.x -= 5;
-					menu_rect.y -= 5;
-					menu_rect.w += 10;
-					menu_rect.h += 10;
-				}
+				renderer_free_surface(text->text_surface);
+				free(text->drawn_text);
+				
+				text->text_surface = draw_text(text->text, MENU_FONT);
+				text->drawn_text = (char*)calloc(strlen(text->text) + 1, sizeof(char));
+				strcpy(text->drawn_text, text->text);
 			}
 			
-			SDL_BlitScaled(renderPlayer->playerSurface, NULL, surface, &menu_rect);
+			menu_rect.x += 10;
+			menu_rect.y += 8;
 			
+			if (text->text_surface != NULL) {
+				menu_rect.w = text->text_surface->w;
+				menu_rect.h = text->text_surface->h;
+				renderer_draw(text->text_surface, NULL, &menu_rect);
+			}
 			
-		
-			//check if a textbox.
-			if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_TEXTFIELD)) {
-				
-				text = &(world->text[entity]);
-				
-				menu_rect.x += 10;
-				menu_rect.y += 8;
-				
-				//TODO: Store the text in a component instead of creating it every frame.
-				//Perhaps we should store it in the renderPlayer component and draw the
-				//textbox if it has a text field component?
-				SDL_BlitSurface(draw_text(text->text, MENU_FONT), NULL, surface, &menu_rect);
-				
-				if (text->focused) {
-					menu_rect.x += get_text_width(text->text, MENU_FONT) + 1;
-					SDL_BlitSurface(ibeam, NULL, surface, &menu_rect);
-				}
-			}	
-		}
+			if (text->focused && ibeam != NULL) {
+				menu_rect.x += get_text_width(text->text, MENU_FONT) + 1;
+				menu_rect.w = ibeam->w;
+				menu_rect.h = ibeam->h;
+				renderer_draw(ibeam, NULL, &menu_rect);
+			}
+		}	
 	}
 }
 
@@ -295,7 +245,7 @@ void render_menu_system(World *world, SDL_Surface *surface) {
  * @date March 7, 2024
  */
 void init_render_player_system() {
-	if ((ibeam = IMG_Load("assets/Graphics/screen/menu/ibeam.png")) == 0) {
+	if ((ibeam = load_image("assets/Graphics/screen/menu/ibeam.png")) == 0) {
 		printf("Error loading ibeam image.\n");
 	}
 }
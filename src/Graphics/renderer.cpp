@@ -0,0 +1,257 @@
+/** @ingroup Graphics */
+/** @{ */
+/**
+ * Draws images to the window.
+ *
+ * With TEXTURE_RENDERING on, every surface is uploaded to the GPU once, the first
+ * time it is drawn, and the texture is kept in the surface's userdata until the
+ * surface is freed with renderer_free_surface. Each frame is then only a list of
+ * SDL_RenderCopy calls.
+ *
+ * With TEXTURE_RENDERING off, everything is blitted onto one screen surface which
+ * is uploaded to the window every frame.
+ *
+ * @file renderer.cpp
+ */
+/** @} */
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+
+#include "renderer.h"
+
+SDL_Renderer *renderer = 0; /**< The renderer attached to the game window. */
+
+#if !TEXTURE_RENDERING
+static SDL_Surface *screen = 0; /**< The surface everything is blitted onto before being shown. */
+#endif
+
+/**
+ * Gets the texture for a surface, uploading the surface the first time it is drawn.
+ *
+ * @param[in,out] image The surface to get the texture of.
+ *
+ * @return The texture, or NULL if it couldn't be created.
+ */
+static SDL_Texture *get_texture(SDL_Surface *image) {
+
+	if (image->userdata == NULL) {
+
+		image->userdata = SDL_CreateTextureFromSurface(renderer, image);
+
+		if (image->userdata == NULL) {
+			printf("Error creating texture: %s\n", SDL_GetError());
+		}
+	}
+
+	return (SDL_Texture*)image->userdata;
+}
+
+/**
+ * Creates the renderer for the window and the screen surface if textures are off.
+ *
+ * @param[in] window The window to render to.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int init_renderer(SDL_Window *window) {
+
+	if ((renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED)) == NULL) {
+		printf("Error creating the renderer: %s\n", SDL_GetError());
+		return -1;
+	}
+	SDL_SetRenderDrawColor(renderer, 0x0, 0x0, 0x0, 0xff);
+
+	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
+	SDL_RenderSetLogicalSize(renderer, WIDTH, HEIGHT);
+
+	#if !TEXTURE_RENDERING
+	if ((screen = SDL_CreateRGBSurface(0, WIDTH, HEIGHT, 32, 0, 0, 0, 0)) == NULL) {
+		printf("Error creating the screen surface.\n");
+		return -1;
+	}
+	#endif
+
+	return 0;
+}
+
+/**
+ * Frees the renderer and the screen surface.
+ */
+void cleanup_renderer() {
+
+	#if !TEXTURE_RENDERING
+	if (screen != NULL) {
+		SDL_FreeSurface(screen);
+		screen = NULL;
+	}
+	#endif
+
+	if (renderer != NULL) {
+		SDL_DestroyRenderer(renderer);
+		renderer = NULL;
+	}
+}
+
+/**
+ * Clears the frame to black.
+ */
+void renderer_clear() {
+
+	#if TEXTURE_RENDERING
+	SDL_RenderClear(renderer);
+	#else
+	SDL_FillRect(screen, NULL, 0x000000);
+	#endif
+}
+
+/**
+ * Shows the frame in the window.
+ */
+void renderer_present() {
+
+	#if !TEXTURE_RENDERING
+	SDL_Texture *screen_texture = SDL_CreateTextureFromSurface(renderer, screen);
+
+	SDL_RenderClear(renderer);
+	SDL_RenderCopy(renderer, screen_texture, NULL, NULL);
+	SDL_DestroyTexture(screen_texture);
+	#endif
+
+	SDL_RenderPresent(renderer);
+}
+
+/**
+ * Draws part of an image, scaled to fill the destination rectangle.
+ *
+ * @param[in] image The image to draw.
+ * @param[in] src   The part of the image to draw, or NULL for all of it.
+ * @param[in] dst   Where to draw it on the screen.
+ */
+void renderer_draw(SDL_Surface *image, const SDL_Rect *src, SDL_Rect *dst) {
+
+	if (image == NULL)
+		return;
+
+	#if TEXTURE_RENDERING
+	SDL_RenderCopy(renderer, get_texture(image), src, dst);
+	#else
+	//don't scale when we don't have to, it is a lot slower.
+	if (src == NULL && dst->w == image->w && dst->h == image->h)
+		SDL_BlitSurface(image, NULL, screen, dst);
+	else
+		SDL_BlitScaled(image, src, screen, dst);
+	#endif
+}
+
+/**
+ * Draws a whole image that may be partly off of the screen.
+ *
+ * Blitting scaled surfaces with negative coordinates doesn't clip properly,
+ * so the surface path clips the source rectangle first. The renderer clips
+ * textures itself.
+ *
+ * @param[in] image The image to draw.
+ * @param[in] dst   Where to draw it on the screen.
+ *
+ * @designer Mat Siwoski
+ * @author Mat Siwoski
+ */
+void renderer_draw_clipped(SDL_Surface *image, SDL_Rect *dst) {
+
+	if (image == NULL)
+		return;
+
+	#if TEXTURE_RENDERING
+	SDL_RenderCopy(renderer, get_texture(image), NULL, dst);
+	#else
+	SDL_Rect clipRect;
+
+	clipRect.x = -dst->x;
+	clipRect.y = -dst->y;
+	clipRect.w = dst->w;
+	clipRect.h = dst->h;
+
+	if (clipRect.x < 0)
+		clipRect.x = 0;
+
+	if (clipRect.y < 0)
+		clipRect.y = 0;
+
+	if (clipRect.h > HEIGHT - dst->y)
+		clipRect.h = HEIGHT - dst->y;
+
+	if (clipRect.w > WIDTH - dst->x)
+		clipRect.w = WIDTH - dst->x;
+
+	SDL_BlitScaled(image, &clipRect, screen, dst);
+	#endif
+}
+
+/**
+ * Draws a whole image faded by an alpha value.
+ *
+ * @param[in] image The image to draw.
+ * @param[in] dst   Where to draw it on the screen.
+ * @param[in] alpha 0 is transparent and 255 is opaque.
+ */
+void renderer_draw_alpha(SDL_Surface *image, SDL_Rect *dst, Uint8 alpha) {
+
+	if (image == NULL)
+		return;
+
+	#if TEXTURE_RENDERING
+	SDL_Texture *texture = get_texture(image);
+
+	SDL_SetTextureAlphaMod(texture, alpha);
+	SDL_RenderCopy(renderer, texture, NULL, dst);
+	#else
+	SDL_SetSurfaceAlphaMod(image, alpha);
+	SDL_BlitScaled(image, NULL, screen, dst);
+	#endif
+}
+
+/**
+ * Copies pixels that were changed in a surface to its texture.
+ *
+ * Only works for surfaces in a format the renderer uses for textures, such as
+ * SDL_PIXELFORMAT_ARGB8888, since the pixels are copied without converting them.
+ *
+ * @param[in] image The surface that was changed.
+ * @param[in] rect  The part of the surface that changed, or NULL for all of it.
+ */
+void renderer_update(SDL_Surface *image, const SDL_Rect *rect) {
+
+	if (image == NULL || image->userdata == NULL)
+		return;
+
+	#if TEXTURE_RENDERING
+	Uint8 *pixels = (Uint8*)image->pixels;
+
+	if (rect != NULL)
+		pixels += rect->y * image->pitch + rect->x * image->format->BytesPerPixel;
+
+	SDL_UpdateTexture((SDL_Texture*)image->userdata, rect, pixels, image->pitch);
+	#endif
+}
+
+/**
+ * Frees a surface along with the texture that was made from it.
+ *
+ * Surfaces shared through the image cache have more than one reference. Those
+ * only lose a reference, and keep their texture until the last one is freed.
+ *
+ * @param[in] image The surface to free.
+ */
+void renderer_free_surface(SDL_Surface *image) {
+
+	if (image == NULL)
+		return;
+
+	if (image->refcount <= 1 && image->userdata != NULL) {
+		SDL_DestroyTexture((SDL_Texture*)image->userdata);
+		image->userdata = NULL;
+	}
+
+	SDL_FreeSurface(image);
+}
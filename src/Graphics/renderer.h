@@ -0,0 +1,23 @@
+/** @ingroup Graphics */
+/** @{ */
+/** @file renderer.h */
+/** @} */
+#ifndef GRAPHICS_RENDERER_H
+#define GRAPHICS_RENDERER_H
+
+#include <SDL2/SDL.h>
+#include "../world.h"
+
+int init_renderer(SDL_Window *window);
+void cleanup_renderer();
+
+void renderer_clear();
+void renderer_present();
+
+void renderer_draw(SDL_Surface *image, const SDL_Rect *src, SDL_Rect *dst);
+void renderer_draw_clipped(SDL_Surface *image, SDL_Rect *dst);
+void renderer_draw_alpha(SDL_Surface *image, SDL_Rect *dst, Uint8 alpha);
+void renderer_update(SDL_Surface *image, const SDL_Rect *rect);
+void renderer_free_surface(SDL_Surface *image);
+
+#endif
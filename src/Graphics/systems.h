@@ -8,15 +8,18 @@
 #include "../world.h"
 #include "map.h"
 
-void render_player_system(World& world, SDL_Surface* surface, FowComponent *fow);
-void render_menu_system(World *world, SDL_Surface *surface);
+void render_player_system(World& world, FowComponent *fow);
+void render_menu_system(World *world);
 void init_render_player_system();
 void animation_system(World *world);
 void cutscene_system(World *world);
 
+const AnimationDefinition *get_animation_definition(const char *filename);
+void release_animation_definition(const AnimationDefinition *definition);
 int load_animation(const char *filename, World *world, unsigned int entity);
 void play_animation(World *world, unsigned int entity, const char *animation_name);
 void cancel_animation(World *world, unsigned int entity);
+void cleanup_animations();
 
 unsigned int load_cutscene(const char *filename, World *world, int id);
 
@@ -17,37 +17,18 @@
 #include "../Network/Packets.h"
 #include "chat.h"
 #include "../Graphics/text.h"
+#include "../Graphics/image_cache.h"
+#include "../Graphics/renderer.h"
 #include "menu.h"
 
 chat_line chat_text[CHAT_LINES];
 int start_text = 0;
 int end_text = 0;
-SDL_Surface *chat_surface;
-
-/**
- * Initializes the chat surface that is drawn on.
- *
- *
- * @designer Jordan Marling
- * @author Jordan Marling
- *
- */
-void init_chat() {
-	//masking
-	Uint32 rmask, gmask, bmask, amask;
-
-    rmask = 0xff000000;
-    gmask = 0x00ff0000;
-    bmask = 0x0000ff00;
-    amask = 0x000000ff;
-	
-	chat_surface = SDL_CreateRGBSurface(0, CHAT_SURFACE_WIDTH, CHAT_SURFACE_HEIGHT, 32, rmask, gmask, bmask, amask);
-	
-}
 
 /**
  * Adds a line to the circular buffer of text to be drawn to the screen.
  *
+ * The line is drawn once here and the overwritten line's surface is freed.
  *
  * @param[in]		text The text that is drawn to the screen
  * @param[in] 		font_type The type of font that is drawn
@@ -66,6 +47,9 @@ void chat_add_line(const char *text, int font_type) {
 	chat_text[end_text].start_ticks = SDL_GetTicks();
 	chat_text[end_text].font_type = font_type;
 	
+	renderer_free_surface(chat_text[end_text].surface);
+	chat_text[end_text].surface = draw_text(chat_text[end_text].text, font_type);
+	
 	end_text++;
 	//if the last position is beyond the length, go to the beginning and append there next.
 	if (end_text >= CHAT_LINES) {
@@ -82,31 +66,22 @@ void chat_add_line(const char *text, int font_type) {
 }
 
 /**
- * Updates the surface with the text currently in the circular buffer.
- *
- *
+ * Renders the lines currently in the circular buffer, fading out the old ones.
  *
  * @designer Jordan Marling
  * @author Jordan Marling
  *
  */
-void chat_update() {
+void chat_render() {
 	
 	int i, index;
 	
 	Uint8 alpha;
 	float alpha_percentage;
 	
-	SDL_Surface *temp_text;
 	SDL_Rect text_rect;
 	
-	text_rect.x = 0;
-	text_rect.w = CHAT_SURFACE_WIDTH;
-	text_rect.h = CHAT_LINE_HEIGHT;
-	
-	//clear the text rectangle
-	SDL_FillRect(chat_surface, NULL, SDL_MapRGBA(chat_surface->format, 0, 0, 0, 0));
-	SDL_SetSurfaceBlendMode(chat_surface, SDL_BLENDMODE_BLEND);
+	text_rect.x = 40;
 	
 	//draw each of the lines
 	for(i = 0, index = start_text; i <= CHAT_LINES; i++, index++) {
@@ -119,7 +94,7 @@ void chat_update() {
 			break;
 		}
 		
-		if (strlen(chat_text[i].text) == 0) {
+		if (chat_text[index].surface == NULL) {
 			continue;
 		}
 		
@@ -135,64 +110,18 @@ void chat_update() {
 		alpha_percentage += 1;
 		alpha = (Uint8)(alpha_percentage * 255);
 		
-		temp_text = draw_text(chat_text[index].text, chat_text[index].font_type);
-		
-		SDL_PixelFormat* fmt = temp_text->format;
-		
-		//change the alpha value of the text for cool effect.
-		if (alpha < 255) {
-			
-			for(int y = 0; y < temp_text->h; y++) {
-				for(int x = 0; x < temp_text->w; x++) {
-					
-					Uint32* pixel_ptr = (Uint32 *)((Uint8 *)temp_text->pixels + y * temp_text->pitch + x * fmt->BytesPerPixel);
-
-					// Get the old pixel components.
-					Uint8 r, g, b, a;
-					SDL_GetRGBA( *pixel_ptr, fmt, &r, &g, &b, &a );
-					
-					if (alpha < a)
-						a = alpha;
-					
-					// Set the pixel with the new alpha.
-					*pixel_ptr = SDL_MapRGBA( fmt, r, g, b, a );
-					
-				}
-			}
-			
+		if (alpha == 0) {
+			continue;
 		}
 		
-		text_rect.y = i * (CHAT_LINE_HEIGHT + CHAT_LINE_GAP);
+		text_rect.y = (HEIGHT - CHAT_SURFACE_HEIGHT - 50) + i * (CHAT_LINE_HEIGHT + CHAT_LINE_GAP);
+		text_rect.w = chat_text[index].surface->w;
+		text_rect.h = chat_text[index].surface->h;
 		
-		SDL_BlitSurface(temp_text, NULL, chat_surface, &text_rect);
-		SDL_FreeSurface(temp_text);
+		renderer_draw_alpha(chat_text[index].surface, &text_rect, alpha);
 	}
 }
 
-/**
- * Renders the chat to the main surface.
- *
- * @param[in, out]	surface The surface to draw the text to.
- *
- * @designer Jordan Marling
- * @author Jordan Marling
- *
- */
-void chat_render(SDL_Surface *surface) {
-	
-	SDL_Rect rect;
-	
-	rect.x = 40;
-	rect.y = (HEIGHT - CHAT_SURFACE_HEIGHT - 50);
-	rect.w = CHAT_SURFACE_WIDTH;
-	rect.h = CHAT_SURFACE_HEIGHT;
-	
-	chat_update();
-	//SDL_FillRect(surface, NULL, 0xff0000);
-	//SDL_SetSurfaceAlphaMod(chat_surface, 255);
-	SDL_BlitSurface(chat_surface, NULL, surface, &rect);
-	
-}
 /**
  * Creates the text field for the user to type text into the chat.
  *
@@ -207,7 +136,7 @@ unsigned int create_chat(World *world) {
 	
 	unsigned int entity = create_entity(world, COMPONENT_MENU_ITEM | COMPONENT_RENDER_PLAYER | COMPONENT_POSITION | COMPONENT_TEXTFIELD | COMPONENT_MOUSE);
 	
-	world->renderPlayer[entity].playerSurface = IMG_Load("assets/Graphics/screen/menu/text_field.png");
+	world->renderPlayer[entity].playerSurface = load_image("assets/Graphics/screen/menu/text_field.png");
 	
 	world->renderPlayer[entity].width = CHAT_SURFACE_WIDTH;
 	world->renderPlayer[entity].height = SMALL_TEXT_HEIGHT;
@@ -231,6 +160,8 @@ unsigned int create_chat(World *world) {
 
 	world->text[entity].focused = true;
 	world->text[entity].number = false;
+	world->text[entity].text_surface = NULL;
+	world->text[entity].drawn_text = NULL;
 
 	world->text[entity].max_length = MAX_MESSAGE + MAX_NAME + 3;//stuff
 	
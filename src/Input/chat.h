@@ -28,12 +28,11 @@ typedef struct {
 	char text[MAX_MESSAGE + MAX_NAME + 3];
 	unsigned int start_ticks;
 	int font_type;
+	SDL_Surface *surface;
 } chat_line;
 
-void init_chat();
 void chat_add_line(const char *text, int font_type);
-void chat_update();
-void chat_render(SDL_Surface *surface);
+void chat_render();
 unsigned int create_chat(World *world);
 
 #endif
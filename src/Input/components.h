@@ -38,6 +38,8 @@ typedef struct  {
 	int length;    /**< The current length of the text. */
 	int max_length;/**< The maximum length of the field. */
 	bool number;   /**< Whether the max number of characters has been exceeded. */
+	SDL_Surface *text_surface; /**< The last text that was drawn, so it isn't redrawn every frame. */
+	char *drawn_text;          /**< The text that text_surface was drawn from. */
 	
 } TextFieldComponent;
 
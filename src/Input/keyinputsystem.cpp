@@ -59,7 +59,8 @@ extern int window_width, window_height;
  */
 void KeyInputSystem(World *world)
 {
-    int entity;
+    unsigned int entity;
+    EntityList *list = get_entity_list(world, SYSTEM_MASK);
     CommandComponent *command;
 
     SDL_Event event;
@@ -128,27 +129,21 @@ void KeyInputSystem(World *world)
 		}
     }
 	
-    for(entity = 0; entity < MAX_ENTITIES; entity++) {
+    for(entity = first_entity(list); entity < MAX_ENTITIES; entity = next_entity(list, entity)) {
 
-        if ((world->mask[entity] & SYSTEM_MASK) == SYSTEM_MASK)
-        {
-            command = &(world->command[entity]);
+        command = &(world->command[entity]);
 
-            command->commands[C_UP] = (currentKeyboardState[command_keys[C_UP]] != 0);
-            command->commands[C_LEFT] = (currentKeyboardState[command_keys[C_LEFT]] != 0);
-            command->commands[C_DOWN] = (currentKeyboardState[command_keys[C_DOWN]] != 0);
-            command->commands[C_RIGHT] = (currentKeyboardState[command_keys[C_RIGHT]] != 0);
-			command->commands[C_ACTION] = (currentKeyboardState[command_keys[C_ACTION]] != 0) && (prevKeyboardState[command_keys[C_ACTION]] == 0);
-			command->commands[C_TILE] = (currentKeyboardState[command_keys[C_TILE]] != 0) && (prevKeyboardState[command_keys[C_TILE]] == 0);
-
-        }
+        command->commands[C_UP] = (currentKeyboardState[command_keys[C_UP]] != 0);
+        command->commands[C_LEFT] = (currentKeyboardState[command_keys[C_LEFT]] != 0);
+        command->commands[C_DOWN] = (currentKeyboardState[command_keys[C_DOWN]] != 0);
+        command->commands[C_RIGHT] = (currentKeyboardState[command_keys[C_RIGHT]] != 0);
+		command->commands[C_ACTION] = (currentKeyboardState[command_keys[C_ACTION]] != 0) && (prevKeyboardState[command_keys[C_ACTION]] == 0);
+		command->commands[C_TILE] = (currentKeyboardState[command_keys[C_TILE]] != 0) && (prevKeyboardState[command_keys[C_TILE]] == 0);
     }
     
     if (player_entity < MAX_ENTITIES) {		//pause menu
 		if ((currentKeyboardState[SDL_SCANCODE_ESCAPE] != 0) && (prevKeyboardState[SDL_SCANCODE_ESCAPE] == 0)) {
-			if (IN_THIS_COMPONENT(world->mask[player_entity], COMPONENT_COMMAND)) {
-				world->mask[player_entity] ^= COMPONENT_COMMAND;
-			}
+			disable_component(world, player_entity, COMPONENT_COMMAND);
 			create_pause_screen(world);
 		}
 		
@@ -171,11 +166,12 @@ void KeyInputSystem(World *world)
 				}
 				destroy_menu(world);
 				textField = -1;
+				enable_component(world, player_entity, COMPONENT_COMMAND);
 			}
 			else {
 				textField = create_chat(world);
+				disable_component(world, player_entity, COMPONENT_COMMAND);
 			}
-			world->mask[player_entity] ^= COMPONENT_COMMAND;
 		}
 	}
     
@@ -13,6 +13,7 @@
 #include <SDL2/SDL_scancode.h>
 
 #include "../Graphics/text.h"
+#include "../Graphics/image_cache.h"
 #include "menu.h"
 #include "../world.h"
 #include "../components.h"
@@ -20,12 +21,15 @@
 #include "../sound.h"
 #include "../Network/network_systems.h"
 
-unsigned int background = MAX_ENTITIES + 1;
+unsigned int background = MAX_ENTITIES; //a handle to the background, it is kept while moving between menus.
 unsigned int background_music = -1;
 
 /**
  * Destroys every entity in the world except for the background of the menu.
  *
+ * Entities are destroyed from the highest down so the next menu's buttons are
+ * created in order after the background.
+ *
  * @param world The world struct
  *
  * @designer Jordan Marling
@@ -35,10 +39,11 @@ unsigned int background_music = -1;
  */
 void destroy_menu(World *world) {
 	unsigned int entity;
+	unsigned int background_entity = get_handle_entity(world, background);
 	
-	for(entity = 0; entity < MAX_ENTITIES; entity++) {
+	for(entity = world->entity_end; entity-- > 0;) {
 		
-		if (entity != background && IN_THIS_COMPONENT(world->mask[entity], COMPONENT_MENU_ITEM)) {
+		if (entity != background_entity && IN_THIS_COMPONENT(world->mask[entity], COMPONENT_MENU_ITEM)) {
 			destroy_entity(world, entity);
 		}
 		
@@ -153,7 +158,7 @@ void create_textfield(World *world, const char *name, int x, int y, const char*
 	unsigned int entity = create_entity(world, COMPONENT_MENU_ITEM | COMPONENT_RENDER_PLAYER | COMPONENT_POSITION | COMPONENT_TEXTFIELD | COMPONENT_MOUSE);
 	
 	if(big) {
-		world->renderPlayer[entity].playerSurface = IMG_Load("assets/Graphics/screen/menu/text_field.png");
+		world->renderPlayer[entity].playerSurface = load_image("assets/Graphics/screen/menu/text_field.png");
 		
 		world->renderPlayer[entity].width = BIG_TEXT_WIDTH;
 		world->renderPlayer[entity].height = BIG_TEXT_HEIGHT;
@@ -162,7 +167,7 @@ void create_textfield(World *world, const char *name, int x, int y, const char*
 		world->text[entity].max_length = MAX_STRING;
 		
 	} else {
-		world->renderPlayer[entity].playerSurface = IMG_Load("assets/Graphics/screen/menu/small_text_field.png");
+		world->renderPlayer[entity].playerSurface = load_image("assets/Graphics/screen/menu/small_text_field.png");
 		
 		world->renderPlayer[entity].width = SMALL_TEXT_WIDTH;
 		world->renderPlayer[entity].height = SMALL_TEXT_HEIGHT;
@@ -195,6 +200,8 @@ void create_textfield(World *world, const char *name, int x, int y, const char*
 
 	world->text[entity].focused = false;
 	world->text[entity].number = false;
+	world->text[entity].text_surface = NULL;
+	world->text[entity].drawn_text = NULL;
 	
 }
 
@@ -235,23 +242,26 @@ void create_animated_button(World *world, const char* fileName, int x, int y, co
  */
 void create_main_menu_background(World *world) {
 	
-	if (background < MAX_ENTITIES) {
-		world->animation[background].animations[world->animation[background].rand_animation].sound_enabled = true;
+	unsigned int entity = get_handle_entity(world, background);
+	
+	if (entity < MAX_ENTITIES) {
+		world->animation[entity].sound_enabled = true;
 		play_music(background_music);
 		return;
 	}
 	
-	background = create_entity(world, COMPONENT_MENU_ITEM | COMPONENT_RENDER_PLAYER | COMPONENT_POSITION | COMPONENT_ANIMATION);
+	entity = create_entity(world, COMPONENT_MENU_ITEM | COMPONENT_RENDER_PLAYER | COMPONENT_POSITION | COMPONENT_ANIMATION);
+	background = get_entity_handle(world, entity);
 	
-	world->position[background].x = 0;
-	world->position[background].y = 0;
-	world->position[background].width = WIDTH;
-	world->position[background].height = HEIGHT;
+	world->position[entity].x = 0;
+	world->position[entity].y = 0;
+	world->position[entity].width = WIDTH;
+	world->position[entity].height = HEIGHT;
 	
-	load_animation("assets/Graphics/screen/menu/mainmenu_animation.txt", world, background);
+	load_animation("assets/Graphics/screen/menu/mainmenu_animation.txt", world, entity);
 	
-	world->renderPlayer[background].width = WIDTH;
-	world->renderPlayer[background].height = HEIGHT;
+	world->renderPlayer[entity].width = WIDTH;
+	world->renderPlayer[entity].height = HEIGHT;
 	
 	//Load and play music
 	background_music = load_music("assets/Sound/menu/sound_menu_bg.wav");
@@ -259,8 +269,10 @@ void create_main_menu_background(World *world) {
 }
 
 void disable_background_sound(World *world) {
-	if (background < MAX_ENTITIES) {
-		world->animation[background].animations[world->animation[background].rand_animation].sound_enabled = false;
+	unsigned int entity = get_handle_entity(world, background);
+	
+	if (entity < MAX_ENTITIES) {
+		world->animation[entity].sound_enabled = false;
 	}
 }
 
@@ -286,7 +298,7 @@ void create_logo_screen(World* world) {
 	world->position[entity].width = WIDTH;
 	world->position[entity].height = HEIGHT;
 	
-	world->renderPlayer[entity].playerSurface = IMG_Load("assets/Graphics/screen/logo/load.png");
+	world->renderPlayer[entity].playerSurface = load_image("assets/Graphics/screen/logo/load.png");
 	if (world->renderPlayer[entity].playerSurface == 0) {
 		printf("Error loading logo background\n");
 	}
@@ -446,7 +458,7 @@ void create_credits_menu(World *world) {
 	
 	world->renderPlayer[entity].width = WIDTH;
 	world->renderPlayer[entity].height = HEIGHT;
-	world->renderPlayer[entity].playerSurface = IMG_Load("assets/Graphics/screen/menu/credits.png");
+	world->renderPlayer[entity].playerSurface = load_image("assets/Graphics/screen/menu/credits.png");
 	if (!world->renderPlayer[entity].playerSurface) {
 		printf("Error loading credits menu\n");
 	}
@@ -509,7 +521,7 @@ void create_bsod_menu(World *world) {
 	
 	world->renderPlayer[entity].width = WIDTH;
 	world->renderPlayer[entity].height = HEIGHT;
-	world->renderPlayer[entity].playerSurface = IMG_Load("assets/Graphics/end/blue_screen.png");
+	world->renderPlayer[entity].playerSurface = load_image("assets/Graphics/end/blue_screen.png");
 	if (!world->renderPlayer[entity].playerSurface) {
 		printf("Error loading BSOD image.\n");
 	}
@@ -600,7 +612,7 @@ void create_select_screen(World *world) {
 	world->position[entity].y = 0;
 	world->position[entity].width = WIDTH;
 	world->position[entity].height = HEIGHT;
-	if ((world->renderPlayer[entity].playerSurface = IMG_Load("assets/Graphics/screen/menu/select/select.png")) == NULL){
+	if ((world->renderPlayer[entity].playerSurface = load_image("assets/Graphics/screen/menu/select/select.png")) == NULL){
 		printf("Unable to find select image\n");
 	}
 
@@ -657,7 +669,7 @@ void create_pause_screen(World *world) {
 	world->position[entity].width = w;
 	world->position[entity].height = h;
 	
-	if ((world->renderPlayer[entity].playerSurface = IMG_Load("assets/Graphics/screen/pause/background.png")) == NULL){
+	if ((world->renderPlayer[entity].playerSurface = load_image("assets/Graphics/screen/pause/background.png")) == NULL){
 		printf("Unable to load pause image\n");
 	}
 	
@@ -699,7 +711,7 @@ void create_van_intro(World *world, int character) {
 	world->position[entity].width = w;
 	world->position[entity].height = h;
 	
-	if ((world->renderPlayer[entity].playerSurface = IMG_Load("assets/Graphics/cutscene/van_intro/background_enter.png")) == NULL){
+	if ((world->renderPlayer[entity].playerSurface = load_image("assets/Graphics/cutscene/van_intro/background_enter.png")) == NULL){
 		printf("Unable to load van background image\n");
 	}
 	
@@ -35,7 +35,8 @@ extern int window_width, window_height;
  */
 void MouseInputSystem(World *world)
 {
-    int entity, e, x, y;
+    unsigned int entity, e;
+    int x, y;
     static Uint32 previousState = 0;
     static Uint32 currentState = 0;
     bool rclick, lclick, text_field_pressed = false;
@@ -44,6 +45,9 @@ void MouseInputSystem(World *world)
     ButtonComponent *button;
     PositionComponent *position;
     AnimationComponent *animation;
+    EntityList *list = get_entity_list(world, SYSTEM_MASK);
+    EntityList *text_fields = get_entity_list(world, COMPONENT_TEXTFIELD);
+    EntityList *animations = get_entity_list(world, ANIMATION_MASK);
 
     previousState = currentState;
     currentState = SDL_GetMouseState(&x, &y);
@@ -62,96 +66,87 @@ void MouseInputSystem(World *world)
         textField = -1;
     }
 
-    for(entity = 0; entity < MAX_ENTITIES; entity++)
+    for(entity = first_entity(list); entity < MAX_ENTITIES; entity = next_entity(list, entity))
     {
+        mouse = &(world->mouse[entity]);
 
-        if ((world->mask[entity] & SYSTEM_MASK) == SYSTEM_MASK)
-        {
-            mouse = &(world->mouse[entity]);
+        mouse->x = x;
+        mouse->y = y;
+        mouse->leftClick = lclick;
+        mouse->rightClick = rclick;
 
-            mouse->x = x;
-            mouse->y = y;
-            mouse->leftClick = lclick;
-            mouse->rightClick = rclick;
+		//does the entity have a text field?
+		if ((world->mask[entity] & COMPONENT_TEXTFIELD) == COMPONENT_TEXTFIELD) {
 
-			//does the entity have a text field?
-			if ((world->mask[entity] & COMPONENT_TEXTFIELD) == COMPONENT_TEXTFIELD) {
-
-				text = &(world->text[entity]);
-				position = &(world->position[entity]);
+			text = &(world->text[entity]);
+			position = &(world->position[entity]);
 
-				if (position->x < x &&
-					position->y < y &&
-					position->x + position->width > x &&
-					position->y + position->height > y &&
-					lclick) {
+			if (position->x < x &&
+				position->y < y &&
+				position->x + position->width > x &&
+				position->y + position->height > y &&
+				lclick) {
 
-					text->focused = true;
-					textField = entity;
-					
-					text_field_pressed = true;
+				text->focused = true;
+				textField = entity;
+				
+				text_field_pressed = true;
+				
+				for(e = first_entity(text_fields); e < MAX_ENTITIES; e = next_entity(text_fields, e)) {
 					
-					for(e = 0; e < MAX_ENTITIES; e++) {
-						
-						if (e != entity &&
-							(world->mask[e] & COMPONENT_TEXTFIELD) == COMPONENT_TEXTFIELD) {
-							world->text[e].focused = false;
-						}
-						
+					if (e != entity) {
+						world->text[e].focused = false;
 					}
+					
 				}
-
 			}
 
-			if ((world->mask[entity] & COMPONENT_BUTTON) == COMPONENT_BUTTON) {
+		}
 
-				button = &(world->button[entity]);
-				position = &(world->position[entity]);
+		if ((world->mask[entity] & COMPONENT_BUTTON) == COMPONENT_BUTTON) {
 
-				button->prevState = button->currentState;
+			button = &(world->button[entity]);
+			position = &(world->position[entity]);
 
-				
-				button->hovered =  position->x < mouse->x &&
-									position->y < mouse->y &&
-									position->x + position->width > mouse->x &&
-									position->y + position->height > mouse->y;
-				
-				button->currentState = button->hovered && lclick;
-				
-				if (button->currentState == true &&
-					button->prevState == false) {
-					
-					if (menu_click(world, entity)) {
-						break;
-					}
-					
-				}
-				
-			}
+			button->prevState = button->currentState;
 
-        }
-		
-		//trigger animations on hover
-		if ((world->mask[entity] & ANIMATION_MASK) == ANIMATION_MASK) {
 			
-			position = &(world->position[entity]);
-			animation = &(world->animation[entity]);
+			button->hovered =  position->x < mouse->x &&
+								position->y < mouse->y &&
+								position->x + position->width > mouse->x &&
+								position->y + position->height > mouse->y;
+			
+			button->currentState = button->hovered && lclick;
 			
-			if (animation->hover_animation > -1 && animation->current_animation == -1) {
+			if (button->currentState == true &&
+				button->prevState == false) {
 				
-				if (position->x < x && position->y < y &&
-					position->x + position->width > x &&
-					position->y + position->height > y) {
-					
-					
-					animation->current_animation = animation->hover_animation;
-					
+				if (menu_click(world, entity)) {
+					break;
 				}
+				
 			}
 			
-			
 		}
+    }
+	
+	//trigger animations on hover
+	for(entity = first_entity(animations); entity < MAX_ENTITIES; entity = next_entity(animations, entity)) {
+		
+		position = &(world->position[entity]);
+		animation = &(world->animation[entity]);
 		
+		if (animation->definition->hover_animation > -1 && animation->current_animation == -1) {
+			
+			if (position->x < x && position->y < y &&
+				position->x + position->width > x &&
+				position->y + position->height > y) {
+				
+				
+				animation->current_animation = animation->definition->hover_animation;
+				
+			}
+		}
     }
     
     if (lclick &&
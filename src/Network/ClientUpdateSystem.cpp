@@ -15,6 +15,7 @@
 #include "../world.h"
 #include "../systems.h"
 #include "../Gameplay/collision.h"
+#include "../Gameplay/prediction.h"
 #include "network_systems.h"
 #include "../Input/chat.h"
 
@@ -125,7 +126,8 @@ int client_update_system(World *world, int net_pipe) {
  *
  * The function will ignore players that aren't on the current floor and the client's
  * own player, since they're said to be authoritative over their own position (except
- * for their floor).
+ * for their floor). With SERVER_AUTHORITATIVE on, the client's own player is corrected
+ * with the server's position instead.
  *
  * @param[in, out]	world 	The world struct holding the data to be updated.
  * @param[in] 		packet	The packet containing update information.
@@ -175,13 +177,14 @@ void client_update_floor(World *world, void *packet)
 	world->position[player_entity].level	= floor_move->new_floor;
 	world->position[player_entity].x		= floor_move->xPos;
 	world->position[player_entity].y		= floor_move->yPos;
+	reset_prediction(); // the inputs so far led somewhere else
 	rebuild_floor(world, floor_move->new_floor);
 	if(floor_move->new_floor == 0)
 	{
 		reset_fog_of_war(fow);
 	}
 
-	for(i = 0; i < MAX_ENTITIES; i++)
+	for(i = 0; i < (int)world->entity_end; i++)
 	{
 		if(IN_THIS_COMPONENT(world->mask[i], COMPONENT_OBJECTIVE))
 		{
@@ -195,12 +198,52 @@ void client_update_floor(World *world, void *packet)
 	floor_change_flag = 0;
 }
 
+/**
+ * Moves a remote player towards where the server says it is.
+ *
+ * The player isn't moved straight there: the movement system keeps moving it on its
+ * velocity, and makes up the difference a little every tick so it doesn't jump.
+ * Players that are too far away, just arrived or changed floors are moved straight there.
+ *
+ * @param[in, out]	world 	The world struct.
+ * @param[in]		entity	The remote player.
+ * @param[in]		x		The x position from the server.
+ * @param[in]		y		The y position from the server.
+ * @param[in]		floor	The floor from the server.
+ * @param[in]		snap	Whether to move the player straight there.
+ */
+static void correct_remote_player(World *world, unsigned int entity, float x, float y, int floor, bool snap)
+{
+	PositionComponent *position = &world->position[entity];
+	RemoteCorrection *remote = &world->remote[entity];
+	float error_x = x - position->x;
+	float error_y = y - position->y;
+
+	remote->ticks = 0;
+
+	if (snap || position->level != floor || error_x * error_x + error_y * error_y > REMOTE_SNAP_DISTANCE * REMOTE_SNAP_DISTANCE)
+	{
+		position->x = x;
+		position->y = y;
+		position->level = floor;
+		remote->x = 0;
+		remote->y = 0;
+		world->previous[entity].level = -1;
+		return;
+	}
+
+	remote->x = error_x;
+	remote->y = error_y;
+}
+
 /**
  * Updates the positions and movement properties of every other player.
  *
  * The function will ignore players that aren't on the current floor and the client's
  * own player, since they're said to be authoritative over their own position (except
- * for their floor).
+ * for their floor). With SERVER_AUTHORITATIVE on, the client's own player is corrected
+ * with the server's position instead. Between updates the other players keep moving on the velocity
+ * they were last sent.
  *
  * @param[in, out]	world 	The world struct holding the data to be updated.
  * @param[in] 		packet	The packet containing update information.
@@ -221,16 +264,27 @@ void client_update_pos(World *world, void *packet)
 		for (unsigned int i = 0; i < MAX_PLAYERS; i++)
 		{
 	        if(i == world->player[player_entity].playerNo)
+	        {
+#if SERVER_AUTHORITATIVE
+				if(pos_update->players_on_floor[i])
+				{
+					reconcile_player(world, player_entity, pos_update->ack[i], pos_update->xPos[i], pos_update->yPos[i],
+						pos_update->xVel[i], pos_update->yVel[i], pos_update->floor);
+				}
+#endif
 				continue;
+	        }
 			
 			if(player_table[i] != UNASSIGNED)
 			{
 				if(!pos_update->players_on_floor[i])
 				{
-					world->mask[player_table[i]] &= ~(COMPONENT_RENDER_PLAYER | COMPONENT_COLLISION); // If the player is no longer on the floor, turn off render and collision
+					disable_component(world, player_table[i], COMPONENT_RENDER_PLAYER | COMPONENT_COLLISION); // If the player is no longer on the floor, turn off render and collision
 				 	continue;
 				}
-				world->mask[player_table[i]] |= COMPONENT_RENDER_PLAYER | COMPONENT_COLLISION;
+				//a player that just arrived on the floor has nowhere to be corrected from.
+				bool arrived = !IN_THIS_COMPONENT(world->mask[player_table[i]], COMPONENT_COLLISION);
+				enable_component(world, player_table[i], COMPONENT_RENDER_PLAYER | COMPONENT_COLLISION);
 				world->movement[player_table[i]].movX	= pos_update->xVel[i];
 				world->movement[player_table[i]].movY 	= pos_update->yVel[i];
 				
@@ -246,9 +300,7 @@ void client_update_pos(World *world, void *packet)
 					world->movement[player_table[i]].lastDirection = DIRECTION_UP;
 				}
 				
-				world->position[player_table[i]].x		= pos_update->xPos[i];
-				world->position[player_table[i]].y		= pos_update->yPos[i];
-				world->position[player_table[i]].level	= pos_update->floor;
+				correct_remote_player(world, player_table[i], pos_update->xPos[i], pos_update->yPos[i], pos_update->floor, arrived);
 			}
 		}
 	}
@@ -562,7 +614,7 @@ int client_update_info(World *world, void *packet)
 	if(client_info->connect_code == CONNECT_CODE_DENIED)
 		return CONNECT_CODE_DENIED;
 
-	for (int i = 0; i < MAX_ENTITIES; i++)
+	for (unsigned int i = 0; i < world->entity_end; i++)
 	{
 		if (IN_THIS_COMPONENT(world->mask[i], COMPONENT_MOVEMENT | COMPONENT_POSITION | COMPONENT_PLAYER | COMPONENT_CONTROLLABLE))
 		{
@@ -620,6 +672,6 @@ void update_special_tile(World *world, void * packet)
 
 	if(pkt->floor != (unsigned int) world->position[player_entity].level)
 	{
-		world->mask[tile] &= ~(COMPONENT_RENDER_PLAYER | COMPONENT_COLLISION);
+		disable_component(world, tile, COMPONENT_RENDER_PLAYER | COMPONENT_COLLISION);
 	}
 }
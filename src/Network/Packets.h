@@ -30,6 +30,13 @@
 #define MAX_OBJECTIVES       32
 #define OBJECTIVES_PER_FLOOR 4
 
+// Protocol options
+// 0 trusts the player's own position. 1 sends the player's inputs with their sequence numbers,
+// and the server sends back the last one it ran, so the client can correct its own player.
+// It changes the position packets, so it has to be the same on the server.
+#define SERVER_AUTHORITATIVE 0
+#define POS_UPDATE_INPUTS    8 // inputs resent with each position update, in case updates are lost
+
 // Connect code Definitions
 #define CONNECT_CODE_ACCEPTED 0x001
 #define CONNECT_CODE_DENIED   0x000
@@ -151,6 +158,7 @@ typedef uint32_t character_t;
 typedef uint32_t pos_t;
 typedef uint32_t tile_t;
 typedef float	 vel_t;
+typedef uint16_t seq_t;	/**< An input sequence number, which wraps around. */
 
 // Packet Definitions
 
@@ -212,6 +220,10 @@ typedef struct pkt10{
 	pos_t		yPos;
 	vel_t		xVel;
 	vel_t		yVel;
+#if SERVER_AUTHORITATIVE
+	seq_t		seq;	/* the last input the position is the result of */
+	uint8_t		inputs[POS_UPDATE_INPUTS];	/* the commands of the inputs up to seq, oldest first, one bit per command */
+#endif
 } PKT_POS_UPDATE;
 
 typedef struct pkt11{
@@ -221,6 +233,9 @@ typedef struct pkt11{
 	pos_t		yPos[MAX_PLAYERS];
 	vel_t		xVel[MAX_PLAYERS];
 	vel_t		yVel[MAX_PLAYERS];
+#if SERVER_AUTHORITATIVE
+	seq_t		ack[MAX_PLAYERS];	/* the last input of each player the server's position is the result of */
+#endif
 } PKT_ALL_POS_UPDATE;
 
 typedef struct pkt12{
@@ -245,6 +260,10 @@ typedef struct pkt14 {
 typedef struct pkt15 {
 	uint32_t data;
 	uint16_t vel;
+#if SERVER_AUTHORITATIVE
+	uint16_t seq;
+	uint8_t inputs[POS_UPDATE_INPUTS];
+#endif
 } PKT_POS_UPDATE_MIN;
 
 typedef struct pkt16 {
@@ -253,6 +272,9 @@ typedef struct pkt16 {
 	uint32_t xPos[11];
 	uint32_t yPos[11];
 	uint16_t vel[32];
+#if SERVER_AUTHORITATIVE
+	uint16_t ack[32];
+#endif
 } PKT_ALL_POS_UPDATE_MIN;
 
 #endif
@@ -14,6 +14,7 @@
 #include "NetworkRouter.h"	
 #include "PipeUtils.h"
 #include "SendSystem.h"
+#include "../Gameplay/prediction.h"
 
 extern int network_ready;
 extern unsigned int player_entity;
@@ -37,17 +38,19 @@ teamNo_t player_team = 0;
 void send_location(World *world, int fd) 
 { 
 	PKT_POS_UPDATE * pkt4 = (PKT_POS_UPDATE*)malloc(sizeof(PKT_POS_UPDATE));
-    for (int i = 0; i < MAX_ENTITIES; i++)
+	EntityList *list = get_entity_list(world, COMPONENT_MOVEMENT | COMPONENT_POSITION | COMPONENT_PLAYER | COMPONENT_CONTROLLABLE);
+    for (unsigned int i = first_entity(list); i < MAX_ENTITIES; i = next_entity(list, i))
 	{
-		if (IN_THIS_COMPONENT(world->mask[i], COMPONENT_MOVEMENT | COMPONENT_POSITION | COMPONENT_PLAYER | COMPONENT_CONTROLLABLE))
-		{
-			pkt4->xPos = world->position[i].x;
-			pkt4->yPos = world->position[i].y;
-			pkt4->xVel = world->movement[i].movX;
-			pkt4->yVel = world->movement[i].movY;
-			pkt4->floor = world->position[i].level;
-			pkt4->player_number = world->player[i].playerNo;
-		}
+		pkt4->xPos = world->position[i].x;
+		pkt4->yPos = world->position[i].y;
+		pkt4->xVel = world->movement[i].movX;
+		pkt4->yVel = world->movement[i].movY;
+		pkt4->floor = world->position[i].level;
+		pkt4->player_number = world->player[i].playerNo;
+#if SERVER_AUTHORITATIVE
+		pkt4->seq = last_input_sequence();
+		pack_recent_inputs(pkt4->inputs, POS_UPDATE_INPUTS);
+#endif
 	}
 	write_packet(fd, P_POSUPDATE, pkt4);
     free(pkt4);
@@ -93,7 +96,7 @@ void send_tag(World * world, int fd, unsigned int taggee)
 void send_intialization(World *world, int fd, char * username)
 {
 	PKT_PLAYER_NAME * pkt1 = (PKT_PLAYER_NAME *)malloc(sizeof(PKT_PLAYER_NAME));
-	for (int j = 0; j < MAX_ENTITIES; j++) {
+	for (unsigned int j = 0; j < world->entity_end; j++) {
 		if (IN_THIS_COMPONENT(world->mask[j], COMPONENT_PLAYER | COMPONENT_CONTROLLABLE))
 		{
 			player_entity = j;
@@ -181,7 +184,7 @@ void send_chat(World * world, int fd, char * str)
 
 	PKT_SND_CHAT * pkt = (PKT_SND_CHAT*) calloc(1, sizeof(PKT_SND_CHAT));
 
-	for (int i = 0; i < MAX_ENTITIES; i++)
+	for (unsigned int i = 0; i < world->entity_end; i++)
 	{
 		if (IN_THIS_COMPONENT(world->mask[i], COMPONENT_MOVEMENT | COMPONENT_POSITION | COMPONENT_PLAYER | COMPONENT_CONTROLLABLE))
 		{
@@ -209,7 +212,7 @@ void send_objectives(World * world, int fd)
 	PKT_OBJECTIVE_STATUS * obj_status = (PKT_OBJECTIVE_STATUS*) calloc(1, sizeof(PKT_OBJECTIVE_STATUS));
 	unsigned int obj_idx = (world->position[player_entity].level - 1) * OBJECTIVES_PER_FLOOR; // find the offset into the objectives array
 
-	for(int i = 0; i < MAX_ENTITIES; i++)
+	for(unsigned int i = 0; i < world->entity_end; i++)
 	{
 		if(IN_THIS_COMPONENT(world->mask[i], COMPONENT_OBJECTIVE))
 		{
@@ -32,7 +32,9 @@
  *			'data', 'player_number' gets the next 5 bits, 'xPos' gets the next 11
  *			bits, and 'yPos' gets the last 11 bits. 'vel' contains the 'xVel' and
  *			'yVel' of the player. 'xVel' gets the first 4 bits, and 'yVel' gets
- *			the last 4 bits.
+ *			the last 4 bits. With SERVER_AUTHORITATIVE on, 'seq' is the player's
+ *			last input sequence number and 'inputs' the commands of the inputs
+ *			up to it, both copied as is.
  *		PKT_ALL_POS_UPDATE_MIN:
  *			This structure contains many variables, first, a uint32_t
  *			'players_on_floor', then two 11 element uint32_t arrays 'xVel' and
@@ -47,7 +49,9 @@
  *			'xPos' is in both the least significant bits of 'xPos[0]', and the
  *			most significant bits of 'xPos[1]'. 'vel' contains 32 uint8_t
  *			variables in an array, each element to contain the 'xVel' as the most
- *			significant 4 bits, and 'yVel' as the least significant 4 bits.
+ *			significant 4 bits, and 'yVel' as the least significant 4 bits. With
+ *			SERVER_AUTHORITATIVE on, 'ack' is the last input sequence number of
+ *			each player, copied as is.
  *	
  *	These functions were lovingly designed and implemented by Clark Allenby with
  *	special consideration to Shane Spoor with work on the design, to be easily
@@ -98,6 +102,11 @@ PKT_POS_UPDATE_MIN *encapsulate_pos_update(PKT_POS_UPDATE *old_pkt) {
 	pkt->vel <<= 8;
 	pkt->vel |= n_yVel & 0xFF;
 	
+#if SERVER_AUTHORITATIVE
+	pkt->seq = old_pkt->seq;
+	memcpy(pkt->inputs, old_pkt->inputs, sizeof(pkt->inputs));
+#endif
+	
 	free(old_pkt);
 	return pkt;
 }
@@ -131,6 +140,11 @@ PKT_POS_UPDATE *decapsulate_pos_update(PKT_POS_UPDATE_MIN *pkt) {
 	old_pkt->xVel = (float)((((pkt->vel >> 8) & 0xFF) - FACTOR) / GRANULARITY_VEL);
 	old_pkt->yVel = (float)(((pkt->vel & 0xFF) - FACTOR) / GRANULARITY_VEL);
 	
+#if SERVER_AUTHORITATIVE
+	old_pkt->seq = pkt->seq;
+	memcpy(old_pkt->inputs, pkt->inputs, sizeof(old_pkt->inputs));
+#endif
+	
 	free(pkt);
 	
 	return old_pkt;
@@ -176,6 +190,9 @@ PKT_ALL_POS_UPDATE_MIN *encapsulate_all_pos_update(PKT_ALL_POS_UPDATE *old_pkt)
 		pkt->vel[i] <<= 8;
 		pkt->vel[i] |= n_yVel & 0xFF;
 		pkt->players_on_floor |= (old_pkt->players_on_floor[i]) << i;
+#if SERVER_AUTHORITATIVE
+		pkt->ack[i] = old_pkt->ack[i];
+#endif
 	}
 	
 	memset(&pkt->xPos, 0x00, sizeof(uint32_t) * 11);
@@ -243,6 +260,9 @@ PKT_ALL_POS_UPDATE *decapsulate_all_pos_update(PKT_ALL_POS_UPDATE_MIN *pkt) {
 		old_pkt->players_on_floor[i] = (pkt->players_on_floor >> i) & 0x1;
 		old_pkt->xVel[i] = (float)((((pkt->vel[i] >> 8) & 0xFF) - FACTOR) / GRANULARITY_VEL);
 		old_pkt->yVel[i] = (float)(((pkt->vel[i] & 0xFF) - FACTOR) / GRANULARITY_VEL);
+#if SERVER_AUTHORITATIVE
+		old_pkt->ack[i] = pkt->ack[i];
+#endif
 	}
 	
 	old_pkt->xPos[0] = (float)(GRANULARITY_POS * ((pkt->xPos[0] >> 21) & 0x7FF));
@@ -6,6 +6,11 @@
 #include "Input/menu.h"
 #include "Graphics/text.h"
 #include "Input/chat.h"
+#include "Graphics/renderer.h"
+#include "Graphics/image_cache.h"
+#include "Graphics/map_loader.h"
+#include "scheduler.h"
+#include "Gameplay/prediction.h"
 
 #include <stdlib.h>
 #include <time.h>
@@ -23,13 +28,120 @@ int window_width = WIDTH;
 int window_height = HEIGHT;
 SDL_Window *window;
 
+static FPS fps;
+static unsigned int begin_time;
+static unsigned int sim_last_ticks;		//when the simulation was last caught up
+static unsigned int sim_accumulator;	//time the simulation is behind by, in milliseconds times SIM_RATE
+
+/**
+ * Runs as many simulation ticks as the time since the last frame makes up, from the scheduler.
+ *
+ * Whatever is left over is how far the frame is towards the next tick, which the
+ * render systems use to draw the moving entities between ticks. The player's
+ * actions and what is sent to the server are done once, after the ticks.
+ *
+ * @param world The world struct.
+ */
+static void run_simulation(World *world) {
+	unsigned int now = SDL_GetTicks();
+	
+	sim_accumulator += (now - sim_last_ticks) * SIM_RATE;
+	sim_last_ticks = now;
+	
+	if (sim_accumulator > MAX_SIM_TICKS * 1000) {
+		sim_accumulator = MAX_SIM_TICKS * 1000;
+	}
+	
+	while (sim_accumulator >= 1000) {
+		movement_system(world);
+		
+#if SERVER_AUTHORITATIVE
+		if (player_entity < MAX_ENTITIES) {
+			record_input(world, player_entity);
+		}
+#endif
+		
+		//a tick can take the stairs, so the next tick has to be on the new floor.
+		apply_deferred(world);
+		
+		sim_accumulator -= 1000;
+	}
+	
+	player_action_system(world, send_router_fd[WRITE]);
+	
+	world->interpolation = sim_accumulator / 1000.0f;
+}
 
-int main(int argc, char* argv[]) {
-	SDL_Surface *surface;
+/**
+ * Draws the map, or clears the screen if there's no player yet, from the scheduler.
+ *
+ * @param world The world struct.
+ */
+static void run_map_render(World *world) {
+	
+	//the map clears the screen itself if it doesn't cover it
+	if (player_entity < MAX_ENTITIES) {
+		map_render(world, player_entity);
+	}
+	else {
+		renderer_clear();
+	}
+}
+
+/**
+ * Works out the fog of war, from the scheduler.
+ *
+ * @param world The world struct.
+ */
+static void run_fog_of_war(World *world) {
+	fog_of_war_system(world, fow);
+}
+
+/**
+ * Draws the entities, from the scheduler.
+ *
+ * @param world The world struct.
+ */
+static void run_render_player(World *world) {
+	render_player_system(*world, fow);
+}
+
+/**
+ * Draws the fog of war, the chat and shows the frame, from the scheduler.
+ *
+ * @param world The world struct.
+ */
+static void run_present(World *world) {
+	
+	render_fog_of_war_system(fow);
+	render_menu_system(world);
+	chat_render();
+	
+	renderer_present();
+}
+
+/**
+ * Sends the player's location and reads the server's updates, from the scheduler.
+ *
+ * @param world The world struct.
+ */
+static void run_network(World *world) {
+	unsigned int current_time;
+	
+	if(network_ready)
+	{
+		current_time = SDL_GetTicks();
+		if((current_time - begin_time) >= (1000/SEND_FREQUENCY))
+		{
+			begin_time = SDL_GetTicks();
+			send_location(world, send_router_fd[WRITE]);
+		}
+		client_update_system(world, rcv_router_fd[READ]);
+	}
+}
 
-	SDL_Renderer *renderer;
-	SDL_Texture *surface_texture;
 
+int main(int argc, char* argv[]) {
 	World *world = (World*)malloc(sizeof(World));
 	//printf("Current World size: %lu\n", sizeof(World));
 	
@@ -41,23 +153,25 @@ int main(int argc, char* argv[]) {
 		printf("Error initializing the window.\n");
 		return 1;
 	}
-	renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-	SDL_SetRenderDrawColor(renderer, 0x0, 0x0, 0x0, 0xff);
-	surface = SDL_CreateRGBSurface(0, WIDTH, HEIGHT, 32, 0, 0, 0, 0);
-	
-	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear"); 
-	SDL_RenderSetLogicalSize(renderer, WIDTH, HEIGHT);
+	if (init_renderer(window) == -1) {
+		printf("Error initializing the renderer.\n");
+		return 1;
+	}
 	
-	init_chat();
 	init_sound();
 	init_fonts();
+	init_map_loader();
+	init_scheduler();
 	
-	init_world(world);
+	if (init_world(world) == -1) {
+		printf("Error initializing the world.\n");
+		return 1;
+	}
 	srand(time(NULL));//random initializer
 	KeyMapInit("assets/Input/keymap.txt");
 	init_render_player_system();
 
-	unsigned int begin_time = SDL_GetTicks();
+	begin_time = SDL_GetTicks();
 	
 	#if DISPLAY_CUTSCENES
 	
@@ -69,8 +183,8 @@ int main(int argc, char* argv[]) {
 	#endif
 	
 
-	FPS fps;
 	fps.init();
+	sim_last_ticks = SDL_GetTicks();
 
 	running = true;
 	player_entity = -1;
@@ -78,60 +192,42 @@ int main(int argc, char* argv[]) {
 	init_fog_of_war_system(&fow);
 	init_players_speech(fow);
 	
+	//Systems that share nothing run at the same time, the rest run in this order.
+	//Input, movement, the network and the cutscenes make and destroy entities, so they write everything.
+	//Only the animations and the fog's line of sight leave this thread: they don't use SDL, sounds or the network.
+	schedule_system(KeyInputSystem,		0,	ACCESS_ALL,	true);
+	schedule_system(MouseInputSystem,	0,	ACCESS_ALL,	true);
+	schedule_system(run_simulation,		0,	ACCESS_ALL,	true);
+	schedule_system(run_map_render,		COMPONENT_LEVEL | COMPONENT_POSITION,	ACCESS_RENDERER,	true);
+	schedule_system(animation_system,	COMPONENT_ANIMATION,	COMPONENT_ANIMATION | COMPONENT_RENDER_PLAYER,	false);
+	schedule_system(run_fog_of_war,		COMPONENT_LEVEL | COMPONENT_POSITION | COMPONENT_PLAYER,	ACCESS_FOG,	false);
+	schedule_system(cutscene_system,	0,	ACCESS_ALL,	true);
+	schedule_system(run_render_player,	COMPONENT_POSITION | COMPONENT_RENDER_PLAYER | COMPONENT_PLAYER | ACCESS_FOG,	ACCESS_RENDERER,	true);
+	schedule_system(run_present,		COMPONENT_POSITION | COMPONENT_RENDER_PLAYER,	ACCESS_RENDERER | ACCESS_FOG | COMPONENT_TEXTFIELD,	true);
+	schedule_system(run_network,		0,	ACCESS_ALL,	true);
+	
 	while (running)
 	{
-		unsigned int current_time;
-		KeyInputSystem(world);
-		MouseInputSystem(world);
-		movement_system(world, fps, send_router_fd[WRITE]);
-
-		if (player_entity < MAX_ENTITIES) {
-			map_render(surface, world, player_entity);
-		}
-				
-
-		animation_system(world);
-		cutscene_system(world);
-
-		render_player_system(*world, surface, fow);
-		render_fog_of_war_system(surface, fow);
-		render_menu_system(world, surface);
-		chat_render(surface);
-		
-		
-		
-		surface_texture = SDL_CreateTextureFromSurface(renderer, surface);
-		SDL_RenderClear(renderer);
-		SDL_RenderCopy(renderer, surface_texture, NULL, NULL);
-		
-		SDL_DestroyTexture(surface_texture);
-		SDL_RenderPresent(renderer);
-
-
-
-		if(network_ready)
-		{
-			current_time = SDL_GetTicks();
-			if((current_time - begin_time) >= (1000/SEND_FREQUENCY))
-			{
-				begin_time = SDL_GetTicks();
-				send_location(world, send_router_fd[WRITE]);
-			}
-			client_update_system(world, rcv_router_fd[READ]);
-		}
+		run_systems(world);
 
 		fps.limit();
 		fps.update();
 	}
 	
 	
+	cleanup_scheduler();
 	cleanup_fog_of_war(fow);
+	cleanup_map_loader();
 	cleanup_map();
 	cleanup_sound();
 	cleanup_fonts();
 	
 	destroy_world(world);
+	cleanup_world(world);
 	free(world);
+	cleanup_animations();
+	cleanup_image_cache();
+	cleanup_renderer();
 	IMG_Quit();
 	SDL_Quit();
 	
@@ -0,0 +1,248 @@
+/**
+ * Runs the main loop's systems, running systems that don't share anything at the same time.
+ *
+ * Each system says which components (and other shared things, see scheduler.h)
+ * it reads and writes. The systems are split into batches in the order they
+ * were scheduled: a system joins the batch before it unless it writes something
+ * a system in that batch uses, or uses something one of them writes. The
+ * systems in a batch run at the same time, on the main thread if they have to
+ * (anything that uses SDL, plays sounds, talks to the network or makes
+ * entities) and on the worker threads otherwise. The deferred commands are
+ * applied after every batch, on the main thread.
+ *
+ * @file scheduler.cpp
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "scheduler.h"
+
+/**
+ * A system and what it uses.
+ *
+ * @struct ScheduledSystem
+ */
+typedef struct {
+	SystemFunction run;    /**< The system. */
+	unsigned int reads;    /**< The components and shared things the system reads. */
+	unsigned int writes;   /**< The components and shared things the system writes. */
+	bool main_thread;      /**< Whether the system has to run on the main thread. */
+	unsigned int batch;    /**< The batch the system runs in. */
+} ScheduledSystem;
+
+static ScheduledSystem scheduled_systems[MAX_SCHEDULED_SYSTEMS]; /**< The systems, in the order they were scheduled. */
+static unsigned int scheduled_count = 0;                         /**< The number of systems. */
+
+static pthread_t scheduler_workers[SCHEDULER_WORKERS];           /**< The worker threads. */
+static unsigned int scheduler_worker_count = 0;                  /**< The number of worker threads that were started. */
+static bool scheduler_running = false;                           /**< Whether the workers should keep running. */
+static pthread_mutex_t scheduler_lock = PTHREAD_MUTEX_INITIALIZER; /**< Locks the jobs. */
+static pthread_cond_t scheduler_wake = PTHREAD_COND_INITIALIZER;   /**< Signalled when there are jobs or the workers should stop. */
+static pthread_cond_t scheduler_done = PTHREAD_COND_INITIALIZER;   /**< Signalled when the last job is finished. */
+
+static World *job_world = NULL;                                  /**< The world the jobs run on. */
+static SystemFunction jobs[MAX_SCHEDULED_SYSTEMS];               /**< The systems of the batch that can run on any thread. */
+static unsigned int job_count = 0;                               /**< The number of jobs. */
+static unsigned int next_job = 0;                                /**< The next job to be taken. */
+static unsigned int finished_jobs = 0;                           /**< The number of jobs that have finished. */
+
+/**
+ * Takes jobs and runs them until there are none left.
+ *
+ * The scheduler lock is held when this is called and when it returns.
+ */
+static void run_jobs() {
+
+	SystemFunction job;
+
+	while (next_job < job_count) {
+
+		job = jobs[next_job++];
+
+		pthread_mutex_unlock(&scheduler_lock);
+		job(job_world);
+		pthread_mutex_lock(&scheduler_lock);
+
+		if (++finished_jobs == job_count)
+			pthread_cond_signal(&scheduler_done);
+	}
+}
+
+/**
+ * Runs jobs whenever there are some.
+ *
+ * @param arg Unused.
+ *
+ * @return NULL.
+ */
+static void *scheduler_worker(void *arg) {
+
+	pthread_mutex_lock(&scheduler_lock);
+
+	while (scheduler_running) {
+
+		if (next_job < job_count)
+			run_jobs();
+		else
+			pthread_cond_wait(&scheduler_wake, &scheduler_lock);
+	}
+
+	pthread_mutex_unlock(&scheduler_lock);
+
+	return NULL;
+}
+
+/**
+ * Checks whether two systems can't run at the same time.
+ *
+ * @param a One system.
+ * @param b The other system.
+ *
+ * @return true if either of them writes something the other one uses.
+ */
+static bool systems_conflict(const ScheduledSystem *a, const ScheduledSystem *b) {
+	return (a->writes & (b->reads | b->writes)) != 0 || (b->writes & a->reads) != 0;
+}
+
+/**
+ * Starts the worker threads.
+ *
+ * If a thread can't be started the systems run on the threads that were.
+ *
+ * @return 0 on success, -1 if no worker threads could be started.
+ */
+int init_scheduler() {
+
+	unsigned int i;
+
+	scheduler_running = true;
+
+	for (i = 0; i < SCHEDULER_WORKERS; i++) {
+
+		if (pthread_create(&scheduler_workers[i], NULL, scheduler_worker, NULL) != 0) {
+			printf("Error creating scheduler worker %u\n", i);
+			break;
+		}
+
+		scheduler_worker_count++;
+	}
+
+	return (scheduler_worker_count > 0) ? 0 : -1;
+}
+
+/**
+ * Stops the worker threads and forgets the systems.
+ */
+void cleanup_scheduler() {
+
+	unsigned int i;
+
+	pthread_mutex_lock(&scheduler_lock);
+	scheduler_running = false;
+	pthread_cond_broadcast(&scheduler_wake);
+	pthread_mutex_unlock(&scheduler_lock);
+
+	for (i = 0; i < scheduler_worker_count; i++) {
+		pthread_join(scheduler_workers[i], NULL);
+	}
+
+	scheduler_worker_count = 0;
+	scheduled_count = 0;
+}
+
+/**
+ * Adds a system to the end of the main loop.
+ *
+ * @param run         The system.
+ * @param reads       The components and ACCESS_ things the system reads.
+ * @param writes      The components and ACCESS_ things the system writes.
+ * @param main_thread Whether the system has to run on the main thread.
+ */
+void schedule_system(SystemFunction run, unsigned int reads, unsigned int writes, bool main_thread) {
+
+	ScheduledSystem *system;
+	unsigned int i;
+
+	if (scheduled_count >= MAX_SCHEDULED_SYSTEMS) {
+		printf("Too many systems, increase MAX_SCHEDULED_SYSTEMS.\n");
+		return;
+	}
+
+	system = &scheduled_systems[scheduled_count];
+	system->run = run;
+	system->reads = reads;
+	system->writes = writes;
+	system->main_thread = main_thread;
+	system->batch = (scheduled_count > 0) ? scheduled_systems[scheduled_count - 1].batch : 0;
+
+	//only the last batch can be joined, so systems that conflict still run in order.
+	for (i = scheduled_count; i-- > 0 && scheduled_systems[i].batch == system->batch;) {
+		if (systems_conflict(&scheduled_systems[i], system)) {
+			system->batch++;
+			break;
+		}
+	}
+
+	scheduled_count++;
+}
+
+/**
+ * Runs every system once.
+ *
+ * @param world The world struct.
+ */
+void run_systems(World *world) {
+
+	unsigned int start, end, i;
+
+	for (start = 0; start < scheduled_count; start = end) {
+
+		for (end = start + 1; end < scheduled_count && scheduled_systems[end].batch == scheduled_systems[start].batch; end++)
+			;
+
+		//a system on its own runs on this thread, there's nothing to run beside it.
+		if (end - start == 1 || scheduler_worker_count == 0) {
+			for (i = start; i < end; i++) {
+				scheduled_systems[i].run(world);
+			}
+		}
+		else {
+			pthread_mutex_lock(&scheduler_lock);
+
+			job_world = world;
+			job_count = 0;
+			next_job = 0;
+			finished_jobs = 0;
+
+			for (i = start; i < end; i++) {
+				if (!scheduled_systems[i].main_thread)
+					jobs[job_count++] = scheduled_systems[i].run;
+			}
+
+			pthread_cond_broadcast(&scheduler_wake);
+			pthread_mutex_unlock(&scheduler_lock);
+
+			for (i = start; i < end; i++) {
+				if (scheduled_systems[i].main_thread)
+					scheduled_systems[i].run(world);
+			}
+
+			//help with the jobs that haven't been taken, then wait for the rest.
+			pthread_mutex_lock(&scheduler_lock);
+
+			run_jobs();
+
+			while (finished_jobs < job_count)
+				pthread_cond_wait(&scheduler_done, &scheduler_lock);
+
+			job_count = 0;
+			next_job = 0;
+
+			pthread_mutex_unlock(&scheduler_lock);
+		}
+
+		apply_deferred(world);
+	}
+}
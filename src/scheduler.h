@@ -0,0 +1,30 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "world.h"
+
+#define MAX_SCHEDULED_SYSTEMS	16	/**< The most systems the main loop can run. */
+#define SCHEDULER_WORKERS		2	/**< The threads that run systems alongside the main thread. */
+
+//Things the systems share besides components. They use the bits above the components.
+#define ACCESS_RENDERER		(1u << 24)	/**< Drawing to the window. */
+#define ACCESS_FOG			(1u << 25)	/**< The fog of war. */
+
+//Creating or destroying entities, or changing masks straight away, can move every
+//component, so systems that do it write everything.
+#define ACCESS_ALL			0xFFFFFFFFu
+
+/**
+ * A system that runs once a frame.
+ *
+ * @param world The world struct.
+ */
+typedef void (*SystemFunction)(World *world);
+
+int init_scheduler();
+void cleanup_scheduler();
+
+void schedule_system(SystemFunction run, unsigned int reads, unsigned int writes, bool main_thread);
+void run_systems(World *world);
+
+#endif
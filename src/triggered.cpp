@@ -10,12 +10,13 @@
 #include "Graphics/text.h"
 #include "Network/Packets.h"
 #include "Graphics/map.h"
+#include "Graphics/image_cache.h"
+#include "Graphics/map_loader.h"
 
 #define DEBUG_SKINS     1 //1 = on, 0 = off
 #define ALT_SKIN_CHANCE 3 //chance to roll an alternate skin
 
 extern bool running;
-extern SDL_Surface *map_surface;
 extern unsigned int player_entity;
 extern int send_router_fd[];
 extern int rcv_router_fd[];
@@ -141,7 +142,7 @@ bool menu_click(World *world, unsigned int entity) {
 
 		FILE * keymapFile = fopen("assets/Input/keymap.txt", "w+");
 
-		for(int i = 0; i < MAX_ENTITIES; i++) {
+		for(unsigned int i = 0; i < world->entity_end; i++) {
 			
 			if (IN_THIS_COMPONENT(world->mask[i], COMPONENT_TEXTFIELD)) {
 								
@@ -172,7 +173,7 @@ bool menu_click(World *world, unsigned int entity) {
 
 		FILE * keymapFile = fopen("assets/Input/keymap.txt", "w+");
 
-		for(int i = 0; i < MAX_ENTITIES; i++) {
+		for(unsigned int i = 0; i < world->entity_end; i++) {
 			
 			if (IN_THIS_COMPONENT(world->mask[i], COMPONENT_TEXTFIELD)) {
 							
@@ -922,7 +923,7 @@ bool menu_click(World *world, unsigned int entity) {
 		}
 		stop_all_effects();
 
-		for(i = 0; i < MAX_ENTITIES; i++) {
+		for(i = 0; i < world->entity_end; i++) {
 
 			if (IN_THIS_COMPONENT(world->mask[i], COMPONENT_TEXTFIELD)) {
 
@@ -1016,7 +1017,7 @@ bool menu_click(World *world, unsigned int entity) {
 		
 		destroy_menu(world);
 		
-		world->mask[player_entity] ^= COMPONENT_COMMAND;
+		enable_component(world, player_entity, COMPONENT_COMMAND);
 		
 	}
 	else if (strcmp(world->button[entity].label, "ingame_exit") == 0) {
@@ -1026,8 +1027,9 @@ bool menu_click(World *world, unsigned int entity) {
         reset_fog_of_war(fow);
 		destroy_world(world);
 		player_entity = MAX_ENTITIES;
-		map_surface = 0;
 		cleanup_map();
+		clear_prefetched_maps();
+		release_unused_images();
 		create_main_menu(world);
 	}
 	
@@ -1056,6 +1058,7 @@ void animation_end(World *world, unsigned int entity) {
 		pkt.otherPlayers_teams[0] = 0;
 
 		map_init(world, "assets/Graphics/map/map_00/map00.txt", "assets/Graphics/map/map_00/tiles.txt");
+		prefetch_adjacent_floors(world);
 		player_entity = create_player(world, 620, 420, true, COLLISION_HACKER, 0, &pkt);
 		setup_character_animation(world, character, player_entity);
 		////NETWORK CODE
@@ -1111,6 +1114,7 @@ void cutscene_end(World *world, unsigned int entity) {
 		pkt.otherPlayers_teams[0] = 0;
 
 		map_init(world, "assets/Graphics/map/map_00/map00.txt", "assets/Graphics/map/map_00/tiles.txt");
+		prefetch_adjacent_floors(world);
 		player_entity = create_player(world, 620, 420, true, COLLISION_HACKER, 0, &pkt);
 		setup_character_animation(world, character, player_entity);
 		////NETWORK CODE
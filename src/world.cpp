@@ -6,89 +6,436 @@
 
 #include "world.h"
 #include "Gameplay/powerups.h"
+#include "Gameplay/collision.h"
+#include "Gameplay/level.h"
+#include "Graphics/renderer.h"
+#include "Graphics/image_cache.h"
+#include "Graphics/systems.h"
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_keycode.h>
 #include <SDL2/SDL_scancode.h>
 
+#include <pthread.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+
+static pthread_mutex_t entity_lists_lock = PTHREAD_MUTEX_INITIALIZER; /**< Locks the entity lists while one is found or made. */
+static pthread_mutex_t deferred_lock = PTHREAD_MUTEX_INITIALIZER;     /**< Locks the deferred commands while one is added. */
+
+/**
+ * Resizes one of the world's arrays.
+ *
+ * @param array    The array to resize. It is left alone if there isn't enough memory.
+ * @param size     The size of an element of the array.
+ * @param capacity The number of elements the array should have room for.
+ *
+ * @return 0 on success, -1 if there isn't enough memory.
+ */
+static int resize_component(void **array, size_t size, unsigned int capacity) {
+	
+	void *resized = realloc(*array, size * capacity);
+	
+	if (resized == NULL) {
+		return -1;
+	}
+	
+	*array = resized;
+	return 0;
+}
+
+/**
+ * Puts an entity on the free entity heap.
+ *
+ * @param world  The world struct
+ * @param entity The entity that was destroyed.
+ */
+static void push_free_entity(World *world, unsigned int entity) {
+	unsigned int i = world->free_count++;
+	unsigned int parent;
+	
+	//move it up past the free entities that are higher than it.
+	while (i > 0 && world->free_entities[parent = (i - 1) / 2] > entity) {
+		world->free_entities[i] = world->free_entities[parent];
+		i = parent;
+	}
+	
+	world->free_entities[i] = entity;
+}
+
+/**
+ * Takes the lowest entity off the free entity heap.
+ *
+ * @param world The world struct. The heap mustn't be empty.
+ *
+ * @return The lowest free entity.
+ */
+static unsigned int pop_free_entity(World *world) {
+	unsigned int lowest = world->free_entities[0];
+	unsigned int last = world->free_entities[--world->free_count];
+	unsigned int i = 0;
+	unsigned int child;
+	
+	//move the last free entity down from the top past the ones lower than it.
+	while ((child = i * 2 + 1) < world->free_count) {
+		
+		if (child + 1 < world->free_count && world->free_entities[child + 1] < world->free_entities[child]) {
+			child++;
+		}
+		
+		if (world->free_entities[child] >= last) {
+			break;
+		}
+		
+		world->free_entities[i] = world->free_entities[child];
+		i = child;
+	}
+	
+	world->free_entities[i] = last;
+	return lowest;
+}
+
+/**
+ * Grows every array in the world so it has room for more entities.
+ *
+ * The arrays can move, so pointers into them aren't valid after an entity is created.
+ *
+ * @param world    The world struct
+ * @param capacity The number of entities the world should have room for.
+ *
+ * @return 0 on success, -1 if there isn't enough memory.
+ */
+static int resize_world(World *world, unsigned int capacity) {
+	
+	unsigned int entity;
+	
+	//if one of these fails the arrays that have grown are bigger than they need to be,
+	//which is fine since the capacity doesn't change.
+	if (resize_component((void**)&world->mask,			sizeof(unsigned int),			capacity) ||
+		resize_component((void**)&world->position,		sizeof(PositionComponent),		capacity) ||
+		resize_component((void**)&world->command,		sizeof(CommandComponent),		capacity) ||
+		resize_component((void**)&world->movement,		sizeof(MovementComponent),		capacity) ||
+		resize_component((void**)&world->collision,		sizeof(CollisionComponent),		capacity) ||
+		resize_component((void**)&world->controllable,	sizeof(ControllableComponent),	capacity) ||
+		resize_component((void**)&world->level,			sizeof(LevelComponent),			capacity) ||
+		resize_component((void**)&world->mouse,			sizeof(MouseComponent),			capacity) ||
+		resize_component((void**)&world->text,			sizeof(TextFieldComponent),		capacity) ||
+		resize_component((void**)&world->button,		sizeof(ButtonComponent),		capacity) ||
+		resize_component((void**)&world->renderPlayer,	sizeof(RenderPlayerComponent),	capacity) ||
+		resize_component((void**)&world->player,		sizeof(PlayerComponent),		capacity) ||
+		resize_component((void**)&world->tag,			sizeof(TagComponent),			capacity) ||
+		resize_component((void**)&world->animation,		sizeof(AnimationComponent),		capacity) ||
+		resize_component((void**)&world->wormhole,		sizeof(WormholeComponent),		capacity) ||
+		resize_component((void**)&world->objective,		sizeof(ObjectiveComponent),		capacity) ||
+		resize_component((void**)&world->tile,			sizeof(TileComponent),			capacity) ||
+		resize_component((void**)&world->cutscene,		sizeof(CutsceneComponent),		capacity) ||
+		resize_component((void**)&world->powerup,		sizeof(PowerUpComponent),		capacity) ||
+		resize_component((void**)&world->previous,		sizeof(PreviousPosition),		capacity) ||
+		resize_component((void**)&world->remote,		sizeof(RemoteCorrection),		capacity) ||
+		resize_component((void**)&world->generation,	sizeof(unsigned int),			capacity) ||
+		resize_component((void**)&world->in_use,		sizeof(bool),					capacity) ||
+		resize_component((void**)&world->free_entities,	sizeof(unsigned int),			capacity)) {
+		printf("Error growing the world to %u entities\n", capacity);
+		return -1;
+	}
+	
+	for(entity = world->capacity; entity < capacity; entity++) {
+		world->mask[entity] = COMPONENT_EMPTY;
+		world->generation[entity] = 0;
+		world->in_use[entity] = false;
+		world->animation[entity].definition = NULL;
+	}
+	
+	world->capacity = capacity;
+	return 0;
+}
+
+/**
+ * Finds where an entity is, or would go, in an entity list.
+ *
+ * @param list   The entity list.
+ * @param entity The entity.
+ *
+ * @return The position of the first entity in the list that isn't lower than entity.
+ */
+static unsigned int find_list_position(const EntityList *list, unsigned int entity) {
+	
+	unsigned int low = 0;
+	unsigned int high = list->count;
+	unsigned int middle;
+	
+	while (low < high) {
+		middle = (low + high) / 2;
+		
+		if (list->entities[middle] < entity) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+	
+	return low;
+}
+
+/**
+ * Adds an entity to an entity list, keeping it in order.
+ *
+ * @param list   The entity list.
+ * @param entity The entity.
+ */
+static void add_to_list(EntityList *list, unsigned int entity) {
+	
+	unsigned int position;
+	unsigned int *entities;
+	
+	if (list->count == list->capacity) {
+		
+		if ((entities = (unsigned int*)realloc(list->entities, sizeof(unsigned int) * list->capacity * 2)) == NULL) {
+			printf("Error growing the entity list for %x\n", list->signature);
+			return;
+		}
+		
+		list->entities = entities;
+		list->capacity *= 2;
+	}
+	
+	//entities are usually created in order, so this is normally the end of the list.
+	position = find_list_position(list, entity);
+	
+	memmove(&list->entities[position + 1], &list->entities[position], sizeof(unsigned int) * (list->count - position));
+	list->entities[position] = entity;
+	list->count++;
+}
+
+/**
+ * Removes an entity from an entity list.
+ *
+ * @param list   The entity list.
+ * @param entity The entity.
+ */
+static void remove_from_list(EntityList *list, unsigned int entity) {
+	
+	unsigned int position = find_list_position(list, entity);
+	
+	if (position < list->count && list->entities[position] == entity) {
+		list->count--;
+		memmove(&list->entities[position], &list->entities[position + 1], sizeof(unsigned int) * (list->count - position));
+	}
+}
+
+/**
+ * Changes an entity's mask and moves it in or out of the entity lists.
+ *
+ * Every change to a mask has to go through here so the lists stay up to date.
+ *
+ * @param world  The world struct
+ * @param entity The entity.
+ * @param mask   The entity's new mask.
+ */
+static void set_mask(World *world, unsigned int entity, unsigned int mask) {
+	
+	unsigned int i;
+	bool was_member, is_member;
+	
+	for(i = 0; i < world->list_count; i++) {
+		
+		was_member = IN_THIS_COMPONENT(world->mask[entity], world->lists[i].signature) && world->mask[entity] != COMPONENT_EMPTY;
+		is_member = IN_THIS_COMPONENT(mask, world->lists[i].signature) && mask != COMPONENT_EMPTY;
+		
+		if (is_member && !was_member) {
+			add_to_list(&world->lists[i], entity);
+		}
+		else if (was_member && !is_member) {
+			remove_from_list(&world->lists[i], entity);
+		}
+	}
+	
+	if (((world->mask[entity] ^ mask) & (COMPONENT_COLLISION | COMPONENT_POSITION)) != 0) {
+		world->colliders.dirty = true;
+	}
+	
+	//an entity that starts or stops moving is drawn where it is until its next tick.
+	if (((world->mask[entity] ^ mask) & COMPONENT_MOVEMENT) != 0) {
+		world->previous[entity].level = -1;
+		world->remote[entity].x = 0;
+		world->remote[entity].y = 0;
+		world->remote[entity].ticks = 0;
+	}
+	
+	world->mask[entity] = mask;
+}
 
-extern unsigned int background;	//this is here because we need to keep the background loaded while in the menu.
-									//this needs to be cleaned up when the destroy_world function is called.
 /**
  * This function initializes every mask to be 0, so that there are no components.
  * 
+ * The world starts with room for INITIAL_ENTITIES entities.
+ * 
  * @param world The world struct containing the entity masks to be zeroed.
  *
+ * @return 0 on success, -1 if there isn't enough memory.
+ *
  * @designer
  * @author 
  */
-void init_world(World* world) {
+int init_world(World* world) {
 	int i;
-	for(i = 0; i < MAX_ENTITIES; ++i) {
-		world->mask[i] = COMPONENT_EMPTY;
+	
+	memset(world, 0, sizeof(World));
+	world->colliders.dirty = true;
+	
+	for(i = 0; i < LEVEL_FLOORS; i++) {
+		world->floor_level[i] = MAX_ENTITIES;
 	}
+	
+	return resize_world(world, INITIAL_ENTITIES);
 }
 
 /**
- * This function loops through the masks of all the entities and finds the first one
- * that is not used.
+ * Frees the world's arrays. The entities should be destroyed first with destroy_world.
+ *
+ * @param world The world struct
+ */
+void cleanup_world(World* world) {
+	unsigned int i;
+	
+	free(world->mask);
+	free(world->position);
+	free(world->command);
+	free(world->movement);
+	free(world->collision);
+	free(world->controllable);
+	free(world->level);
+	free(world->mouse);
+	free(world->text);
+	free(world->button);
+	free(world->renderPlayer);
+	free(world->player);
+	free(world->tag);
+	free(world->animation);
+	free(world->wormhole);
+	free(world->objective);
+	free(world->tile);
+	free(world->cutscene);
+	free(world->powerup);
+	free(world->previous);
+	free(world->remote);
+	free(world->generation);
+	free(world->in_use);
+	free(world->free_entities);
+	
+	for(i = 0; i < world->list_count; i++) {
+		free(world->lists[i].entities);
+	}
+	
+	free(world->colliders.entity);
+	free(world->colliders.x);
+	free(world->colliders.y);
+	free(world->colliders.half_width);
+	free(world->colliders.half_height);
+	free(world->colliders.level);
+	free(world->colliders.active);
+	free(world->colliders.cell_x);
+	free(world->colliders.cell_y);
+	free(world->colliders.cell_next);
+	free(world->colliders.cell_prev);
+	free(world->colliders.candidates);
+	free(world->colliders.slot);
+	
+	free(world->deferred);
+	
+	memset(world, 0, sizeof(World));
+}
+
+/**
+ * This function takes the lowest free entity, or the next entity that has never been
+ * used if none are free.
+ *
+ * Entities are put back on a heap of free entities by destroy_entity, so finding an
+ * entity only takes a few steps however many are in use. The lowest is always taken
+ * so entities keep being drawn in the order they were created. The world grows if
+ * every entity is in use.
  *
  * @param world 		The world struct containing all entities.
  * @param attributes 	The component mask to apply to the entity.
  *
- * @return 	The entity number if there was an entity available, or MAX_ENTITIES if all
- *			of the entities are in use.
+ * @return 	The entity number if there was an entity available, or MAX_ENTITIES if the
+ *			world can't grow any more.
  *
  * @designer
  * @author
  */
 unsigned int create_entity(World* world, unsigned int attributes) {
 	unsigned int entity;
-	for(entity = 0; entity < MAX_ENTITIES; entity++) {
-		if (world->mask[entity] == COMPONENT_EMPTY) {
-			world->mask[entity] = attributes;
-			return entity;
+	
+	if (world->free_count > 0) {
+		entity = pop_free_entity(world);
+	}
+	else {
+		if (world->entity_end == world->capacity) {
+			if (world->capacity >= MAX_ENTITIES ||
+				resize_world(world, (world->capacity * 2 < MAX_ENTITIES) ? world->capacity * 2 : MAX_ENTITIES) == -1) {
+				return MAX_ENTITIES;
+			}
 		}
+		entity = world->entity_end++;
 	}
-	return MAX_ENTITIES;
+	
+	world->in_use[entity] = true;
+	set_mask(world, entity, attributes);
+	return entity;
 }
 
 /**
- * [Brief description (one sentence)]
+ * Creates the level entity for a floor.
  *
- * [Detailed description (if necessary)]
+ * The collision types and a bit for every wall are kept in one allocation, row
+ * by row, so the wall checks only touch a few cache lines.
  *
- * @param world
- * @param map
- * @param width
- * @param height
- * @param tileSize
+ * @param world    The world struct
+ * @param map      The collision type of every tile, row by row.
+ * @param width    The width in tiles.
+ * @param height   The height in tiles.
+ * @param tileSize The size of a tile in pixels.
+ * @param floor    The floor the level is on.
  *
- * @return
+ * @return The level entity, or MAX_ENTITIES on failure.
  *
  * @designer
  * @author
  */
-unsigned int create_level(World* world, int** map, int width, int height, int tileSize, int floor) {
+unsigned int create_level(World* world, const int *map, int width, int height, int tileSize, int floor) {
 	
 	unsigned int entity = 0;
 	int i = 0;
-	int n = 0;
+	int tiles = width * height;
 	
 	entity = create_entity(world, COMPONENT_LEVEL);
 	
-	world->level[entity].map = (int**)malloc(sizeof(int*) * width);
-	for (i = 0; i < width; i++) {
-		world->level[entity].map[i] = (int*)malloc(sizeof(int) * height);
-		for (n = 0; n < height; n++) {
-			
-			world->level[entity].map[i][n] = map[i][n];
-			
+	if (entity >= MAX_ENTITIES) {
+		return MAX_ENTITIES;
+	}
+	
+	world->level[entity].levelID = -1;
+	
+	if ((world->level[entity].map = (unsigned char*)calloc(tiles + (tiles + 7) / 8, sizeof(unsigned char))) == NULL) {
+		printf("Error allocating the level\n");
+		destroy_entity(world, entity);
+		return MAX_ENTITIES;
+	}
+	world->level[entity].walls = world->level[entity].map + tiles;
+	
+	for (i = 0; i < tiles; i++) {
+		
+		world->level[entity].map[i] = map[i];
+		
+		if (map[i] == L_WALL) {
+			world->level[entity].walls[i >> 3] |= 1 << (i & 7);
 		}
 	}
-	world->level[entity].levelID = floor;
+	
+	set_level_floor(world, entity, floor);
 	world->level[entity].width = width;
 	world->level[entity].height = height;
 	world->level[entity].tileSize = tileSize;
@@ -168,10 +515,8 @@ unsigned int create_player(World* world, int x, int y, bool controllable, int co
 	powerup.duration = 0;
 	powerup.type = PU_NONE;
 
-	for(entity = 0; entity < MAX_ENTITIES; ++entity) {
-		if (world->mask[entity] == COMPONENT_EMPTY) {
-			if (controllable) {
-				world->mask[entity] =	COMPONENT_POSITION | 
+	if (controllable) {
+		entity = create_entity(world,	COMPONENT_POSITION | 
 										COMPONENT_RENDER_PLAYER | 
 										COMPONENT_COMMAND | 
 										COMPONENT_MOVEMENT | 
@@ -179,31 +524,33 @@ unsigned int create_player(World* world, int x, int y, bool controllable, int co
 										COMPONENT_CONTROLLABLE |
 										COMPONENT_PLAYER |
 										COMPONENT_ANIMATION |
-										COMPONENT_POWERUP;
-			} else {
-				world->mask[entity] =	COMPONENT_POSITION | 
+										COMPONENT_POWERUP);
+	} else {
+		entity = create_entity(world,	COMPONENT_POSITION | 
 										COMPONENT_RENDER_PLAYER | 
 										COMPONENT_ANIMATION |
 										COMPONENT_COLLISION | 
 										COMPONENT_MOVEMENT |
 										COMPONENT_PLAYER |
-										COMPONENT_POWERUP;
-			}
-			world->position[entity] = pos;
-			world->renderPlayer[entity] = render;
-			world->command[entity] = command;
-			world->movement[entity] = movement;
-			world->collision[entity] = collision;
-			world->player[entity] = player;
-			world->powerup[entity] = powerup;
-
-			if (controllable) {
-				world->controllable[entity] = control;
-			}
-			return entity;
-		}
+										COMPONENT_POWERUP);
 	}
-	return MAX_ENTITIES;
+	
+	if (entity >= MAX_ENTITIES) {
+		return MAX_ENTITIES;
+	}
+	
+	world->position[entity] = pos;
+	world->renderPlayer[entity] = render;
+	world->command[entity] = command;
+	world->movement[entity] = movement;
+	world->collision[entity] = collision;
+	world->player[entity] = player;
+	world->powerup[entity] = powerup;
+
+	if (controllable) {
+		world->controllable[entity] = control;
+	}
+	return entity;
 }
 
 //creates a target for the hackers
@@ -250,7 +597,7 @@ unsigned int create_objective(World* world, float x, float y, int w, int h, int
  * @param height - height of the stair.
  * @param level - level the stair is on.
  *
- * @return the entity id of the newly created stair
+ * @return the entity id of the newly created stair, or MAX_ENTITIES on failure
  *
  * @designer JOSH & IAN
  * @author JOSH & IAN
@@ -260,6 +607,10 @@ unsigned int create_stair(World* world, int targetLevel, int targetX, int target
 	
 	entity = create_entity(world, COMPONENT_POSITION | COMPONENT_COLLISION | COMPONENT_WORMHOLE);
 	
+	if (entity == MAX_ENTITIES) {
+		return MAX_ENTITIES;
+	}
+	
 	world->position[entity].x = x;
 	world->position[entity].y = y;
 	world->position[entity].width = width;
@@ -283,6 +634,10 @@ unsigned int create_stair(World* world, int targetLevel, int targetX, int target
 unsigned int create_block(World* world, int x, int y, int width, int height, int level) {
 	unsigned int entity = create_entity(world, COMPONENT_POSITION | COMPONENT_COLLISION);
 	
+	if (entity == MAX_ENTITIES) {
+		return MAX_ENTITIES;
+	}
+	
 	world->position[entity].x = x;
 	world->position[entity].y = y;
 	world->position[entity].width = width;
@@ -304,6 +659,10 @@ unsigned int create_powerup(World * world, float x, float y, int width, int heig
 	
 	entity = create_entity(world, COMPONENT_POSITION | COMPONENT_COLLISION);
 	
+	if (entity == MAX_ENTITIES) {
+		return MAX_ENTITIES;
+	}
+	
 	world->position[entity].x = x;
 	world->position[entity].y = y;
 	world->position[entity].width = width;
@@ -335,45 +694,33 @@ unsigned int create_powerup(World * world, float x, float y, int width, int heig
  */
 void destroy_entity(World* world, const unsigned int entity) {
 
-	int i, j;
+	if (entity >= world->entity_end || !world->in_use[entity]) {
+		return;
+	}
 	
-	if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_ANIMATION)) {
-		
-		//printf("animation count: %d\n", world->animation[entity].animation_count);
-		
-		for(i = 0; i < world->animation[entity].animation_count; i++) {
-			//printf("-- count %s: %d\n", world->animation[entity].animations[i].name, world->animation[entity].animations[i].surface_count);
-			
-			free(world->animation[entity].animations[i].name);
-			
-			
-			for(j = 0; j < world->animation[entity].animations[i].surface_count; j++) {
-				
-				SDL_FreeSurface(world->animation[entity].animations[i].surfaces[j]);
-				
-				//printf("Free frame!\n");
-				
-			}
-			
-			free(world->animation[entity].animations[i].surfaces);
-		}
-		free(world->animation[entity].animations);
+	if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_ANIMATION) || world->animation[entity].definition != NULL) {
 		
-		//we have already free'd the surface so make sure it isn't free'd again.
+		//the animation frames are shared with other entities, so make sure the surface isn't free'd.
 		world->renderPlayer[entity].playerSurface = NULL;
 	}
+	
+	//the definition is let go of even if the animation was turned off, it was still loaded.
+	release_animation_definition(world->animation[entity].definition);
+	world->animation[entity].definition = NULL;
 	if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_RENDER_PLAYER)) {
 		
 		//printf("POINTER: %p\n", world->renderPlayer[entity].playerSurface);
 		
 		if (world->renderPlayer[entity].playerSurface != NULL)
-			SDL_FreeSurface(world->renderPlayer[entity].playerSurface);
+			release_image(world->renderPlayer[entity].playerSurface);
 		
 	}
 	if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_TEXTFIELD)) {
 		
 		free(world->text[entity].text);
 		free(world->text[entity].name);
+		free(world->text[entity].drawn_text);
+		renderer_free_surface(world->text[entity].text_surface);
 		
 	}
 	if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_BUTTON)) {
@@ -381,19 +728,29 @@ void destroy_entity(World* world, const unsigned int entity) {
 	}
 	if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_LEVEL)) {
 		
-		for (i = 0; i < world->level[entity].width; i++) {
-			free(world->level[entity].map[i]);
+		if (get_floor_level(world, world->level[entity].levelID) == entity) {
+			set_level_floor(world, entity, -1);
 		}
 		
+		//the wall bits are in the same allocation.
 		free(world->level[entity].map);
 	}
 	
-	world->mask[entity] = COMPONENT_EMPTY;
+	set_mask(world, entity, COMPONENT_EMPTY);
+	
+	//stale handles to the entity won't match the new generation.
+	world->generation[entity]++;
+	world->in_use[entity] = false;
+	push_free_entity(world, entity);
 }
 
 /**
  * Deletes all entities in the world.
  *
+ * The free entities are forgotten afterwards so new entities are handed out in order
+ * from 0 again. Entities are destroyed from the highest down so they come off
+ * the end of the entity lists.
+ *
  * @param world The world struct
  *
  * @designer Jordan Marling
@@ -403,38 +760,588 @@ void destroy_entity(World* world, const unsigned int entity) {
 void destroy_world(World *world) {
 	unsigned int entity;
 	
-	for(entity = 0; entity < MAX_ENTITIES; entity++) {
+	for(entity = world->entity_end; entity-- > 0;) {
 		destroy_entity(world, entity);
 	}
-	background = MAX_ENTITIES + 1;
+	
+	world->free_count = 0;
+	world->entity_end = 0;
 }
 
+/**
+ * Deletes every entity except the players and the special tiles.
+ *
+ * Entities are destroyed from the highest down so they come off the end of the
+ * entity lists. The new floor is created in the lowest free entities, in the same
+ * order as before.
+ *
+ * @param world The world struct
+ *
+ * @designer Ramzi Chennafi
+ * @author Ramzi Chennafi
+ */
 void destroy_world_not_player(World *world) {
 	unsigned int entity;
 	
-	for(entity = 0; entity < MAX_ENTITIES; entity++) {
+	for(entity = world->entity_end; entity-- > 0;) {
 		if(!IN_THIS_COMPONENT(world->mask[entity], COMPONENT_PLAYER) && !IN_THIS_COMPONENT(world->mask[entity], COMPONENT_STILE)) {
 			destroy_entity(world, entity);
 		}
 	}
 }
 
+/**
+ * Gets where to draw an entity this frame.
+ *
+ * Moving entities are drawn between where they were at the start of the last
+ * simulation tick and where they are now, so they move smoothly at any frame
+ * rate. Entities that changed floors are drawn where they are.
+ *
+ * @param world  The world struct
+ * @param entity The entity.
+ * @param x      Set to the x position to draw the entity at.
+ * @param y      Set to the y position to draw the entity at.
+ */
+void get_draw_position(World *world, unsigned int entity, float *x, float *y) {
+	PositionComponent *position = &world->position[entity];
+	PreviousPosition *previous = &world->previous[entity];
+	
+	if (!IN_THIS_COMPONENT(world->mask[entity], COMPONENT_MOVEMENT) || previous->level != position->level) {
+		*x = position->x;
+		*y = position->y;
+		return;
+	}
+	
+	*x = previous->x + (position->x - previous->x) * world->interpolation;
+	*y = previous->y + (position->y - previous->y) * world->interpolation;
+}
+
+/**
+ * Gets the level entity of a floor.
+ *
+ * Floors from 0 to LEVEL_FLOORS - 1 are looked up directly, any other floor is
+ * searched for.
+ *
+ * @param world The world struct
+ * @param floor The floor.
+ *
+ * @return The level entity, or MAX_ENTITIES if the floor isn't loaded.
+ */
+unsigned int get_floor_level(World *world, int floor) {
+	
+	unsigned int entity;
+	EntityList *levels;
+	
+	if (floor >= 0 && floor < LEVEL_FLOORS) {
+		return world->floor_level[floor];
+	}
+	
+	levels = get_entity_list(world, COMPONENT_LEVEL);
+	
+	for(entity = first_entity(levels); entity < MAX_ENTITIES; entity = next_entity(levels, entity)) {
+		if (world->level[entity].levelID == floor) {
+			return entity;
+		}
+	}
+	
+	return MAX_ENTITIES;
+}
+
+/**
+ * Sets the floor a level is on. This is the only place the floor should be changed,
+ * so that get_floor_level stays up to date.
+ *
+ * @param world  The world struct
+ * @param entity The level entity.
+ * @param floor  The floor, or -1 to take the level off of every floor.
+ */
+void set_level_floor(World *world, unsigned int entity, int floor) {
+	
+	int old_floor = world->level[entity].levelID;
+	
+	if (old_floor >= 0 && old_floor < LEVEL_FLOORS && world->floor_level[old_floor] == entity) {
+		world->floor_level[old_floor] = MAX_ENTITIES;
+	}
+	
+	world->level[entity].levelID = floor;
+	
+	if (floor >= 0 && floor < LEVEL_FLOORS) {
+		world->floor_level[floor] = entity;
+	}
+}
 
+/**
+ * Gets a handle to an entity that can be kept between frames.
+ *
+ * @param world  The world struct
+ * @param entity The entity.
+ *
+ * @return The handle.
+ */
+unsigned int get_entity_handle(World *world, unsigned int entity) {
+	return (world->generation[entity] << ENTITY_INDEX_BITS) | entity;
+}
 
+/**
+ * Gets the entity a handle was made for, if it hasn't been destroyed since.
+ *
+ * @param world  The world struct
+ * @param handle The handle from get_entity_handle.
+ *
+ * @return The entity, or MAX_ENTITIES if it has been destroyed.
+ */
+unsigned int get_handle_entity(World *world, unsigned int handle) {
+	unsigned int entity = handle & ENTITY_INDEX_MASK;
+	
+	if (entity >= world->entity_end ||
+		!world->in_use[entity] ||
+		get_entity_handle(world, entity) != handle) {
+		return MAX_ENTITIES;
+	}
+	
+	return entity;
+}
 
+/**
+ * Removes components from an entity.
+ *
+ * @param world     The world struct
+ * @param entity    The entity.
+ * @param component The components to remove.
+ */
 void disable_component(World *world, unsigned int entity, unsigned int component) {
 	
-	if (IN_THIS_COMPONENT(world->mask[entity], component)) {
-		world->mask[entity] ^= component;
+	if ((world->mask[entity] & component) != 0) {
+		set_mask(world, entity, world->mask[entity] & ~component);
 	}
 	
 }
 
+/**
+ * Adds components to an entity.
+ *
+ * @param world     The world struct
+ * @param entity    The entity.
+ * @param component The components to add.
+ */
 void enable_component(World *world, unsigned int entity, unsigned int component) {
 	
 	if (!IN_THIS_COMPONENT(world->mask[entity], component)) {
-		world->mask[entity] ^= component;
+		set_mask(world, entity, world->mask[entity] | component);
 	}
 	
 }
 
+/**
+ * Makes the list of entities that have every component in a signature.
+ *
+ * @param world     The world struct
+ * @param signature The components the entities need.
+ *
+ * @return The entity list, or NULL if there are already MAX_ENTITY_LISTS lists.
+ */
+static EntityList *create_entity_list(World *world, unsigned int signature) {
+	
+	unsigned int entity;
+	EntityList *list;
+	
+	if (world->list_count >= MAX_ENTITY_LISTS) {
+		printf("Too many entity lists, increase MAX_ENTITY_LISTS.\n");
+		return NULL;
+	}
+	
+	list = &world->lists[world->list_count];
+	list->signature = signature;
+	list->count = 0;
+	list->capacity = INITIAL_ENTITIES;
+	
+	if ((list->entities = (unsigned int*)malloc(sizeof(unsigned int) * list->capacity)) == NULL) {
+		printf("Error creating the entity list for %x\n", signature);
+		return NULL;
+	}
+	
+	for(entity = 0; entity < world->entity_end; entity++) {
+		if (world->mask[entity] != COMPONENT_EMPTY && IN_THIS_COMPONENT(world->mask[entity], signature)) {
+			add_to_list(list, entity);
+		}
+	}
+	
+	//the list is only counted once it is filled, so it is never searched half made.
+	world->list_count++;
+	
+	return list;
+}
+
+/**
+ * Gets the list of entities that have every component in a signature.
+ *
+ * The list is made the first time a signature is asked for, and is kept up to
+ * date from then on. Systems loop over it with first_entity and next_entity
+ * instead of checking every mask.
+ *
+ * @param world     The world struct
+ * @param signature The components the entities need.
+ *
+ * @return The entity list, or NULL if there are already MAX_ENTITY_LISTS lists.
+ */
+EntityList *get_entity_list(World *world, unsigned int signature) {
+	
+	unsigned int i;
+	EntityList *list = NULL;
+	
+	//systems running on the scheduler's workers can ask for lists at the same time.
+	pthread_mutex_lock(&entity_lists_lock);
+	
+	for(i = 0; i < world->list_count; i++) {
+		if (world->lists[i].signature == signature) {
+			list = &world->lists[i];
+			break;
+		}
+	}
+	
+	if (list == NULL) {
+		list = create_entity_list(world, signature);
+	}
+	
+	pthread_mutex_unlock(&entity_lists_lock);
+	
+	return list;
+}
+
+/**
+ * Gets the lowest entity in an entity list.
+ *
+ * @param list The entity list.
+ *
+ * @return The entity, or MAX_ENTITIES if the list is empty.
+ */
+unsigned int first_entity(const EntityList *list) {
+	
+	if (list == NULL || list->count == 0) {
+		return MAX_ENTITIES;
+	}
+	
+	return list->entities[0];
+}
+
+/**
+ * Gets the next entity in an entity list.
+ *
+ * This works from the entity rather than a position in the list, so entities
+ * can be created and destroyed while looping over a list.
+ *
+ * @param list   The entity list.
+ * @param entity The current entity.
+ *
+ * @return The lowest entity in the list above entity, or MAX_ENTITIES if there isn't one.
+ */
+unsigned int next_entity(const EntityList *list, unsigned int entity) {
+	
+	unsigned int position;
+	
+	if (list == NULL) {
+		return MAX_ENTITIES;
+	}
+	
+	position = find_list_position(list, entity + 1);
+	
+	return (position < list->count) ? list->entities[position] : MAX_ENTITIES;
+}
+
+/**
+ * Adds a command to the end of the deferred commands.
+ *
+ * @param world    The world struct
+ * @param type     The kind of change.
+ * @param entity   The entity, or MAX_ENTITIES if the command has no entity.
+ * @param value    The command's value.
+ * @param function The function for DEFER_CALL.
+ */
+static void defer_command(World *world, DeferredType type, unsigned int entity, int value, DeferredFunction function) {
+	DeferredCommand *deferred;
+	DeferredCommand *command;
+	unsigned int capacity;
+	
+	//systems running on the scheduler's workers can defer commands at the same time.
+	pthread_mutex_lock(&deferred_lock);
+	
+	if (world->deferred_count == world->deferred_capacity) {
+		
+		capacity = (world->deferred_capacity == 0) ? INITIAL_ENTITIES : world->deferred_capacity * 2;
+		
+		if ((deferred = (DeferredCommand*)realloc(world->deferred, sizeof(DeferredCommand) * capacity)) == NULL) {
+			printf("Error growing the deferred commands to %u\n", capacity);
+			pthread_mutex_unlock(&deferred_lock);
+			return;
+		}
+		
+		world->deferred = deferred;
+		world->deferred_capacity = capacity;
+	}
+	
+	command = &world->deferred[world->deferred_count++];
+	
+	command->type = type;
+	command->handle = (entity < world->entity_end) ? get_entity_handle(world, entity) : MAX_ENTITIES;
+	command->value = value;
+	command->function = function;
+	
+	pthread_mutex_unlock(&deferred_lock);
+}
+
+/**
+ * Destroys an entity when the deferred commands are applied.
+ *
+ * Systems use this instead of destroy_entity while they are looping through entities.
+ *
+ * @param world  The world struct
+ * @param entity The entity.
+ */
+void defer_destroy_entity(World *world, unsigned int entity) {
+	defer_command(world, DEFER_DESTROY, entity, 0, NULL);
+}
+
+/**
+ * Adds components to an entity when the deferred commands are applied.
+ *
+ * @param world     The world struct
+ * @param entity    The entity.
+ * @param component The components to add.
+ */
+void defer_enable_component(World *world, unsigned int entity, unsigned int component) {
+	defer_command(world, DEFER_ENABLE, entity, component, NULL);
+}
+
+/**
+ * Removes components from an entity when the deferred commands are applied.
+ *
+ * @param world     The world struct
+ * @param entity    The entity.
+ * @param component The components to remove.
+ */
+void defer_disable_component(World *world, unsigned int entity, unsigned int component) {
+	defer_command(world, DEFER_DISABLE, entity, component, NULL);
+}
+
+/**
+ * Runs a function when the deferred commands are applied.
+ *
+ * This is for changes that create or destroy many entities, like loading a floor.
+ * If the command has an entity and it has been destroyed by then, the function
+ * isn't run.
+ *
+ * @param world    The world struct
+ * @param function The function.
+ * @param entity   The entity to pass to the function, or MAX_ENTITIES for none.
+ * @param value    The value to pass to the function.
+ */
+void defer_call(World *world, DeferredFunction function, unsigned int entity, int value) {
+	defer_command(world, DEFER_CALL, entity, value, function);
+}
+
+/**
+ * Makes every deferred change, in the order they were asked for.
+ *
+ * Called from the main loop between systems. Commands for entities that have
+ * already been destroyed are skipped.
+ *
+ * @param world The world struct
+ */
+void apply_deferred(World *world) {
+	unsigned int i;
+	unsigned int entity;
+	DeferredCommand *command;
+	
+	//a function can defer more commands, they are applied in this pass too.
+	for(i = 0; i < world->deferred_count; i++) {
+		
+		command = &world->deferred[i];
+		entity = (command->handle != MAX_ENTITIES) ? get_handle_entity(world, command->handle) : MAX_ENTITIES;
+		
+		//only a call can be made without an entity.
+		if (entity == MAX_ENTITIES && (command->handle != MAX_ENTITIES || command->type != DEFER_CALL)) {
+			continue;
+		}
+		
+		switch(command->type) {
+			case DEFER_DESTROY:
+				destroy_entity(world, entity);
+				break;
+			case DEFER_ENABLE:
+				enable_component(world, entity, command->value);
+				break;
+			case DEFER_DISABLE:
+				disable_component(world, entity, command->value);
+				break;
+			case DEFER_CALL:
+				command->function(world, entity, command->value);
+				break;
+		}
+	}
+	
+	world->deferred_count = 0;
+}
+
+/**
+ * Finds one of an entity's snapshot components.
+ *
+ * @param world     The world struct
+ * @param entity    The entity.
+ * @param component The component, one of the bits of SNAPSHOT_MASK.
+ * @param data      Set to the entity's component.
+ *
+ * @return The size of the component.
+ */
+static size_t snapshot_component(World *world, unsigned int entity, unsigned int component, void **data) {
+	
+	switch(component) {
+		case COMPONENT_POSITION:
+			*data = &world->position[entity];
+			return sizeof(PositionComponent);
+		case COMPONENT_MOVEMENT:
+			*data = &world->movement[entity];
+			return sizeof(MovementComponent);
+		case COMPONENT_COLLISION:
+			*data = &world->collision[entity];
+			return sizeof(CollisionComponent);
+		case COMPONENT_COMMAND:
+			*data = &world->command[entity];
+			return sizeof(CommandComponent);
+		case COMPONENT_POWERUP:
+			*data = &world->powerup[entity];
+			return sizeof(PowerUpComponent);
+		case COMPONENT_OBJECTIVE:
+			*data = &world->objective[entity];
+			return sizeof(ObjectiveComponent);
+	}
+	
+	*data = NULL;
+	return 0;
+}
+
+/**
+ * Copies the simulation components of every entity into a snapshot.
+ *
+ * Only the components in SNAPSHOT_MASK that each entity has are kept, one record
+ * after another. They don't own any memory, so the snapshot is a plain copy and
+ * the rest of the world is left alone.
+ *
+ * @param world    The world struct
+ * @param snapshot The snapshot. Its buffer is reused, and grown if it is too small.
+ *
+ * @return 0 on success, -1 if there isn't enough memory.
+ */
+int snapshot_world(World *world, WorldSnapshot *snapshot) {
+	unsigned int entity;
+	unsigned int component;
+	unsigned int capacity;
+	unsigned char *data;
+	void *saved;
+	size_t size;
+	SnapshotHeader header;
+	
+	//no record is bigger than an entity with every component.
+	size_t largest = sizeof(SnapshotHeader) + sizeof(PositionComponent) + sizeof(MovementComponent) + sizeof(CollisionComponent) +
+		sizeof(CommandComponent) + sizeof(PowerUpComponent) + sizeof(ObjectiveComponent);
+	
+	snapshot->size = 0;
+	
+	for(entity = 0; entity < world->entity_end; entity++) {
+		
+		if ((world->mask[entity] & SNAPSHOT_MASK) == 0) {
+			continue;
+		}
+		
+		if (snapshot->size + largest > snapshot->capacity) {
+			
+			capacity = (snapshot->capacity == 0) ? INITIAL_ENTITIES * largest : snapshot->capacity * 2;
+			
+			if ((data = (unsigned char*)realloc(snapshot->data, capacity)) == NULL) {
+				printf("Error growing the world snapshot to %u bytes\n", capacity);
+				return -1;
+			}
+			
+			snapshot->data = data;
+			snapshot->capacity = capacity;
+		}
+		
+		header.handle = get_entity_handle(world, entity);
+		header.mask = world->mask[entity] & SNAPSHOT_MASK;
+		
+		memcpy(snapshot->data + snapshot->size, &header, sizeof(SnapshotHeader));
+		snapshot->size += sizeof(SnapshotHeader);
+		
+		for(component = 1; component <= header.mask; component <<= 1) {
+			
+			if ((header.mask & component) == 0) {
+				continue;
+			}
+			
+			size = snapshot_component(world, entity, component, &saved);
+			memcpy(snapshot->data + snapshot->size, saved, size);
+			snapshot->size += size;
+		}
+	}
+	
+	return 0;
+}
+
+/**
+ * Puts the simulation components of every entity back to how they were in a snapshot.
+ *
+ * Only the components an entity had when the snapshot was taken are written back,
+ * and the ones it has gained since are taken away. Entities that have been
+ * destroyed since are skipped, even if their slot has been given to a new entity.
+ * Entities created since are left as they are.
+ *
+ * @param world    The world struct
+ * @param snapshot The snapshot from snapshot_world.
+ */
+void restore_world(World *world, const WorldSnapshot *snapshot) {
+	unsigned int offset = 0;
+	unsigned int entity;
+	unsigned int component;
+	void *data;
+	size_t size;
+	SnapshotHeader header;
+	
+	while(offset < snapshot->size) {
+		
+		memcpy(&header, snapshot->data + offset, sizeof(SnapshotHeader));
+		offset += sizeof(SnapshotHeader);
+		
+		entity = get_handle_entity(world, header.handle);
+		
+		for(component = 1; component <= header.mask; component <<= 1) {
+			
+			if ((header.mask & component) == 0) {
+				continue;
+			}
+			
+			//the components of destroyed entities still have to be stepped over.
+			size = snapshot_component(world, (entity == MAX_ENTITIES) ? 0 : entity, component, &data);
+			
+			if (entity != MAX_ENTITIES) {
+				memcpy(data, snapshot->data + offset, size);
+			}
+			
+			offset += size;
+		}
+		
+		if (entity != MAX_ENTITIES) {
+			set_mask(world, entity, (world->mask[entity] & ~SNAPSHOT_MASK) | header.mask);
+			sync_collider(world, entity);
+		}
+	}
+}
+
+/**
+ * Frees a snapshot's buffer.
+ *
+ * @param snapshot The snapshot.
+ */
+void free_snapshot(WorldSnapshot *snapshot) {
+	
+	free(snapshot->data);
+	memset(snapshot, 0, sizeof(WorldSnapshot));
+}
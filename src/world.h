@@ -11,14 +11,52 @@
 
 #define GAME_SPEED 30
 
+//Simulation ticks per second. Movement steps by one tick at a time whatever the frame rate,
+//this is the old frame cap so the controls feel the same.
+#define SIM_RATE 120
+
+//Most ticks that are run in one frame, so the game doesn't stall catching up after a hitch.
+#define MAX_SIM_TICKS 8
+
+//How far the movement speeds move an entity in one tick.
+#define SIM_STEP ((double)GAME_SPEED / SIM_RATE)
+
+//Part of the distance between a remote player and where the server says it is that is made up each tick.
+#define REMOTE_CORRECTION 0.1f
+
+//Remote players further than this from where the server says they are are moved straight there.
+#define REMOTE_SNAP_DISTANCE 120
+
+//Ticks a remote player keeps moving on its last velocity when no updates arrive.
+#define REMOTE_RECKONING_TICKS (SIM_RATE / 4)
+
 //0 is off, 1 is on. Remember to make clean to get it to work.
 #define DISPLAY_CUTSCENES 1
 
+//0 draws everything onto one surface that is uploaded each frame, 1 keeps images as textures. Remember to make clean to get it to work.
+#define TEXTURE_RENDERING 1
+
 //max FPS
 #define FPS_MAX 120
 
-//Maximum entities that will be used.
-#define MAX_ENTITIES 256
+//Maximum entities the world can grow to. It is also used as the "no entity" value.
+#define MAX_ENTITIES 65535
+
+//Entities the world has room for when it is created. It doubles whenever it runs out.
+#define INITIAL_ENTITIES 256
+
+//Entity handles hold the entity in the low bits and its generation in the rest.
+#define ENTITY_INDEX_BITS 16
+#define ENTITY_INDEX_MASK ((1 << ENTITY_INDEX_BITS) - 1)
+
+//Floors that the world keeps a level lookup for, numbered from 0.
+#define LEVEL_FLOORS 16
+
+//Buckets in the collision grid. Must be a power of two.
+#define COLLIDER_BUCKETS 1024
+
+//Most component signatures the world can keep entity lists for.
+#define MAX_ENTITY_LISTS 32
 
 //Maximum string lengths
 #define MAX_STRING 			15
@@ -26,27 +64,140 @@
 
 #define IN_THIS_COMPONENT(mask, x) (((mask) & (x)) == (x))
 
-//This contains all of the entities' components and their respective component masks.
+//The entities that have every component in a signature, from lowest to highest.
+typedef struct {
+	unsigned int			signature;	//the components an entity needs to be in the list
+	unsigned int			*entities;	//the entities in the list
+	unsigned int			count;		//the number of entities in the list
+	unsigned int			capacity;	//the number of entities there is room for
+} EntityList;
+
+//The position, size and floor of every entity that can collide, in separate arrays so the
+//collision checks run straight through them. It is filled from the components by
+//gather_colliders and is only used while the movement system runs. The slots are also
+//kept in a grid of tile sized cells for each floor, so the checks only look at nearby slots.
+typedef struct {
+	unsigned int			*entity;		//the entity in each slot
+	float					*x;				//the centre of each entity
+	float					*y;
+	float					*half_width;	//half of each entity's size, rounded down like the components
+	float					*half_height;
+	int						*level;			//the floor each entity is on
+	unsigned char			*active;		//whether each entity's collision is active
+	int						*cell_x;		//the grid cell each slot's centre is in
+	int						*cell_y;
+	unsigned int			*cell_next;		//the next slot in the same grid bucket, or MAX_ENTITIES
+	unsigned int			*cell_prev;		//the previous slot in the same grid bucket, or MAX_ENTITIES
+	unsigned int			*candidates;	//room for the slots a grid search finds
+	unsigned int			buckets[COLLIDER_BUCKETS];	//the first slot in each grid bucket, or MAX_ENTITIES
+	float					max_half_width;	//the biggest half size of any slot, so searches reach every cell that can overlap
+	float					max_half_height;
+	unsigned int			count;			//the number of slots in use
+	unsigned int			capacity;		//the number of slots there is room for
+	unsigned int			*slot;			//the slot of each entity, only valid for entities in the arrays
+	unsigned int			slot_capacity;	//the number of entities slot has room for
+	bool					dirty;			//set when the arrays need to be gathered again
+} ColliderArrays;
+
+//Where a moving entity was at the start of the last simulation tick, so it can be drawn between ticks.
+typedef struct {
+	float					x;
+	float					y;
+	int						level;		//-1 until the entity has been through a tick
+} PreviousPosition;
+
+//How far a remote player is from where the server last said it was. It keeps moving on its
+//last velocity between updates, and the error is made up a little every tick.
 typedef struct {
-	unsigned int 			mask[MAX_ENTITIES];
-	PositionComponent		position[MAX_ENTITIES];
-	CommandComponent		command[MAX_ENTITIES];
-	MovementComponent		movement[MAX_ENTITIES];
-	CollisionComponent		collision[MAX_ENTITIES];
-	ControllableComponent	controllable[MAX_ENTITIES];
-	LevelComponent			level[MAX_ENTITIES];
-	MouseComponent			mouse[MAX_ENTITIES];
-	TextFieldComponent		text[MAX_ENTITIES];
-	ButtonComponent			button[MAX_ENTITIES];
-	RenderPlayerComponent	renderPlayer[MAX_ENTITIES];
-	PlayerComponent			player[MAX_ENTITIES];
-	TagComponent			tag[MAX_ENTITIES];
-	AnimationComponent		animation[MAX_ENTITIES];
-	WormholeComponent		wormhole[MAX_ENTITIES];
-	ObjectiveComponent		objective[MAX_ENTITIES];
-	TileComponent			tile[MAX_ENTITIES];
-	CutsceneComponent		cutscene[MAX_ENTITIES];
-	PowerUpComponent		powerup[MAX_ENTITIES];
+	float					x;
+	float					y;
+	unsigned int			ticks;		//ticks since the last update from the server
+} RemoteCorrection;
+
+//The components a world snapshot keeps.
+#define SNAPSHOT_MASK (COMPONENT_POSITION | COMPONENT_MOVEMENT | COMPONENT_COLLISION | COMPONENT_COMMAND | COMPONENT_POWERUP | COMPONENT_OBJECTIVE)
+
+//The start of an entity's record in a world snapshot. Its SNAPSHOT_MASK components
+//follow it, in the order of their bits, and the ones it doesn't have are left out.
+typedef struct {
+	unsigned int			handle;			//the entity's handle when the snapshot was taken
+	unsigned int			mask;			//the entity's SNAPSHOT_MASK components
+} SnapshotHeader;
+
+//The simulation components of every entity, taken by snapshot_world. The buffer is
+//kept between snapshots so taking another one doesn't allocate.
+typedef struct {
+	unsigned char			*data;			//the records of the entities, from lowest to highest
+	unsigned int			size;			//the number of bytes used
+	unsigned int			capacity;		//the number of bytes there is room for
+} WorldSnapshot;
+
+struct World;
+
+//A function that is run when the deferred commands are applied. It is given the
+//command's entity and value.
+typedef void (*DeferredFunction)(struct World *world, unsigned int entity, int value);
+
+//The kinds of changes that can be deferred.
+typedef enum {
+	DEFER_DESTROY,	//destroy the entity
+	DEFER_ENABLE,	//add the components in value to the entity
+	DEFER_DISABLE,	//remove the components in value from the entity
+	DEFER_CALL		//run function with the entity and value
+} DeferredType;
+
+//A change that a system has asked for, made when apply_deferred is called.
+typedef struct {
+	DeferredType			type;
+	unsigned int			handle;		//the entity's handle, or MAX_ENTITIES if the command has no entity
+	int						value;		//the components for DEFER_ENABLE and DEFER_DISABLE, or function's value
+	DeferredFunction		function;	//the function for DEFER_CALL
+} DeferredCommand;
+
+//This contains all of the entities' components and their respective component masks.
+//Every array has room for capacity entities, and grows in create_entity.
+typedef struct World {
+	unsigned int 			*mask;
+	PositionComponent		*position;
+	CommandComponent		*command;
+	MovementComponent		*movement;
+	CollisionComponent		*collision;
+	ControllableComponent	*controllable;
+	LevelComponent			*level;
+	MouseComponent			*mouse;
+	TextFieldComponent		*text;
+	ButtonComponent			*button;
+	RenderPlayerComponent	*renderPlayer;
+	PlayerComponent			*player;
+	TagComponent			*tag;
+	AnimationComponent		*animation;
+	WormholeComponent		*wormhole;
+	ObjectiveComponent		*objective;
+	TileComponent			*tile;
+	CutsceneComponent		*cutscene;
+	PowerUpComponent		*powerup;
+	PreviousPosition		*previous;					//where each moving entity was at the start of the last tick
+	RemoteCorrection		*remote;					//how far each remote player is from where the server says it is
+	
+	unsigned int			*generation;				//counts how many times each entity has been destroyed
+	bool					*in_use;					//whether each entity has been handed out
+	unsigned int			*free_entities;				//the free entities below entity_end, as a heap with the lowest on top
+	unsigned int			free_count;					//the number of free entities
+	unsigned int			entity_end;					//one past the highest entity that has been handed out
+	unsigned int			capacity;					//the number of entities every array has room for
+	
+	unsigned int			floor_level[LEVEL_FLOORS];	//the level entity of each floor, or MAX_ENTITIES if it isn't loaded
+	
+	EntityList				lists[MAX_ENTITY_LISTS];	//the entities each system works on, kept up to date as masks change
+	unsigned int			list_count;					//the number of lists in use
+	
+	ColliderArrays			colliders;					//the hot collision fields of every entity that can collide
+	
+	float					interpolation;				//how far the frame is between the last tick and the next one, from 0 to 1
+	
+	DeferredCommand			*deferred;					//the changes waiting for apply_deferred, in the order they were asked for
+	unsigned int			deferred_count;				//the number of changes waiting
+	unsigned int			deferred_capacity;			//the number of changes there is room for
 } World;
 
 class FPS {
@@ -114,10 +265,11 @@ public:
 	}
 };
 
-void init_world(World* world);
+int init_world(World* world);
+void cleanup_world(World* world);
 unsigned int create_entity(World* world, unsigned int attributes);
 unsigned int create_player(World* world, int x, int y, bool controllable, int collisiontype, int playerNo, PKT_GAME_STATUS *status_update);
-unsigned int create_level(World* world, int** map, int width, int height, int tileSize, int floor);
+unsigned int create_level(World* world, const int *map, int width, int height, int tileSize, int floor);
 unsigned int create_stair(World* world, int targetLevel, int targetX, int targetY, int x, int y, int width, int height, int level);
 unsigned int create_objective(World* world, float x, float y, int w, int h, int id, int level);
 unsigned int create_block(World* world, int x, int y, int width, int height, int level);
@@ -126,7 +278,29 @@ void destroy_entity(World* world, const unsigned int entity);
 void destroy_world(World *world);
 void destroy_world_not_player(World *world);
 
+void get_draw_position(World *world, unsigned int entity, float *x, float *y);
+
+unsigned int get_floor_level(World *world, int floor);
+void set_level_floor(World *world, unsigned int entity, int floor);
+
+unsigned int get_entity_handle(World *world, unsigned int entity);
+unsigned int get_handle_entity(World *world, unsigned int handle);
+
 void disable_component(World *world, unsigned int entity, unsigned int component);
 void enable_component(World *world, unsigned int entity, unsigned int component);
 
+void defer_destroy_entity(World *world, unsigned int entity);
+void defer_enable_component(World *world, unsigned int entity, unsigned int component);
+void defer_disable_component(World *world, unsigned int entity, unsigned int component);
+void defer_call(World *world, DeferredFunction function, unsigned int entity, int value);
+void apply_deferred(World *world);
+
+int snapshot_world(World *world, WorldSnapshot *snapshot);
+void restore_world(World *world, const WorldSnapshot *snapshot);
+void free_snapshot(WorldSnapshot *snapshot);
+
+EntityList *get_entity_list(World *world, unsigned int signature);
+unsigned int first_entity(const EntityList *list);
+unsigned int next_entity(const EntityList *list, unsigned int entity);
+
 #endif
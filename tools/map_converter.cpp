@@ -0,0 +1,210 @@
+/**
+ * Compiles a text map and its tile set into the binary map format.
+ *
+ * Writes the compiled map (see map_format.h) and a tile set atlas with
+ * MAP_ATLAS_COLUMNS tiles across, next to the tile set as <tiles>_atlas.bmp.
+ * Run through make maps, which rebuilds every map whose text has changed.
+ *
+ * Usage:
+ *	map_converter <map.txt> <tiles.txt> <map.bin>
+ *
+ * @file map_converter.cpp
+ */
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/Graphics/map.h"
+#include "../src/Graphics/map_format.h"
+
+/**
+ * Reads a tile set and draws its tiles into an atlas.
+ *
+ * @param[in]  file_tiles The tile set.
+ * @param[out] atlas_name The filename the atlas was saved to.
+ * @param[out] tile_count The number of tiles.
+ *
+ * @return The collision type of each tile, or NULL on failure.
+ */
+static int *convert_tiles(const char *file_tiles, char *atlas_name, int *tile_count) {
+
+	FILE *fp;
+	SDL_Surface *atlas;
+	SDL_Surface *tile;
+	SDL_Rect tile_rect;
+	char tile_filename[MAP_BINARY_PATH];
+	int *collision;
+	int num_tiles, pos, i;
+
+	if ((fp = fopen(file_tiles, "r")) == 0) {
+		printf("Error opening tile set %s\n", file_tiles);
+		return NULL;
+	}
+
+	if (fscanf(fp, "%d", &num_tiles) != 1 || num_tiles <= 0) {
+		printf("Cannot find tile number\n");
+		return NULL;
+	}
+
+	collision = (int*)calloc(num_tiles, sizeof(int));
+
+	atlas = SDL_CreateRGBSurface(0, MAP_ATLAS_COLUMNS * TILE_WIDTH, ((num_tiles + MAP_ATLAS_COLUMNS - 1) / MAP_ATLAS_COLUMNS) * TILE_HEIGHT,
+		32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+
+	if (atlas == NULL) {
+		printf("Error creating the atlas: %s\n", SDL_GetError());
+		return NULL;
+	}
+
+	tile_rect.w = TILE_WIDTH;
+	tile_rect.h = TILE_HEIGHT;
+
+	for(i = 0; i < num_tiles; i++) {
+
+		if (fscanf(fp, "%d %127s", &pos, tile_filename) != 2 || pos < 0 || pos >= num_tiles ||
+			fscanf(fp, "%d", &collision[pos]) != 1) {
+			printf("Error reading tile %d.\n", i);
+			return NULL;
+		}
+
+		if ((tile = IMG_Load(tile_filename)) == NULL) {
+			printf("Error loading tile: %s, %s\n", tile_filename, IMG_GetError());
+			return NULL;
+		}
+
+		tile_rect.x = (pos % MAP_ATLAS_COLUMNS) * TILE_WIDTH;
+		tile_rect.y = (pos / MAP_ATLAS_COLUMNS) * TILE_HEIGHT;
+
+		//copy the alpha too, the map blends the tiles when it draws them.
+		SDL_SetSurfaceBlendMode(tile, SDL_BLENDMODE_NONE);
+		SDL_BlitSurface(tile, NULL, atlas, &tile_rect);
+		SDL_FreeSurface(tile);
+	}
+
+	fclose(fp);
+
+	const char *extension = strrchr(file_tiles, '.');
+	snprintf(atlas_name, MAP_BINARY_PATH, "%.*s_atlas.bmp", (int)(extension != NULL ? extension - file_tiles : strlen(file_tiles)), file_tiles);
+
+	if (SDL_SaveBMP(atlas, atlas_name) != 0) {
+		printf("Error saving %s: %s\n", atlas_name, SDL_GetError());
+		return NULL;
+	}
+
+	SDL_FreeSurface(atlas);
+
+	*tile_count = num_tiles;
+	return collision;
+}
+
+int main(int argc, char *argv[]) {
+
+	FILE *fp_map;
+	FILE *fp_binary;
+	MapBinaryHeader header;
+	MapEntity *entities;
+	Sint32 *tiles;
+	Sint32 *collision_map;
+	int *collision;
+	char entity_type[128];
+	int x, y, i, tile, result;
+
+	if (argc != 4) {
+		printf("Usage: %s <map.txt> <tiles.txt> <map.bin>\n", argv[0]);
+		return 1;
+	}
+
+	memset(&header, 0, sizeof(header));
+	header.magic = MAP_BINARY_MAGIC;
+	header.version = MAP_BINARY_VERSION;
+
+	if ((collision = convert_tiles(argv[2], header.atlas, &header.tile_count)) == NULL) {
+		return 1;
+	}
+
+	if ((fp_map = fopen(argv[1], "r")) == 0) {
+		printf("Error opening map %s\n", argv[1]);
+		return 1;
+	}
+
+	if (fscanf(fp_map, "%d %d %d", &header.level, &header.width, &header.height) != 3) {
+		printf("Error reading the map size\n");
+		return 1;
+	}
+
+	tiles = (Sint32*)malloc(sizeof(Sint32) * header.width * header.height);
+	collision_map = (Sint32*)malloc(sizeof(Sint32) * header.width * header.height);
+
+	for(y = 0; y < header.height; y++) {
+		for(x = 0; x < header.width; x++) {
+
+			if (fscanf(fp_map, "%d", &tile) != 1) {
+				printf("Expected more map.\n");
+				return 1;
+			}
+
+			if (tile < 0 || tile >= header.tile_count) {
+				printf("Using tile %d that is bigger than %d\n", tile, header.tile_count);
+				return 1;
+			}
+
+			tiles[y * header.width + x] = tile;
+			collision_map[y * header.width + x] = collision[tile];
+		}
+	}
+
+	if (fscanf(fp_map, "%d", &header.entity_count) != 1) {
+		header.entity_count = 0;
+	}
+
+	entities = (MapEntity*)calloc(header.entity_count + 1, sizeof(MapEntity));
+
+	for(i = 0; i < header.entity_count; i++) {
+
+		if (fscanf(fp_map, "%127s", entity_type) != 1) {
+			printf("Entity type error: %s\n", argv[1]);
+			return 1;
+		}
+
+		if ((result = read_map_entity(fp_map, entity_type, &entities[i])) == -1) {
+			return 1;
+		}
+
+		//the game stops reading entities at the first one it doesn't know.
+		if (result == 1) {
+			header.entity_count = i;
+			break;
+		}
+	}
+
+	fclose(fp_map);
+
+	if ((fp_binary = fopen(argv[3], "wb")) == 0) {
+		printf("Error creating %s\n", argv[3]);
+		return 1;
+	}
+
+	if (fwrite(&header, sizeof(header), 1, fp_binary) != 1 ||
+		fwrite(tiles, sizeof(Sint32), header.width * header.height, fp_binary) != (size_t)(header.width * header.height) ||
+		fwrite(collision_map, sizeof(Sint32), header.width * header.height, fp_binary) != (size_t)(header.width * header.height) ||
+		fwrite(entities, sizeof(MapEntity), header.entity_count, fp_binary) != (size_t)header.entity_count) {
+		printf("Error writing %s\n", argv[3]);
+		fclose(fp_binary);
+		remove(argv[3]);
+		return 1;
+	}
+
+	fclose(fp_binary);
+
+	printf("%s: %dx%d, %d tiles, %d entities\n", argv[3], header.width, header.height, header.tile_count, header.entity_count);
+
+	free(entities);
+	free(tiles);
+	free(collision_map);
+	free(collision);
+
+	return 0;
+}